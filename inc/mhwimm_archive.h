@@ -0,0 +1,119 @@
+/**
+ * Monster Hunter World Iceborne Mod Manager Archive Reader
+ * This file contains the definition of the reader used by INSTALL
+ * to deploy a mod from an archive,the entries are decoded and
+ * written into mhwi root directly,no extracted tree is needed.
+ */
+#ifndef _MHWIMM_ARCHIVE_H_
+#define _MHWIMM_ARCHIVE_H_
+
+#include "mhwimm_fsbatch.h"
+#include "mhwimm_thread_pool.h"
+#include "mhwimm_path_list.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <string>
+#include <list>
+
+namespace mhwimm_archive_ns {
+
+  /**
+   * archive_format - supported archive formats
+   * ARCHIVE_ZIP:     .zip,stored or deflated entries
+   * ARCHIVE_TAR:     .tar
+   * ARCHIVE_TAR_GZ:  .tar.gz / .tgz
+   * ARCHIVE_TAR_ZST: .tar.zst / .tzst,decoded by zstd(1)
+   */
+  enum class archive_format : uint8_t {
+    ARCHIVE_NONE,
+    ARCHIVE_ZIP,
+    ARCHIVE_TAR,
+    ARCHIVE_TAR_GZ,
+    ARCHIVE_TAR_ZST
+  };
+
+  /* zip_entry - entry in zip central directory,see archive source */
+  struct zip_entry;
+
+  /* archive_format_of - format of @path by its suffix */
+  archive_format archive_format_of(const std::string &path);
+
+  /**
+   * archive_reader - reader of one mod archive
+   * # entry paths are normalized,absolute path and ".." are refused,
+   *   thus no entry can be written out of the destination.
+   * # only directories and regular files are deployed,the other
+   *   entries are skipped as symbolic links by parallel_traverse(),
+   *   the first entry wins if a path occurs more than once.
+   */
+  class archive_reader final {
+  public:
+    archive_reader() : format_(archive_format::ARCHIVE_NONE), fd_(-1),
+                       map_(nullptr), map_size_(0) {}
+    ~archive_reader() { close(); }
+
+    // disabled copying,moving
+    archive_reader(const archive_reader &) =delete;
+    archive_reader &operator=(const archive_reader &) =delete;
+    archive_reader(archive_reader &&) =delete;
+    archive_reader &operator=(archive_reader &&) =delete;
+
+    /**
+     * open - open archive @path
+     * return:  0 OR -1
+     * # zip archive is mapped into memory,tar archive is decoded
+     *   as stream by each pass.
+     */
+    int open(const std::string &path);
+    void close(void);
+
+    /**
+     * list - makeup file list of the archive
+     * @directory_list:    where to append the directories,including the
+     *                     parents which have no entry of their own
+     * @regular_file_list: where to append the regular files
+     * return:             0 OR -1
+     * # paths start with "/" as parallel_traverse() does.
+     * # tar archive is decoded once to list,the file data is skipped.
+     */
+    int list(mhwimm_path_list_ns::path_list &directory_list,
+             mhwimm_path_list_ns::path_list &regular_file_list);
+
+    /**
+     * extract - write the regular files of @ops into @dirfd
+     * @ops:     operations,the type is FS_EXTRACT,@fs_op.path is the
+     *           entry path returned by list() without leading "/"
+     * @nops:    number of operations
+     * @pool:    zip entries are extracted by the workers in parallel
+     * return:   number of failed operations
+     * # destination is created exclusively,-EEXIST means it is existed,
+     *   and a failed extraction never leaves the destination.
+     */
+    std::size_t extract(int dirfd, mhwimm_fsbatch_ns::fs_op *ops, std::size_t nops,
+                        mhwimm_thread_pool_ns::work_stealing_pool &pool);
+
+  private:
+    int listZip(mhwimm_path_list_ns::path_list &directory_list,
+                mhwimm_path_list_ns::path_list &regular_file_list);
+    int listTar(mhwimm_path_list_ns::path_list &directory_list,
+                mhwimm_path_list_ns::path_list &regular_file_list);
+    std::size_t extractZip(int dirfd, mhwimm_fsbatch_ns::fs_op *ops, std::size_t nops,
+                           mhwimm_thread_pool_ns::work_stealing_pool &pool);
+    std::size_t extractTar(int dirfd, mhwimm_fsbatch_ns::fs_op *ops, std::size_t nops);
+
+    /* zipEntries - parse central directory,return -1 if corrupted */
+    int zipEntries(std::list<zip_entry> &entries) const;
+
+    std::string path_;
+    archive_format format_;
+    int fd_;
+    /* map_ - the whole zip archive,nullptr for tar */
+    const unsigned char *map_;
+    std::size_t map_size_;
+  };
+
+}
+
+#endif
@@ -64,6 +64,11 @@ namespace mhwimm_config_ns {
    * @mhwiroot:  path to the root of mhwi install directory
    * @mhwimmroot:    path to the root of this application's configure
    *                 directory
+   * @nworkers:      number of worker threads used by Executor for
+   *                 filesystem works,_zero_ means number of hardware
+   *                 threads
+   * @deploy:        default deploy strategy of INSTALL,"link","reflink"
+   *                 or "copy"
    */
   template<typename _MType>
   struct config_struct {
@@ -73,6 +78,8 @@ namespace mhwimm_config_ns {
     skey_t userhome;
     skey_t mhwiroot;
     skey_t mhwimmroot;
+    nkey_t nworkers;
+    skey_t deploy;
   };
 
   /**
@@ -115,7 +122,9 @@ namespace mhwimm_config_ns {
     auto ret = true;
     conf_sink << "USERHOME=" << conf->userhome << "\n"
               << "MHWIROOT=" << conf->mhwiroot << "\n"
-              << "MHWIMMROOT=" << conf->mhwimmroot << "\n";
+              << "MHWIMMROOT=" << conf->mhwimmroot << "\n"
+              << "NWORKERS=" << conf->nworkers << "\n"
+              << "DEPLOY=" << conf->deploy << "\n";
     // if more config options are appended in future,should place them
     // from there
     if (conf_sink.bad())
@@ -180,6 +189,10 @@ namespace mhwimm_config_ns {
         conf->mhwiroot = config_value;
       else if (config_name == "MHWIMMROOT")
         conf->mhwimmroot = config_value;
+      else if (config_name == "NWORKERS")
+        conf->nworkers = std::atoi(config_value.c_str());
+      else if (config_name == "DEPLOY")
+        conf->deploy = config_value;
     }
     conf_source.close();
     return ret;
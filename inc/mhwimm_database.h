@@ -11,6 +11,11 @@
 #include <cstdint>
 
 #include <string>
+#include <list>
+#include <vector>
+#include <functional>
+
+#include "mhwimm_path_list.h"
 
 /* sqlite3 structures */
 struct sqlite3;
@@ -26,15 +31,84 @@ namespace mhwimm_db_ns {
    * ADD:     INSERT
    * DEL:     DELETE
    * ASK:     SELECT
+   * ASK_MODS:    SELECT on mods table only,file_path of the
+   *              result is always empty
+   * UPDATE:  apply the delta of an installed mod,it is processed
+   *          by updateModFilesList() only
    * NOP:     nothing to do
    */
   enum class SQL_OP : uint8_t {
     SQL_ADD,
     SQL_DEL,
     SQL_ASK,
+    SQL_ASK_MODS,
+    SQL_UPDATE,
     SQL_NOP
   };
 
+  /**
+   * db_stmt_id - statements which are not constructed from
+   *              db_table_record,they are compiled and cached
+   *              as well as the statements for SQL_OP
+   * ADD_MOD:         insert a row into mods table
+   * ADD_MOD_FILE:    insert a row into files table
+   * UPSERT_MOD:      insert a row into mods table,or increase
+   *                  file_count of the existed one
+   * ADD_CANDIDATE:   insert a path into temporary table candidate_paths
+   * ASK_CONFLICTS:   select the files recorded in database which have
+   *                  the same path as the candidates
+   * ASK_CONTENT_HASHES:  select the distinct content hashes referenced
+   *                      by the files
+   * ASK_MOD_ID:      select id of a mod by name
+   * DEL_MOD_FILE:    delete a file of a mod
+   * UPDATE_MOD:      set install_date and source of a mod,and adjust
+   *                  file_count
+   * SET_FILE_META:   set metadata and content hash of a file by rowid
+   * SET_FILE_HASH:   set content hash of a file of a mod by path
+   * ASK_FILE_META:   select the regular files with their metadata,content
+   *                  hashes and the sources of their mods,of a mod or
+   *                  all mods
+   */
+  enum class db_stmt_id : uint8_t {
+    ADD_MOD,
+    ADD_MOD_FILE,
+    UPSERT_MOD,
+    ADD_CANDIDATE,
+    ASK_CONFLICTS,
+    ASK_CONTENT_HASHES,
+    ASK_MOD_ID,
+    DEL_MOD_FILE,
+    UPDATE_MOD,
+    SET_FILE_META,
+    ASK_FILE_META,
+    SET_FILE_HASH,
+    NR_STMT_ID
+  };
+
+  /**
+   * db_conflict - a file which already been installed by another mod
+   * @owner:       name of the mod owns the file
+   * @file_path:   path of the file
+   */
+  struct db_conflict {
+    std::string owner;
+    std::string file_path;
+  };
+
+  /**
+   * db_file_meta - metadata of a deployed regular file
+   * @inode:       inode number,0 => metadata is not recorded
+   * @size:        size in bytes
+   * @mtime_ns:    modification time in nanoseconds since epoch
+   * @nlink:       number of hard links
+   */
+  struct db_file_meta {
+    uint64_t inode;
+    uint64_t size;
+    int64_t mtime_ns;
+    uint32_t nlink;
+  };
+
   /**
    * DB_STATUS - enumerate database status
    * DB_IDLE:    database is idle now
@@ -59,6 +133,19 @@ namespace mhwimm_db_ns {
     IDX_INSTALL_DATE
   };
 
+  /**
+   * db_entry_type - type of the file recorded in files table
+   * ENTRY_UNKNOWN:   type is not recorded,e.g. the records migrated
+   *                  from legacy table
+   * ENTRY_REGULAR:   regular file
+   * ENTRY_DIRECTORY: directory
+   */
+  enum class db_entry_type : uint8_t {
+    ENTRY_UNKNOWN,
+    ENTRY_REGULAR,
+    ENTRY_DIRECTORY
+  };
+
   /**
    * db_table_record - database table record for one line
    * @mod_name:        mod_name field
@@ -71,6 +158,7 @@ namespace mhwimm_db_ns {
    * @is_install_date_set: indicator for @install_date to tell
    *                       database whether @install_date has a
    *                       valid value
+   * @entry_type:          type of the file,only returned by SQL_ASK
    * # this structure can be used to stores the resul from database,
    *   or the informations is going to be inserted into the table.
    *   it can as a filter when process database operations SQL_ASK
@@ -83,6 +171,7 @@ namespace mhwimm_db_ns {
     uint8_t is_file_path_set:1;
     std::string install_date;
     uint8_t is_install_date_set:1;
+    db_entry_type entry_type;
   };
 #define _ZERO_dtr {          \
   .mod_name = "BUG",        \
@@ -91,6 +180,7 @@ namespace mhwimm_db_ns {
   .is_file_path_set = 0,    \
   .install_date = "BUG",    \
   .is_install_date_set = 0, \
+  .entry_type = mhwimm_db_ns::db_entry_type::ENTRY_UNKNOWN, \
 }
 
   /**
@@ -110,6 +200,10 @@ namespace mhwimm_db_ns {
       record_buf_ = db_table_record _ZERO_dtr;
       local_err_msg_ = "nil";
       more_rows_indicator_ = false;
+      for (auto &stmt : stmt_cache_)
+        stmt = nullptr;
+      stmt_cache_hits_ = 0;
+      stmt_cache_misses_ = 0;
     }
 
     // disabled copying,moving
@@ -122,6 +216,9 @@ namespace mhwimm_db_ns {
     int closeDB(void);
     int tryCreateTable(void);
 
+    /* schema_version_ - version of database schema this class works on */
+    static constexpr int schema_version_ = 6;
+
     bool is_db_opened(void) const noexcept { return db_handler_ != nullptr; }
 
     std::string returnDBpath(void) const noexcept
@@ -164,6 +261,22 @@ namespace mhwimm_db_ns {
       return 0;
     }
 
+    /**
+     * getEntryType - get the file type from result
+     * @type:         where to store the type
+     * return:        0 OR -1
+     */
+    int getEntryType(db_entry_type &type)
+    {
+      if (!more_rows_indicator_) {
+        current_status_ = DB_STATUS::DB_ERROR;
+        local_err_msg_ = DB_ERROR_NORESULT;
+        return -1;
+      }
+      type = record_buf_.entry_type;
+      return 0;
+    }
+
     /**
      * registerDBOperation - register a database operation but do not
      *                       process it
@@ -185,12 +298,91 @@ namespace mhwimm_db_ns {
     }
 
     int executeDBOperation(void);
+
+    /**
+     * addModFilesList - insert records for all files of a mod
+     * @mod_name:        mod name
+     * @install_date:    install date
+     * @source:          absolute path of the mod directory or archive,
+     *                   NULL is recorded if it is empty
+     * @directory_list:  directory paths of the mod
+     * @regular_file_list:   regular file paths of the mod
+     * @content_hash_list:   content hashes of @regular_file_list in the
+     *                       same order,empty if the mod is not deployed
+     *                       from content store
+     * @file_meta_list:      metadata of @regular_file_list in the same
+     *                       order,it is read after @before_commit,empty
+     *                       if not known
+     * @deployed_hash_list:  content hashes of the deployed files in the
+     *                       same order,read after @before_commit,they
+     *                       replace @content_hash_list,empty if not known
+     * @before_commit:     called after all records inserted,the
+     *                       transaction is rolled back if it returns false
+     * return:           0 OR -1
+     * # one INSERT statement is prepared and reused for every record,
+     *   and all records are committed in one transaction.if any record
+     *   failed,the whole transaction will be rolled back.
+     */
+    int addModFilesList(const std::string &mod_name, const std::string &install_date,
+                        const std::string &source,
+                        const mhwimm_path_list_ns::path_list &directory_list,
+                        const mhwimm_path_list_ns::path_list &regular_file_list,
+                        const mhwimm_path_list_ns::path_list &content_hash_list,
+                        const std::vector<db_file_meta> &file_meta_list,
+                        const mhwimm_path_list_ns::path_list &deployed_hash_list,
+                        const std::function<bool(void)> &before_commit = nullptr);
+
+    /**
+     * updateModFilesList - apply the delta of an installed mod
+     * @mod_name:           mod name
+     * @install_date:       update date,replaces the install date
+     * @source:             replaces the source of the mod if it is not
+     *                      empty
+     * @removed_list:       paths to be removed,directories or regular
+     *                      files
+     * @directory_list:     directory paths to be added
+     * @regular_file_list:  regular file paths to be added
+     * @content_hash_list:  content hashes of @regular_file_list,same as
+     *                      addModFilesList()
+     * @file_meta_list:     metadata of @regular_file_list,same as
+     *                      addModFilesList()
+     * @deployed_hash_list: content hashes of the deployed files,same as
+     *                      addModFilesList()
+     * return:              0 OR -1
+     * # all changes are committed in one transaction,the number of
+     *   statements is proportional to the delta,not the mod.
+     * # a replaced file is in both @removed_list and @regular_file_list.
+     */
+    int updateModFilesList(const std::string &mod_name, const std::string &install_date,
+                           const std::string &source,
+                           const mhwimm_path_list_ns::path_list &removed_list,
+                           const mhwimm_path_list_ns::path_list &directory_list,
+                           const mhwimm_path_list_ns::path_list &regular_file_list,
+                           const mhwimm_path_list_ns::path_list &content_hash_list,
+                           const std::vector<db_file_meta> &file_meta_list,
+                           const mhwimm_path_list_ns::path_list &deployed_hash_list);
+
+    /**
+     * setDeployedHashes - record the content hashes of the deployed
+     *                     files of an installed mod
+     * @mod_name:          mod name
+     * @regular_file_list: regular file paths of the mod
+     * @deployed_hash_list:    content hashes of @regular_file_list in the
+     *                         same order,an empty hash is skipped
+     * return:             0 OR -1
+     * # the hashes are written in their own transaction,thus reading
+     *   the files does not hold the records of the mod uncommitted.
+     */
+    int setDeployedHashes(const std::string &mod_name,
+                          const mhwimm_path_list_ns::path_list &regular_file_list,
+                          const mhwimm_path_list_ns::path_list &deployed_hash_list);
     auto getCurrentOP(void) const { return current_op_; }
     auto getCurrentStatus(void) const { return current_status_; }
     auto getDBStatus(void) const { return current_status_; }
 
     void resetDB(void)
     {
+      releaseStmt();
       current_status_ = DB_STATUS::DB_IDLE;
       current_op_ = SQL_OP::SQL_NOP;
       record_buf_ = db_table_record _ZERO_dtr;
@@ -201,7 +393,115 @@ namespace mhwimm_db_ns {
       outside_buf = local_err_msg_;
     }
 
+    /**
+     * getStmtCacheStats - get counters of the compiled statement cache
+     * @hits:              how many times a cached statement was reused
+     * @misses:            how many times a statement had to be compiled
+     */
+    void getStmtCacheStats(std::size_t &hits, std::size_t &misses) const noexcept
+    {
+      hits = stmt_cache_hits_;
+      misses = stmt_cache_misses_;
+    }
+
+    /**
+     * findConflicts - find out the paths in @candidates which been
+     *                 recorded by installed mods
+     * @candidates:    regular file paths of the mod to be installed
+     * @conflicts:     where to append the result,ordered by owner and
+     *                 path
+     * return:         0 OR -1
+     * # candidates are loaded into a temporary table,and then joined
+     *   against files table by index files_owner_idx.
+     * # directories are not conflicts,because mods always share the
+     *   directories of the game.
+     */
+    int findConflicts(const mhwimm_path_list_ns::path_list &candidates,
+                      std::list<db_conflict> &conflicts);
+
+    /**
+     * getContentHashes - get the content hashes referenced by files
+     * @hashes:           where to append the distinct hashes
+     * return:            0 OR -1
+     */
+    int getContentHashes(mhwimm_path_list_ns::path_list &hashes);
+
+    /**
+     * getFileMeta - get the regular files recorded with their metadata
+     * @mod_name:    the mod,all mods if it is empty
+     * @owners:      where to append the mod name of each file
+     * @paths:       where to append the paths
+     * @metas:       where to append the metadata,inode is 0 if the file
+     *               has no metadata recorded
+     * @hashes:      where to append the content hashes,empty if the file
+     *               has no hash recorded
+     * @sources:     where to append the source of the mod of each file,
+     *               empty if it is not recorded
+     * return:       0 OR -1
+     * # the files are ordered by mod and then by installing order.
+     */
+    int getFileMeta(const std::string &mod_name,
+                    mhwimm_path_list_ns::path_list &owners,
+                    mhwimm_path_list_ns::path_list &paths,
+                    std::vector<db_file_meta> &metas,
+                    mhwimm_path_list_ns::path_list &hashes,
+                    mhwimm_path_list_ns::path_list &sources);
+
   private:
+    /* execRawSQL - execute a SQL statement without result,e.g. BEGIN */
+    int execRawSQL(const char *sql);
+
+    /* insertModFiles - insert file records of mod @mod_id,in caller's transaction */
+    int insertModFiles(int64_t mod_id,
+                       const mhwimm_path_list_ns::path_list &directory_list,
+                       const mhwimm_path_list_ns::path_list &regular_file_list,
+                       const mhwimm_path_list_ns::path_list &content_hash_list);
+
+    /* setFileMeta - set @metas and @hashes to the regular files inserted last time,in caller's transaction */
+    int setFileMeta(const std::vector<db_file_meta> &metas,
+                    const mhwimm_path_list_ns::path_list &hashes);
+
+    /**
+     * filterBits - bitmap of the fields set in @record_buf_,
+     *              bit0 => mod_name, bit1 => file_path,
+     *              bit2 => install_date
+     */
+    uint8_t filterBits(void) const noexcept
+    {
+      return record_buf_.is_mod_name_set |
+        record_buf_.is_file_path_set << 1 |
+        record_buf_.is_install_date_set << 2;
+    }
+
+    /* buildSQL - construct SQL statement for @op with WHERE condition of @filter_bits */
+    std::string buildSQL(SQL_OP op, uint8_t filter_bits) const;
+
+    /**
+     * cachedStmt - get the compiled statement for @op and @filter_bits,
+     *              compile it and store it in cache if it is not cached
+     * return:      statement OR nullptr
+     */
+    sqlite3_stmt *cachedStmt(SQL_OP op, uint8_t filter_bits);
+    sqlite3_stmt *cachedStmt(db_stmt_id id);
+
+    /* compileStmt - compile @sqlstmt into cache slot @slot */
+    sqlite3_stmt *compileStmt(std::size_t slot, const char *sqlstmt);
+
+    /* getSchemaVersion - read schema version recorded in database */
+    int getSchemaVersion(int &version);
+
+    /* isLegacyTableExist - check whether the table created by old version exists */
+    bool isLegacyTableExist(void);
+
+    /* bindRecord - bind fields of @record_buf_ to @stmt */
+    int bindRecord(sqlite3_stmt *stmt);
+
+    /* releaseStmt - reset current statement and put it back to cache */
+    void releaseStmt(void);
+
+    /* finalizeStmtCache - finalize all cached statements */
+    void finalizeStmtCache(void);
+
     /* db_name_ - databae file name */
     std::string db_name_;
     /* db_path_ - database file path withou file name */
@@ -224,16 +524,25 @@ namespace mhwimm_db_ns {
      */
     bool more_rows_indicator_;
 
-    /* table_name_ - table name */
-    const char *table_name_ = "mhwimm_db_table";
+    /**
+     * stmt_cache_ - compiled statements,index is built up by
+     *               SQL_OP and filter bits : (op << 3) | filter_bits,
+     *               statements of db_stmt_id are placed after them
+     */
+    static constexpr std::size_t stmt_op_slots_ = static_cast<std::size_t>(SQL_OP::SQL_NOP) << 3;
+    static constexpr std::size_t stmt_cache_size_ =
+      stmt_op_slots_ + static_cast<std::size_t>(db_stmt_id::NR_STMT_ID);
+    sqlite3_stmt *stmt_cache_[stmt_cache_size_];
+    /* stmt_cache_hits_ - counter for reused statements */
+    std::size_t stmt_cache_hits_;
+    /* stmt_cache_misses_ - counter for compiled statements */
+    std::size_t stmt_cache_misses_;
+
+    /* inserted_rowids_ - rowids of the regular files inserted by last insertModFiles() */
+    std::vector<int64_t> inserted_rowids_;
 
-    /* sqlCreateTable_ - SQL statement used to create table at first time */
-    const char *sqlCreateTable_ = 
-      "CREATE TABLE mhwimm_db_table ("
-      "mod_name CHAR NOT NULL,"
-      "file_path CHAR NOT NULL,"
-      "install_date CHAR NOT NULL,"
-      "unused_id INT AUTO_INCREMENT PRIMARY KEY);";
+    /* legacy_table_name_ - table name used before schema versioning */
+    const char *legacy_table_name_ = "mhwimm_db_table";
   };
 
 }
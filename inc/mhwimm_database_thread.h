@@ -12,4 +12,20 @@
  */
 void mhwimm_db_thread_worker(mhwimm_db_ns::mhwimm_db &db);
 
+/**
+ * mhwimm_db_prepare - open database and create or upgrade the tables
+ * @db:    lvalue reference to database handler
+ * return: 0 => succeed,-1 => failed
+ */
+int mhwimm_db_prepare(mhwimm_db_ns::mhwimm_db &db);
+
+/**
+ * mhwimm_db_process_queue - process the queued requests in caller's
+ *                           thread,used by batch mode which has no DB
+ *                           thread
+ * @db:    lvalue reference to database handler
+ * # gated request must not be queued,nobody opens the gate.
+ */
+void mhwimm_db_process_queue(mhwimm_db_ns::mhwimm_db &db);
+
 #endif
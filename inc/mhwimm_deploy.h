@@ -0,0 +1,69 @@
+/**
+ * Monster Hunter World Iceborne Mod Manager Deploy Strategy
+ * This file contains the deploy strategies used by INSTALL when
+ * the mod files can not be hard linked into mhwi root,e.g. the
+ * mod directory is on another filesystem.
+ */
+#ifndef _MHWIMM_DEPLOY_H_
+#define _MHWIMM_DEPLOY_H_
+
+#include "mhwimm_fsbatch.h"
+#include "mhwimm_thread_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <string>
+#include <string_view>
+
+namespace mhwimm_deploy_ns {
+
+  /**
+   * deploy_strategy - how to deploy mod files,each strategy falls
+   *                   back to the next one if it is impossible
+   * DEPLOY_LINK:      hard link => reflink => copy
+   * DEPLOY_REFLINK:   reflink (FICLONE) => copy
+   * DEPLOY_COPY:      copy_file_range
+   * DEPLOY_STORE:     ingest into content store,and then hard link
+   *                   from the blob as DEPLOY_LINK does
+   */
+  enum class deploy_strategy : uint8_t {
+    DEPLOY_LINK,
+    DEPLOY_REFLINK,
+    DEPLOY_COPY,
+    DEPLOY_STORE
+  };
+
+  /**
+   * parse_deploy_strategy - "link","reflink","copy","store" to strategy
+   * return:                 0 OR -1 if unknown
+   */
+  int parse_deploy_strategy(std::string_view name, deploy_strategy &strategy);
+
+  /**
+   * should_fallback - whether the failure of hard link with @err
+   *                   means the next strategy should be tried
+   */
+  bool should_fallback(int err);
+
+  /**
+   * copy_files - deploy @ops by reflink or copy
+   * @dirfd:      directory fd,@fs_op.path is relative to it
+   * @ops:        operations,the type is FS_COPY
+   * @nops:       number of operations
+   * @strategy:   DEPLOY_COPY skips reflink
+   * @pool:       each file is copied by one task,large files are
+   *              split into chunks copied in parallel
+   *              the files are copied window by window,the fds of
+   *              a file are closed once it is done
+   * return:      number of failed operations
+   * # destination is created exclusively,-EEXIST means it is existed,
+   *   and a failed copy never leaves the destination.
+   */
+  std::size_t copy_files(int dirfd, mhwimm_fsbatch_ns::fs_op *ops, std::size_t nops,
+                         deploy_strategy strategy,
+                         mhwimm_thread_pool_ns::work_stealing_pool &pool);
+
+}
+
+#endif
@@ -0,0 +1,97 @@
+/**
+ * Monster Hunter World Iceborne Mod Manager Directory Scanner
+ * This file contains the definition of directory scanner,it
+ * reads directory entries in large batches via getdents64,
+ * and gets entry type from d_type without stat.
+ */
+#ifndef _MHWIMM_DIRSCAN_H_
+#define _MHWIMM_DIRSCAN_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <memory>
+
+namespace mhwimm_dirscan_ns {
+
+  /**
+   * dentry_type - type of directory entry
+   * ENT_REGULAR:   regular file
+   * ENT_DIRECTORY: directory
+   * ENT_SYMLINK:   symbolic link
+   * ENT_OTHER:     the others,e.g. FIFO,socket,device
+   */
+  enum class dentry_type : uint8_t {
+    ENT_REGULAR,
+    ENT_DIRECTORY,
+    ENT_SYMLINK,
+    ENT_OTHER
+  };
+
+  /**
+   * dir_scanner - directory scanner
+   * # only the entries which d_type is DT_UNKNOWN are resolved by
+   *   fstatat() relative to the directory fd,the others do not need
+   *   any extra system call.
+   * # an object can be reused to scan many directories,the buffer
+   *   is allocated only once.
+   */
+  class dir_scanner final {
+  public:
+    /* default size of the buffer for getdents64 */
+    static constexpr std::size_t default_buf_size = 64 * 1024;
+
+    explicit dir_scanner(std::size_t buf_size = default_buf_size)
+      : buf_(new char[buf_size]), buf_size_(buf_size)
+    {
+      fd_ = -1;
+      buf_pos_ = buf_end_ = 0;
+      skip_dots_ = true;
+    }
+
+    ~dir_scanner() { close(); }
+
+    // disabled copying,moving
+    dir_scanner(const dir_scanner &) =delete;
+    dir_scanner &operator=(const dir_scanner &) =delete;
+    dir_scanner(dir_scanner &&) =delete;
+    dir_scanner &operator=(dir_scanner &&) =delete;
+
+    /**
+     * open - open directory @path relative to @dirfd
+     * @dirfd:    directory fd OR AT_FDCWD
+     * @path:     directory path
+     * @skip_dots:    whether to skip "." and ".."
+     * return:    0 OR -1
+     * # the directory opened previously is closed at first
+     */
+    int open(int dirfd, const char *path, bool skip_dots = true);
+
+    /**
+     * next - get next entry
+     * @name:     where to store the pointer to the entry name,it is
+     *            valid until next call to next()
+     * @type:     where to store the type of the entry
+     * return:    1 => got an entry
+     *            0 => no more entry
+     *            -1 => error
+     */
+    int next(const char *&name, dentry_type &type);
+
+    /* fd - fd of current directory,can be used by *at() routines */
+    int fd(void) const noexcept { return fd_; }
+
+    void close(void);
+
+  private:
+    std::unique_ptr<char[]> buf_;
+    std::size_t buf_size_;
+    std::size_t buf_pos_;
+    std::size_t buf_end_;
+    int fd_;
+    bool skip_dots_;
+  };
+
+}
+
+#endif
@@ -0,0 +1,114 @@
+/**
+ * Monster Hunter World Iceborne Mod Manager Dispatch
+ * This file contains the definition of perfect hash table,which
+ * maps the names of commands and config keys to their descriptors.
+ * The table is built at compile time from a descriptor array.
+ */
+#ifndef _MHWIMM_DISPATCH_H_
+#define _MHWIMM_DISPATCH_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <string_view>
+
+namespace mhwimm_dispatch_ns {
+
+  /* dispatch_hash - seeded FNV-1a of @key */
+  constexpr uint32_t dispatch_hash(std::string_view key, uint32_t seed) noexcept
+  {
+    uint32_t h(2166136261u ^ seed);
+    for (char c : key) {
+      h ^= static_cast<unsigned char>(c);
+      h *= 16777619u;
+    }
+    return h;
+  }
+
+  /* dispatch_slots - power of 2 no less than twice of @n */
+  constexpr std::size_t dispatch_slots(std::size_t n) noexcept
+  {
+    std::size_t m(1);
+    while (m < n * 2)
+      m <<= 1;
+    return m;
+  }
+
+  /**
+   * perfect_hash_table - maps a name to the descriptor has the same
+   *                      name without collision
+   * @_Descriptor:        descriptor type,must have member @name which
+   *                      is convertible to std::string_view
+   * @_N:                 number of descriptors
+   * # the seed is searched at compile time,duplicate names or no seed
+   *   found makes the constant evaluation failed,so a new descriptor
+   *   is checked by the compiler.
+   */
+  template<typename _Descriptor, std::size_t _N>
+  class perfect_hash_table final {
+  public:
+    static constexpr std::size_t nslots = dispatch_slots(_N);
+
+    constexpr perfect_hash_table(const _Descriptor (&descriptors)[_N])
+      : descriptors_{}, slots_{}, seed_(0)
+    {
+      for (std::size_t i(0); i < _N; ++i) {
+        descriptors_[i] = descriptors[i];
+        for (std::size_t j(0); j < i; ++j)
+          if (std::string_view(descriptors[i].name) == std::string_view(descriptors[j].name))
+            throw "perfect_hash_table: duplicate name";
+      }
+
+      for (; seed_ < max_seed; ++seed_)
+        if (try_seed())
+          return;
+      throw "perfect_hash_table: no seed found";
+    }
+
+    /**
+     * find - lookup the descriptor named @key
+     * return: pointer to the descriptor => found
+     *         nullptr => no such name
+     */
+    constexpr const _Descriptor *find(std::string_view key) const noexcept
+    {
+      uint8_t slot(slots_[dispatch_hash(key, seed_) & (nslots - 1)]);
+      if (slot == empty_slot || std::string_view(descriptors_[slot].name) != key)
+        return nullptr;
+      return &descriptors_[slot];
+    }
+
+    /* descriptors - all descriptors in the order they were given */
+    constexpr const std::array<_Descriptor, _N> &descriptors(void) const noexcept
+    {
+      return descriptors_;
+    }
+
+  private:
+    static_assert(_N < 255, "perfect_hash_table: too many descriptors");
+    static constexpr uint8_t empty_slot = 0xff;
+    static constexpr uint32_t max_seed = 1 << 16;
+
+    /* try_seed - place all names by @seed_,false if any collision */
+    constexpr bool try_seed(void) noexcept
+    {
+      for (auto &s : slots_)
+        s = empty_slot;
+      for (std::size_t i(0); i < _N; ++i) {
+        auto &s(slots_[dispatch_hash(descriptors_[i].name, seed_) & (nslots - 1)]);
+        if (s != empty_slot)
+          return false;
+        s = static_cast<uint8_t>(i);
+      }
+      return true;
+    }
+
+    std::array<_Descriptor, _N> descriptors_;
+    std::array<uint8_t, nslots> slots_;
+    uint32_t seed_;
+  };
+
+}
+
+#endif
@@ -7,12 +7,23 @@
 
 #include "mhwimm_config.h"
 #include "mhwimm_sync_mechanism.h"
+#include "mhwimm_thread_pool.h"
+#include "mhwimm_fsbatch.h"
+#include "mhwimm_journal.h"
+#include "mhwimm_deploy.h"
+#include "mhwimm_archive.h"
+#include "mhwimm_store.h"
+#include "mhwimm_output.h"
 
 #include <cstddef>
 #include <cstdint>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <list>
+#include <memory>
+#include <functional>
+#include <future>
 
 #include <cassert>
 
@@ -20,11 +31,15 @@ namespace mhwimm_executor_ns {
   /**
    * mhwimm_executor_cmd - all supported cmds of executor
    * cd <pathname>
-   * ls
-   * install <mod name> <mod directory>
+   * ls [-l] [-s] [--sort=name|size|time] [--filter=<pattern>]
+   * install <mod name> <mod directory | mod archive>
    * uninstall <mod name>
+   * update <mod name> <mod directory>
    * installed
    * config <key>=<value>
+   * store gc
+   * reconcile [mod name]
+   * verify [mod name]
    * exit
    * command / help
    */
@@ -34,15 +49,43 @@ namespace mhwimm_executor_ns {
     LS,
     INSTALL,
     UNINSTALL,
+    UPDATE,
     INSTALLED,
     GET_CONFIG,
     CONFIG,
+    STORE,
+    RECONCILE,
+    VERIFY,
     EXIT,
     COMMANDS,
     HELP = COMMANDS,
     NOP
   };
 
+  /* ls_sort_key - how "ls" sorts the entries */
+  enum class ls_sort_key : uint8_t {
+    LS_SORT_NONE,
+    LS_SORT_NAME,
+    LS_SORT_SIZE,
+    LS_SORT_TIME
+  };
+
+  /**
+   * ls_options - options of command "ls"
+   * @long_format:  -l,type,permission,size,mtime before name
+   * @show_blocks:  -s,allocated size in KiB before name
+   * @sort_key:     --sort=,name ascending,size and time descending,
+   *                LS_SORT_NONE keeps the order of directory
+   * @filter:       --filter=,shell wildcard pattern matches name,
+   *                it refers to the command line
+   */
+  struct ls_options {
+    bool long_format;
+    bool show_blocks;
+    ls_sort_key sort_key;
+    std::string_view filter;
+  };
+
   /* mhwimm_executor_tatus - Executor status */
   enum class mhwimm_executor_status : uint8_t {
     IDLE,
@@ -65,15 +108,12 @@ namespace mhwimm_executor_ns {
         current_cmd_ = mhwimm_executor_cmd::NOP;
         current_status_ = mhwimm_executor_status::IDLE;
         nparams_ = 0;
-        noutput_msgs_ = 0;
-        is_cmd_has_output_ = false;
-        output_info_index_ = 0;
-        parameters_.resize(8);
-        cmd_output_msgs_.resize(8);
+        journal_recovering_ = false;
+        parameters_.resize(max_nparams);
       }
 
-    // no destructor,because the data members of this class
-    // without dynamically allocating.
+    // no destructor,because the only dynamically allocated
+    // data member is owned by std::unique_ptr.
 
     // disabled copying,moving.
     mhwimm_executor(const mhwimm_executor &) =delete;
@@ -81,33 +121,37 @@ namespace mhwimm_executor_ns {
     mhwimm_executor(mhwimm_executor &&) =delete;
     mhwimm_executor &operator=(mhwimm_executor &&) =delete;
     
-    int parseCMD(const std::string &cmd_string) noexcept;
+    int parseCMD(std::string_view cmd_line) noexcept;
     int executeCurrentCMD(void) noexcept;
 
-    int getCMDOutput(std::string &buf) noexcept
+    /**
+     * getCMDOutput - hand over the command output in chunks,each one
+     *                has the whole lines no more than @max_bytes
+     * return:        0 => @buf is set,-1 => no more output
+     */
+    int getCMDOutput(std::string &buf,
+                     std::size_t max_bytes = mhwimm_output_ns::OUTPUT_CHUNK_SIZE) noexcept
     {
-      if (output_info_index_ == noutput_msgs_)
-        is_cmd_has_output_ = false;
-
-      if (is_cmd_has_output_ && output_info_index_ < noutput_msgs_) {
-        buf = cmd_output_msgs_[output_info_index_++];
+      if (output_.nextChunk(buf, max_bytes) == 0)
         return 0;
-      }
       clearGetOutputHistory();
       return -1;
     }
 
-    const auto &getCurrentModName(void) const
+    std::string_view getCurrentModName(void) const
     {
       assert(current_cmd_ == mhwimm_executor_cmd::INSTALL ||
-             current_cmd_ == mhwimm_executor_cmd::UNINSTALL);
-      return parameters_[0];
+             current_cmd_ == mhwimm_executor_cmd::UNINSTALL ||
+             current_cmd_ == mhwimm_executor_cmd::UPDATE ||
+             current_cmd_ == mhwimm_executor_cmd::RECONCILE ||
+             current_cmd_ == mhwimm_executor_cmd::VERIFY);
+      // the mod name of RECONCILE and VERIFY is optional
+      return nparams_ ? parameters_[0] : std::string_view();
     }
 
     void clearGetOutputHistory(void) noexcept
     {
-      output_info_index_ = 0;
-      is_cmd_has_output_ = false;
+      output_.clear();
     }
 
     void bypassSyntaxChecking(std::size_t new_nparams) noexcept
@@ -123,10 +167,104 @@ namespace mhwimm_executor_ns {
       current_status_ = mhwimm_executor_status::IDLE;
       current_cmd_ = mhwimm_executor_cmd::NOP;
       clearGetOutputHistory();
+      pending_record_ = std::future<bool>();
+      update_staged_.clear();
+      update_replaced_.clear();
+      update_removed_files_.clear();
+      update_removed_dirs_.clear();
     }
 
     void setMFLImpl(mhwimm_sync_mechanism_ns::mod_files_list *mfl) { mfiles_list_ = mfl; }
 
+    /**
+     * setConflictQuery - setup the routine used by INSTALL to ask DB
+     *                    which files of the mod been owned by another
+     * @query:            it should fill mod_files_list::conflict_list
+     *                    and return 0,or return -1 if failed
+     * # the lock of mod_files_list is not held when @query is called.
+     */
+    void setConflictQuery(std::function<int(void)> query) { conflict_query_ = std::move(query); }
+
+    /**
+     * setRecordSubmit - setup the routine used by INSTALL to queue the
+     *                   records of the mod before deploying it
+     * @submit:          it should queue the records which are committed
+     *                   only if @gate becomes true,and return the future
+     *                   of the request
+     * # DB inserts the records while the files are deployed,the lock of
+     *   mod_files_list is held by INSTALL until the gate opened.
+     * # INSTALL records nothing if it is not set,the thread worker has
+     *   to request DB after INSTALL.
+     */
+    void setRecordSubmit(std::function<std::future<bool>(std::shared_future<bool> gate)> submit)
+    {
+      record_submit_ = std::move(submit);
+    }
+
+    /**
+     * setRecordStream - setup the routine used by UNINSTALL to stream
+     *                   the records of the mod
+     * @ask:             it should queue the request which pushes the
+     *                   records to the stream,and return its future
+     * # the files are removed chunk by chunk while DB is stepping the
+     *   cursor,thus the thread worker does not load the records
+     *   before UNINSTALL.
+     * # UNINSTALL removes the files in mod_files_list if it is not set.
+     */
+    void setRecordStream(std::function<std::future<bool>(mhwimm_sync_mechanism_ns::path_stream *)> ask)
+    {
+      record_stream_ = std::move(ask);
+    }
+
+    /* hasRecordStream - whether UNINSTALL streams the records by itself */
+    bool hasRecordStream(void) const noexcept { return static_cast<bool>(record_stream_); }
+
+    /**
+     * setOutputSink - setup the routine receives the output chunks of
+     *                 a command before it accomplished
+     * # a command produces huge output(e.g. ls) flushes the lines been
+     *   stored to @sink,thus the output arena stays bounded.
+     * # getCMDOutput() hands over the rest after the command.
+     */
+    void setOutputSink(std::function<void(const std::string &)> sink)
+    {
+      output_sink_ = std::move(sink);
+    }
+
+    /* hasPendingRecord - whether INSTALL queued the records */
+    bool hasPendingRecord(void) const noexcept { return pending_record_.valid(); }
+
+    /* waitPendingRecord - wait the records queued by INSTALL been committed */
+    bool waitPendingRecord(void) { return pending_record_.get(); }
+
+    /**
+     * loadJournal - check whether an unfinished journal been left
+     * @cmd:         where to store the command wrote the journal
+     * @mod_name:    where to store the mod name
+     * return:       1 => found
+     *               0 => no journal
+     *               -1 => error
+     */
+    int loadJournal(mhwimm_journal_ns::journal_cmd &cmd, std::string &mod_name);
+
+    /* commitJournal - finish INSTALL / UNINSTALL,remove the journal */
+    int commitJournal(void);
+
+    /* rollbackJournal - undo INSTALL by the journal,then remove it */
+    int rollbackJournal(void);
+
+    /* resumeJournal - complete the remaining operations of UNINSTALL */
+    int resumeJournal(void);
+
+    /**
+     * finishUpdate - replace the changed files by the staged ones,and
+     *                remove the files and directories no longer in the
+     *                mod,called by thread worker after DB recorded the
+     *                delta of UPDATE
+     * return:        0 OR -1
+     */
+    int finishUpdate(void);
+
   private:
 
     // some command may always return _zero_
@@ -135,9 +273,13 @@ namespace mhwimm_executor_ns {
     int ls(void) noexcept;
     int install(void) noexcept;
     int uninstall(void) noexcept;
+    int update(void) noexcept;
     int installed(void) noexcept;
     int get_config(void) noexcept;
     int config(void) noexcept;
+    int store(void) noexcept;
+    int reconcile(void) noexcept;
+    int verify(void) noexcept;
     int exit(void) noexcept;
     int commands(void) noexcept;
 
@@ -149,18 +291,21 @@ namespace mhwimm_executor_ns {
 
     bool cmd_cd_syntaxChecking(void) { return syntaxChecking(1); }
     bool cmd_pwd_syntaxChecking(void) { return syntaxChecking(0); }
-    bool cmd_ls_syntaxChecking(void) { return syntaxChecking(0); }
+    bool cmd_ls_syntaxChecking(void);
     bool cmd_install_syntaxChecking(void)
     {
-      if (syntaxChecking(2)) {
-        std::string mod_dir(parameters_[1]);
-        if (mod_dir[0] == '/')
+      // the third parameter is optional deploy strategy
+      if (syntaxChecking(2) || syntaxChecking(3)) {
+        if (parameters_[1][0] == '/')
           return false;
-        return true;
+        mhwimm_deploy_ns::deploy_strategy strategy;
+        return nparams_ == 2 ||
+          mhwimm_deploy_ns::parse_deploy_strategy(parameters_[2], strategy) == 0;
       }
       return false;
     }
     bool cmd_uninstall_syntaxChecking(void) { return syntaxChecking(1); }
+    bool cmd_update_syntaxChecking(void) { return cmd_install_syntaxChecking(); }
     bool cmd_installed_syntaxChecking(void) { return syntaxChecking(0); }
     bool cmd_get_config_syntaxChecking(void) { return syntaxChecking(1); }
 
@@ -177,10 +322,10 @@ namespace mhwimm_executor_ns {
       // second,checks if the pair is correct format
       std::size_t nspace_character(0);
       std::size_t nequal_character(0);
-      auto equal_pos(parameters_[0].begin());
+      std::size_t equal_pos(0);
 
-      for (auto idx(equal_pos); idx != parameters_[0].end(); ++idx) {
-        char c(*idx);
+      for (std::size_t idx(0); idx < parameters_[0].length(); ++idx) {
+        char c(parameters_[0][idx]);
         if (c == ' ')
           ++nspace_character;
         else if (c == '=') {
@@ -193,25 +338,51 @@ namespace mhwimm_executor_ns {
         return false;
 
       // third,splite "key=value" pair to two parameters
-      std::string key(parameters_[0].substr(0, equal_pos - parameters_[0].begin()));
-      std::string val(parameters_[0].substr(equal_pos - parameters_[0].begin() + 1,
-                                            parameters_[0].end() - equal_pos - 1));
-
-      parameters_[0] = key;
-      parameters_[1] = val;
+      parameters_[1] = parameters_[0].substr(equal_pos + 1);
+      parameters_[0] = parameters_[0].substr(0, equal_pos);
       return true;
     }
+    bool cmd_store_syntaxChecking(void)
+    {
+      // "gc" is the only sub-command now
+      return syntaxChecking(1) && parameters_[0] == "gc";
+    }
+    bool cmd_reconcile_syntaxChecking(void) { return syntaxChecking(0) || syntaxChecking(1); }
+    bool cmd_verify_syntaxChecking(void) { return cmd_reconcile_syntaxChecking(); }
     bool cmd_exit_syntaxChecking(void) { return true; }
     bool cmd_commands_syntaxChecking(void) { return true; }
     bool cmd_help_syntaxChecking(void) { return cmd_commands_syntaxChecking(); }
 
-    void generic_err_msg_output(const std::string &err_msg) noexcept
+    /* workerPool - thread pool used by filesystem works */
+    mhwimm_thread_pool_ns::work_stealing_pool &workerPool(void);
+
+    /* fsBatch - batch executor used by install and uninstall */
+    mhwimm_fsbatch_ns::fs_batch &fsBatch(void);
+
+    /* contentStore - content store under mhwimm root,it might be not opened */
+    mhwimm_store_ns::content_store &contentStore(void);
+
+    int ingestModFiles(const std::string &moddir, mhwimm_archive_ns::archive_reader *archive,
+                       std::vector<std::string> &blob_paths);
+
+    std::string journalPath(void) const;
+    int removeUpdatedPaths(int mhwiroot_fd);
+    int journaledExecute(int dirfd, std::vector<mhwimm_fsbatch_ns::fs_op> &ops,
+                         mode_t mode, std::size_t &nfailed,
+                         mhwimm_deploy_ns::deploy_strategy strategy =
+                         mhwimm_deploy_ns::deploy_strategy::DEPLOY_LINK);
+    int journaledExecute(std::vector<mhwimm_fsbatch_ns::fs_op> &ops, std::size_t &nfailed,
+                         const std::function<std::size_t(mhwimm_fsbatch_ns::fs_op *,
+                                                         std::size_t)> &executor);
+
+    void generic_err_msg_output(std::string_view err_msg) noexcept
     {
-      cmd_output_msgs_[0] = err_msg;
-      noutput_msgs_ = 1;
-      is_cmd_has_output_ = true;
+      output_.clear();
+      output_.append(err_msg);
     }
 
+    void conflicts_err_msg_output(void) noexcept;
+
     // we need two external pointers
     // the first is : pointer to config structure
     // the second is : pointer to mod file list structure
@@ -229,14 +400,64 @@ namespace mhwimm_executor_ns {
         vec.resize(2 * vec.capacity());
     }
 
+    /* max_nparams - the parameters more than it are counted only */
+    static constexpr std::size_t max_nparams = 8;
+
+    /**
+     * parameters_ - slices of the command line been parsed,the line
+     *               must be kept until the command accomplished
+     */
     std::size_t nparams_;
-    std::vector<std::string> parameters_;
+    std::vector<std::string_view> parameters_;
+
+    /* output_ - output lines of current command */
+    mhwimm_output_ns::output_arena output_;
+
+    /* conflict_query_ - set by thread worker,used by install() */
+    std::function<int(void)> conflict_query_;
+
+    /* ls_opts_ - options of "ls",set by cmd_ls_syntaxChecking() */
+    ls_options ls_opts_;
+
+    /* output_sink_ - set by thread worker,used by flushCMDOutput() */
+    std::function<void(const std::string &)> output_sink_;
+    void flushCMDOutput(void);
+
+    /* record_submit_ - set by thread worker,used by install() */
+    std::function<std::future<bool>(std::shared_future<bool>)> record_submit_;
+
+    /* record_stream_ - set by thread worker,used by uninstall() */
+    std::function<std::future<bool>(mhwimm_sync_mechanism_ns::path_stream *)> record_stream_;
+
+    /* pending_record_ - future of the records queued by install() */
+    std::future<bool> pending_record_;
+
+    /**
+     * update_* - what update() left to finishUpdate()
+     * @update_staged_:        the changed files deployed under staged names
+     * @update_replaced_:      the paths replaced by @update_staged_ in order
+     * @update_removed_files_: the regular files no longer in the mod
+     * @update_removed_dirs_:  the directories no longer in the mod
+     */
+    mhwimm_path_list_ns::path_list update_staged_;
+    mhwimm_path_list_ns::path_list update_replaced_;
+    mhwimm_path_list_ns::path_list update_removed_files_;
+    mhwimm_path_list_ns::path_list update_removed_dirs_;
+
+    /* worker_pool_ - created by workerPool() when first time to use */
+    std::unique_ptr<mhwimm_thread_pool_ns::work_stealing_pool> worker_pool_;
+
+    /* fs_batch_ - created by fsBatch() when first time to use */
+    std::unique_ptr<mhwimm_fsbatch_ns::fs_batch> fs_batch_;
+
+    /* content_store_ - opened by contentStore() when first time to use */
+    mhwimm_store_ns::content_store content_store_;
 
-    std::size_t noutput_msgs_;
-    std::vector<std::string> cmd_output_msgs_;
-    bool is_cmd_has_output_;
+    /* journal_ - intent journal of the INSTALL / UNINSTALL in progress */
+    mhwimm_journal_ns::intent_journal journal_;
 
-    std::size_t output_info_index_;
+    /* journal_recovering_ - the journal left by last run is loaded */
+    bool journal_recovering_;
   };
 
 }
@@ -5,8 +5,27 @@
 #define _MHWIMM_EXECUTOR_THREAD_H_
 
 #include "mhwimm_executor.h"
+#include "mhwimm_database.h"
 #include "mhwimm_sync_mechanism.h"
 
+#include <functional>
+#include <future>
+#include <string>
+#include <vector>
+
+/**
+ * db_round_t - one round with DB,the callable argument queues the DB
+ *              request and returns its future,returns whether the
+ *              request succeed
+ */
+using db_round_t = std::function<bool(const std::function<std::future<bool>(void)> &)>;
+
+/**
+ * cmd_output_t - receives a chunk of command output,the lines are
+ *                separated by '\n'
+ */
+using cmd_output_t = std::function<void(const std::string &)>;
+
 /**
  * mhwimm_executor_thread_worker - C++ multithread worker for Executor
  * @exe:        lvalue reference to Executor handler
@@ -18,4 +37,21 @@ void mhwimm_executor_thread_worker(mhwimm_executor_ns::mhwimm_executor &exe,
                                    mhwimm_sync_mechanism_ns::uiexemsgexchg &ctrlmsg,
                                    mhwimm_sync_mechanism_ns::mod_files_list &mfiles_list);
 
+/**
+ * mhwimm_executor_batch_worker - non-interactive worker,executes command
+ *                                lines in caller's thread
+ * @exe:        lvalue reference to Executor handler
+ * @mfiles_list:    lvalue reference to a structure which contains the
+ *                  necessary containers
+ * @db:         lvalue reference to database handler which been prepared
+ * @cmd_lines:  command lines to be executed in order
+ * @keep_going: do not stop at the first failed command
+ * return:      the count of failed commands
+ */
+int mhwimm_executor_batch_worker(mhwimm_executor_ns::mhwimm_executor &exe,
+                                 mhwimm_sync_mechanism_ns::mod_files_list &mfiles_list,
+                                 mhwimm_db_ns::mhwimm_db &db,
+                                 const std::vector<std::string> &cmd_lines,
+                                 bool keep_going);
+
 #endif
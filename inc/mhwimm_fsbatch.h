@@ -0,0 +1,112 @@
+/**
+ * Monster Hunter World Iceborne Mod Manager Filesystem Batch
+ * This file contains the definition of the batch executor for
+ * filesystem metadata operations,the operations are submitted
+ * to io_uring in large batches if the kernel supports it,else
+ * they are executed one by one.
+ */
+#ifndef _MHWIMM_FSBATCH_H_
+#define _MHWIMM_FSBATCH_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <memory>
+
+#include <sys/types.h>
+
+namespace mhwimm_fsbatch_ns {
+
+  /**
+   * fs_op_type - type of metadata operation
+   * FS_MKDIR:    mkdirat(dirfd, path, mode)
+   * FS_LINK:     linkat(AT_FDCWD, src, dirfd, path, 0)
+   * FS_UNLINK:   unlinkat(dirfd, path, 0)
+   * FS_RMDIR:    unlinkat(dirfd, path, AT_REMOVEDIR)
+   * FS_COPY:     copy src to path,it is not a metadata operation,
+   *              executed by mhwimm_deploy_ns::copy_files(),fs_batch
+   *              fails it with -EINVAL
+   * FS_EXTRACT:  write the archive entry path to path,executed by
+   *              mhwimm_archive_ns::archive_reader,fs_batch fails it
+   *              with -EINVAL
+   */
+  enum class fs_op_type : uint8_t {
+    FS_MKDIR,
+    FS_LINK,
+    FS_UNLINK,
+    FS_RMDIR,
+    FS_COPY,
+    FS_EXTRACT
+  };
+
+  /* fs_op_pending - result of the operation which has not been executed */
+  constexpr int fs_op_pending = 1;
+
+  /**
+   * fs_op - one metadata operation
+   * @type:  operation type
+   * @path:  path relative to the dirfd of the batch
+   * @src:   FS_LINK and FS_COPY,the existed file,relative to
+   *         current work directory if not absolute
+   * @result:    0 => succeed
+   *             -errno => failed
+   *             fs_op_pending => not executed
+   * # the strings must be valid until the batch completed.
+   */
+  struct fs_op {
+    fs_op_type type;
+    const char *path;
+    const char *src;
+    int result;
+  };
+
+  /**
+   * fs_batch - batch executor
+   * # each operation in one batch must not depend on the others,
+   *   because the order of completion is not defined,e.g. a
+   *   directory and its subdirectory must be made in two batches.
+   * # the result of each operation is stored in the operation,
+   *   thus caller knows exactly what been done.
+   */
+  class fs_batch final {
+  public:
+    /* default number of submission queue entries */
+    static constexpr unsigned int default_entries = 256;
+
+    explicit fs_batch(unsigned int entries = default_entries);
+    ~fs_batch();
+
+    // disabled copying,moving
+    fs_batch(const fs_batch &) =delete;
+    fs_batch &operator=(const fs_batch &) =delete;
+    fs_batch(fs_batch &&) =delete;
+    fs_batch &operator=(fs_batch &&) =delete;
+
+    /**
+     * execute - execute @ops
+     * @dirfd:   directory fd OR AT_FDCWD,@fs_op.path is relative to it
+     * @ops:     operations
+     * @nops:    number of operations
+     * @mode:    mode for FS_MKDIR
+     * return:   number of failed operations
+     */
+    std::size_t execute(int dirfd, fs_op *ops, std::size_t nops, mode_t mode);
+
+    /* isUringEnabled - whether operations are submitted to io_uring */
+    bool isUringEnabled(void) const noexcept { return uring_ != nullptr; }
+
+  private:
+    struct uring_impl;
+
+    void executeSync(int dirfd, fs_op *ops, std::size_t nops, mode_t mode);
+
+    /* executeUring - return the index of the first operation not submitted */
+    std::size_t executeUring(int dirfd, fs_op *ops, std::size_t nops, mode_t mode);
+
+    /* uring_ - nullptr if io_uring is unavailable */
+    std::unique_ptr<uring_impl> uring_;
+  };
+
+}
+
+#endif
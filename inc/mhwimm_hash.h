@@ -0,0 +1,54 @@
+/**
+ * Monster Hunter World Iceborne Mod Manager Content Hash
+ * This file contains the definition of XXH64,the hash used to
+ * identify the content of mod files.
+ */
+#ifndef _MHWIMM_HASH_H_
+#define _MHWIMM_HASH_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <string>
+
+namespace mhwimm_hash_ns {
+
+  /**
+   * xxh64_state - streaming XXH64
+   * # the output is the same as the reference implementation,
+   *   no matter how the input been split.
+   */
+  class xxh64_state final {
+  public:
+    explicit xxh64_state(uint64_t seed = 0) { reset(seed); }
+
+    void reset(uint64_t seed = 0) noexcept;
+    void update(const void *data, std::size_t len) noexcept;
+    uint64_t digest(void) const noexcept;
+
+  private:
+    uint64_t acc_[4];
+    uint64_t seed_;
+    uint64_t total_len_;
+    /* buf_ - input not reach a stripe */
+    unsigned char buf_[32];
+    std::size_t buf_len_;
+  };
+
+  /**
+   * hash_fd - hash the content of @fd from current offset to the end
+   * @digest:  where to store XXH64 of the content
+   * @size:    where to store number of bytes hashed
+   * return:   0 OR -errno
+   */
+  int hash_fd(int fd, uint64_t &digest, uint64_t &size);
+
+  /**
+   * content_key - key of the content,"<digest>-<size>" in hex,the
+   *               size reduces the chance of collision further
+   */
+  std::string content_key(uint64_t digest, uint64_t size);
+
+}
+
+#endif
@@ -0,0 +1,142 @@
+/**
+ * Monster Hunter World Iceborne Mod Manager Intent Journal
+ * This file contains the definition of the write-ahead intent
+ * journal,INSTALL and UNINSTALL record the filesystem operations
+ * into it before execute them,thus an interrupted command can be
+ * rolled back or resumed at the next startup.
+ */
+#ifndef _MHWIMM_JOURNAL_H_
+#define _MHWIMM_JOURNAL_H_
+
+#include "mhwimm_fsbatch.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <string>
+#include <vector>
+
+namespace mhwimm_journal_ns {
+
+  /**
+   * journal_cmd - the command which wrote the journal
+   * JOURNAL_INSTALL:    install,roll back if the mod is not recorded
+   * JOURNAL_UNINSTALL:  uninstall,resume the remaining operations
+   * JOURNAL_UPDATE:     update,roll back the files deployed,the mod
+   *                     converges by updating it again
+   */
+  enum class journal_cmd : uint8_t {
+    JOURNAL_INSTALL = 1,
+    JOURNAL_UNINSTALL,
+    JOURNAL_UPDATE
+  };
+
+  /**
+   * journal_op_state - state of a planned operation
+   * OP_UNKNOWN:   planned,but the completion is not recorded
+   * OP_DONE:      succeed
+   * OP_FAILED:    failed,nothing been changed
+   */
+  enum class journal_op_state : uint8_t {
+    OP_UNKNOWN,
+    OP_DONE,
+    OP_FAILED
+  };
+
+  /**
+   * journal_batch - one batch of operations
+   * @type:    operation type
+   * @paths:   paths relative to @journal_content.root
+   * @states:  state of each operation
+   */
+  struct journal_batch {
+    mhwimm_fsbatch_ns::fs_op_type type;
+    std::vector<std::string> paths;
+    std::vector<journal_op_state> states;
+  };
+
+  /**
+   * journal_content - content loaded from journal file
+   * @cmd:         command
+   * @mod_name:    name of the mod
+   * @root:        mhwi root when the journal was written
+   * @src_root:    mod directory,empty for UNINSTALL
+   * @batches:     batches in the order of execution
+   */
+  struct journal_content {
+    journal_cmd cmd;
+    std::string mod_name;
+    std::string root;
+    std::string src_root;
+    std::vector<journal_batch> batches;
+  };
+
+  /**
+   * intent_journal - writer of journal file
+   * # file format,integers are in host byte order :
+   *     header : "MHWJ" version(u8) cmd(u8)
+   *              len(u16) mod_name len(u16) root len(u16) src_root
+   *     PLAN   : 'P' type(u8) n(u32) { len(u16) path } * n
+   *     DONE   : 'D' n(u32) bitmap((n + 7) / 8),bit set => succeed,
+   *              it is the completion of the last PLAN
+   * # PLAN is flushed to disk before the batch is executed,DONE is
+   *   not,because the operations of a lost DONE can be checked.
+   * # the size of journal is proportional to the operations have been
+   *   started,not to the size of the mod.
+   */
+  class intent_journal final {
+  public:
+    intent_journal() : fd_(-1) {}
+    ~intent_journal() { close(); }
+
+    // disabled copying,moving
+    intent_journal(const intent_journal &) =delete;
+    intent_journal &operator=(const intent_journal &) =delete;
+    intent_journal(intent_journal &&) =delete;
+    intent_journal &operator=(intent_journal &&) =delete;
+
+    /**
+     * begin - create journal file @path and write header
+     * return: 0 OR -1
+     * # fails if @path is existed,an unfinished journal must be
+     *   recovered at first.
+     */
+    int begin(const std::string &path, journal_cmd cmd, const std::string &mod_name,
+              const std::string &root, const std::string &src_root);
+
+    /* plan - record @ops,and flush them to disk */
+    int plan(mhwimm_fsbatch_ns::fs_op_type type,
+             const mhwimm_fsbatch_ns::fs_op *ops, std::size_t nops);
+
+    /* done - record the results of @ops which been planned last time */
+    int done(const mhwimm_fsbatch_ns::fs_op *ops, std::size_t nops);
+
+    /* commit - close and remove the journal,the command finished */
+    int commit(void);
+
+    /* close - close journal file,the file is kept for recovery */
+    void close(void);
+
+    bool isOpened(void) const noexcept { return fd_ >= 0; }
+
+    /**
+     * load - load journal file @path
+     * @content:  where to store
+     * return:    1 => loaded
+     *            0 => no journal,or the header is incomplete
+     *            -1 => error
+     * # incomplete record at the tail is ignored,it was being written
+     *   when the program stopped.
+     */
+    static int load(const std::string &path, journal_content &content);
+
+  private:
+    int append(const std::string &record, bool sync);
+
+    std::string path_;
+    int fd_;
+  };
+
+}
+
+#endif
@@ -0,0 +1,88 @@
+/**
+ * Monster Hunter World Iceborne Mod Manager Command Output
+ * This file contains the definition of output arena,where the
+ * output lines of a command are stored.
+ */
+#ifndef _MHWIMM_OUTPUT_H_
+#define _MHWIMM_OUTPUT_H_
+
+#include <cstddef>
+
+#include <string>
+#include <string_view>
+
+namespace mhwimm_output_ns {
+
+  /* OUTPUT_CHUNK_SIZE - the bytes handed over to UI at once */
+  constexpr std::size_t OUTPUT_CHUNK_SIZE(64 * 1024);
+
+  /**
+   * output_arena - output lines of a command stored back to back in
+   *                one contiguous buffer,each line ends with '\n'
+   * # the buffer is reused by the next command,thus no allocation
+   *   once it grown up.
+   */
+  class output_arena final {
+  public:
+    output_arena() : nlines_(0), read_pos_(0) {}
+
+    /* append - append @line to the arena */
+    void append(std::string_view line)
+    {
+      buf_.append(line);
+      buf_.push_back('\n');
+      ++nlines_;
+    }
+
+    /* clear - drop all lines,the capacity is kept */
+    void clear(void) noexcept
+    {
+      buf_.clear();
+      nlines_ = 0;
+      read_pos_ = 0;
+    }
+
+    std::size_t lines(void) const noexcept { return nlines_; }
+    /* bytes - size of the lines not handed over */
+    std::size_t bytes(void) const noexcept { return buf_.length() - read_pos_; }
+    bool empty(void) const noexcept { return !nlines_; }
+
+    /**
+     * nextChunk - hand over the next lines no more than @max_bytes
+     * @chunk:     where to place,lines are separated by '\n' and
+     *             the last one has no '\n'
+     * @max_bytes: size limit of @chunk,a longer line is handed over
+     *             alone
+     * return:     0 => @chunk is set,-1 => no more lines
+     */
+    int nextChunk(std::string &chunk, std::size_t max_bytes = OUTPUT_CHUNK_SIZE)
+    {
+      if (read_pos_ >= buf_.length())
+        return -1;
+
+      std::size_t end(buf_.length() - 1);
+      if (buf_.length() - read_pos_ > max_bytes) {
+        // cut at the last '\n' in the window,or the end of the line
+        // which is longer than the window.
+        end = buf_.rfind('\n', read_pos_ + max_bytes - 1);
+        if (end == std::string::npos || end < read_pos_)
+          end = buf_.find('\n', read_pos_);
+      }
+
+      chunk.assign(buf_, read_pos_, end - read_pos_);
+      read_pos_ = end + 1;
+      return 0;
+    }
+
+    /* rewind - hand over from the first line again */
+    void rewind(void) noexcept { read_pos_ = 0; }
+
+  private:
+    std::string buf_;
+    std::size_t nlines_;
+    std::size_t read_pos_;
+  };
+
+}
+
+#endif
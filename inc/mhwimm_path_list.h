@@ -0,0 +1,169 @@
+/**
+ * Monster Hunter World Iceborne Mod Manager Path List
+ * This file contains the definition of path list,the paths
+ * are stored back to back in one byte arena,and located by
+ * an index of offset and length.
+ */
+#ifndef _MHWIMM_PATH_LIST_H_
+#define _MHWIMM_PATH_LIST_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mhwimm_path_list_ns {
+
+  /**
+   * path_type - type of the entry a path refers to
+   * PATH_DIRECTORY:    directory
+   * PATH_REGULAR:      regular file
+   * PATH_OTHER:        unknown,or the string is not a path,e.g. mod name
+   */
+  enum class path_type : uint8_t {
+    PATH_DIRECTORY,
+    PATH_REGULAR,
+    PATH_OTHER
+  };
+
+  /**
+   * path_list - list of paths in one contiguous arena
+   * # each path is followed by '\0' in the arena,thus data() of the
+   *   std::string_view can be passed to C routines.
+   * # like std::vector,push_back() invalidates the views and pointers
+   *   been handed over,they are stable once the list is complete.
+   * # clear() keeps the capacity,the list is reused by the next
+   *   command without allocation.
+   */
+  class path_list final {
+  public:
+    /**
+     * path_index - where a path is in the arena
+     * @off:   offset of the first character
+     * @len:   length,the '\0' is not counted
+     * @type:  type tag
+     */
+    struct path_index {
+      std::size_t off;
+      uint32_t len;
+      path_type type;
+    };
+
+    /* const_iterator - iterates the paths as std::string_view */
+    class const_iterator {
+    public:
+      using iterator_category = std::random_access_iterator_tag;
+      using value_type = std::string_view;
+      using difference_type = std::ptrdiff_t;
+      using pointer = void;
+      using reference = std::string_view;
+
+      const_iterator() : list_(nullptr), idx_(0) {}
+      const_iterator(const path_list *list, std::size_t idx) : list_(list), idx_(idx) {}
+
+      std::string_view operator*(void) const { return (*list_)[idx_]; }
+      std::string_view operator[](difference_type n) const { return (*list_)[idx_ + n]; }
+      const_iterator &operator++(void) { ++idx_; return *this; }
+      const_iterator operator++(int) { const_iterator t(*this); ++idx_; return t; }
+      const_iterator &operator--(void) { --idx_; return *this; }
+      const_iterator operator--(int) { const_iterator t(*this); --idx_; return t; }
+      const_iterator &operator+=(difference_type n) { idx_ += n; return *this; }
+      const_iterator &operator-=(difference_type n) { idx_ -= n; return *this; }
+      const_iterator operator+(difference_type n) const { return const_iterator(list_, idx_ + n); }
+      const_iterator operator-(difference_type n) const { return const_iterator(list_, idx_ - n); }
+      difference_type operator-(const const_iterator &o) const
+      {
+        return static_cast<difference_type>(idx_) - static_cast<difference_type>(o.idx_);
+      }
+      bool operator==(const const_iterator &o) const { return idx_ == o.idx_; }
+      bool operator!=(const const_iterator &o) const { return idx_ != o.idx_; }
+      bool operator<(const const_iterator &o) const { return idx_ < o.idx_; }
+
+      /* index - position in the list */
+      std::size_t index(void) const noexcept { return idx_; }
+
+    private:
+      const path_list *list_;
+      std::size_t idx_;
+    };
+
+    path_list() =default;
+
+    /* push_back - append @path with tag @type */
+    void push_back(std::string_view path, path_type type = path_type::PATH_OTHER)
+    {
+      index_.push_back(path_index {
+          .off = arena_.length(),
+          .len = static_cast<uint32_t>(path.length()),
+          .type = type,
+        });
+      arena_.append(path);
+      arena_.push_back('\0');
+    }
+
+    /* reserve - reserve for @npaths paths which have @nbytes characters in total */
+    void reserve(std::size_t npaths, std::size_t nbytes)
+    {
+      index_.reserve(npaths);
+      arena_.reserve(nbytes + npaths);
+    }
+
+    void clear(void) noexcept
+    {
+      index_.clear();
+      arena_.clear();
+    }
+
+    std::size_t size(void) const noexcept { return index_.size(); }
+    bool empty(void) const noexcept { return index_.empty(); }
+
+    std::string_view operator[](std::size_t i) const noexcept
+    {
+      return std::string_view(arena_.data() + index_[i].off, index_[i].len);
+    }
+
+    /* c_str - the path terminated by '\0' */
+    const char *c_str(std::size_t i) const noexcept { return arena_.data() + index_[i].off; }
+    path_type type(std::size_t i) const noexcept { return index_[i].type; }
+
+    const_iterator begin(void) const noexcept { return const_iterator(this, 0); }
+    const_iterator end(void) const noexcept { return const_iterator(this, index_.size()); }
+    const_iterator cbegin(void) const noexcept { return begin(); }
+    const_iterator cend(void) const noexcept { return end(); }
+
+    /**
+     * sort - sort the paths in byte order,only the index is moved
+     * # a parent directory comes before its children,because the
+     *   parent is a prefix of them.
+     */
+    void sort(void)
+    {
+      const char *base(arena_.data());
+      std::sort(index_.begin(), index_.end(),
+                [base](const path_index &a, const path_index &b) {
+                  return std::string_view(base + a.off, a.len) <
+                    std::string_view(base + b.off, b.len);
+                });
+    }
+
+    /* reverse - reverse the order of the paths */
+    void reverse(void) { std::reverse(index_.begin(), index_.end()); }
+
+    void swap(path_list &other) noexcept
+    {
+      index_.swap(other.index_);
+      arena_.swap(other.arena_);
+    }
+
+  private:
+    std::vector<path_index> index_;
+    std::string arena_;
+  };
+
+}
+
+#endif
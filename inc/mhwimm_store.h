@@ -0,0 +1,118 @@
+/**
+ * Monster Hunter World Iceborne Mod Manager Content Store
+ * This file contains the definition of the content-addressed
+ * file store under mhwimm root,each distinct content is stored
+ * once as a blob,and mod files are hard linked from the blobs.
+ */
+#ifndef _MHWIMM_STORE_H_
+#define _MHWIMM_STORE_H_
+
+#include "mhwimm_thread_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <string>
+#include <unordered_set>
+
+namespace mhwimm_store_ns {
+
+  /**
+   * ingest_op - one file to be ingested into store
+   * @src:       file path,relative to current work directory if not
+   *             absolute
+   * @move:      @src is staged by us,it becomes the blob by rename,
+   *             or is removed if the blob existed
+   * @key:       content key of @src
+   * @result:    0 OR -errno
+   */
+  struct ingest_op {
+    const char *src;
+    bool move;
+    std::string key;
+    int result;
+  };
+
+  /**
+   * content_store - content-addressed store
+   * # layout : objects/<first two characters of key>/<key>
+   *            tmp/       blobs being copied
+   *            staging/   mod archives being extracted
+   * # blobs are read-only,a blob is complete once it appears under
+   *   objects,because it is renamed from tmp or staging.
+   */
+  class content_store final {
+  public:
+    content_store() : root_fd_(-1) {}
+    ~content_store() { close(); }
+
+    // disabled copying,moving
+    content_store(const content_store &) =delete;
+    content_store &operator=(const content_store &) =delete;
+    content_store(content_store &&) =delete;
+    content_store &operator=(content_store &&) =delete;
+
+    /**
+     * open - open store at @root,create it if not existed
+     * return:  0 OR -1
+     */
+    int open(const std::string &root);
+    void close(void);
+
+    bool isOpened(void) const noexcept { return root_fd_ >= 0; }
+    const std::string &root(void) const noexcept { return root_; }
+
+    /* blobPath - absolute path of the blob of @key */
+    std::string blobPath(const std::string &key) const;
+
+    /**
+     * ingest - hash @ops and store the contents not stored yet
+     * @pool:   files are hashed by the workers in parallel,the new
+     *          contents are cloned or copied as mhwimm_deploy_ns does
+     *          window by window,thus a large mod does not exhaust fds
+     * return:  number of failed operations
+     * # the operations of the same content share one blob.
+     */
+    std::size_t ingest(ingest_op *ops, std::size_t nops,
+                       mhwimm_thread_pool_ns::work_stealing_pool &pool);
+
+    /**
+     * isBlobLink - whether @path relative to @dirfd is a hard link of
+     *              the blob of its own content
+     */
+    bool isBlobLink(int dirfd, const char *path) const;
+
+    /**
+     * makeStaging - make an empty directory under staging
+     * @path:        where to store the absolute path
+     * return:       0 OR -1
+     */
+    int makeStaging(std::string &path);
+
+    /* removeStaging - remove the directory made by makeStaging() */
+    void removeStaging(const std::string &path);
+
+    /**
+     * gc - remove the blobs not referenced
+     * @referenced:   keys referenced by database
+     * @nremoved:     where to store number of removed blobs
+     * @nbytes:       where to store number of reclaimed bytes
+     * return:        0 OR -1
+     * # blob is kept if it is still linked by any file,even if it is
+     *   not referenced,because removing it reclaims nothing.
+     * # tmp and staging are emptied,they are left by interrupted runs.
+     */
+    int gc(const std::unordered_set<std::string> &referenced,
+           std::size_t &nremoved, uint64_t &nbytes);
+
+  private:
+    /* blobSubpath - path of the blob relative to root */
+    static std::string blobSubpath(const std::string &key);
+
+    std::string root_;
+    int root_fd_;
+  };
+
+}
+
+#endif
@@ -8,21 +8,16 @@
 #include <cstdint>
 
 #include <string>
+#include <string_view>
 #include <mutex>
-#include <condition_variable>
+#include <atomic>
+#include <future>
 #include <list>
+#include <vector>
 #include <cassert>
 
 #include "mhwimm_database.h"
-
-/* makeup_uniquelock_and_associate_condv
- *   - macro function used to build a local variable named @name
- *     is type of std::unique_lock<std::mutex>,and initializer
- *     it with @condv.lock_data.
- *     the unique lock is locked by default.
- */
-#define makeup_uniquelock_and_associate_condv(name, condv) \
-  std::unique_lock<std::mutex> name((condv).lock_data)
+#include "mhwimm_path_list.h"
 
 /* C99 standard */
 typedef int atomic_t;
@@ -30,111 +25,155 @@ typedef int atomic_t;
 namespace mhwimm_sync_mechanism_ns {
 
   /**
-   * conditionv - condition variable synchronization
-   * data members:
-   *   @lock_data:  std::mutex object
-   *   @condv:      condition variable
-   *   @value:      sequence counter
+   * spsc_ring - bounded lock-free ring for one producer and one consumer
+   * @_Type:     element type
+   * @_Size:     number of slots,must be power of 2
    * methods:
-   *   @conditionv:       constructor
-   *   @wait_cond_odd:    wait @value becomes odd
-   *   @wait_cond_even:   wait @value becomes even
-   *   @unlock:           unlock @lock
-   *   @update:           increase @value
-   *   @notify_one:       notify one instance which is waiting
-   *                      on @condv
-   *   @update_and_notify:    shortcut for unlock-update-notify
+   *   @push:      push an element,wait if the ring is full
+   *   @pop:       pop an element,wait if the ring is empty
+   *   @try_push:  push an element,false if the ring is full
+   *   @try_pop:   pop an element,false if the ring is empty
+   * # @head_ is only written by consumer,@tail_ is only written by
+   *   producer,the waiting side sleeps on the other one's index via
+   *   std::atomic wait/notify.
    */
-  struct conditionv {
-    std::mutex lock_data;
-    std::condition_variable condv;
-    atomic_t value;
+  template<typename _Type, std::size_t _Size>
+  class spsc_ring final {
+    static_assert(_Size && !(_Size & (_Size - 1)), "size of spsc_ring must be power of 2");
+
+  public:
+    spsc_ring() : head_(0), tail_(0) {}
 
-    conditionv()
-      : lock_data()
+    spsc_ring(const spsc_ring &) =delete;
+    spsc_ring &operator=(const spsc_ring &) =delete;
+
+    bool try_push(_Type &&e)
     {
-      value = 0;
+      std::size_t tail(tail_.load(std::memory_order_relaxed));
+      if (tail - head_.load(std::memory_order_acquire) == _Size)
+        return false;
+      store_and_publish(tail, std::move(e));
+      return true;
     }
 
-    void wait_cond_v(std::unique_lock<std::mutex> &unlocked_ul, int v)
+    void push(_Type &&e)
     {
-      assert(unlocked_ul.mutex() == &this->lock_data);
-      unlocked_ul.lock();
-      this->condv.wait(unlocked_ul,
-                       [&, this](void) -> bool {
-                         return this->value == v;
-                       });
+      std::size_t tail(tail_.load(std::memory_order_relaxed));
+      for (std::size_t head(head_.load(std::memory_order_acquire));
+           tail - head == _Size; head = head_.load(std::memory_order_acquire))
+        head_.wait(head, std::memory_order_acquire);
+      store_and_publish(tail, std::move(e));
     }
 
-    void wait_cond_odd(std::unique_lock<std::mutex> &unlocked_ul)
+    bool try_pop(_Type &e)
     {
-      assert(unlocked_ul.mutex() == &this->lock_data);
-      unlocked_ul.lock();
-      this->condv.wait(unlocked_ul,
-                       [&, this](void) -> bool {
-                         return this->value % 2;
-                       });
+      std::size_t head(head_.load(std::memory_order_relaxed));
+      if (tail_.load(std::memory_order_acquire) == head)
+        return false;
+      take_and_release(head, e);
+      return true;
     }
 
-    void wait_cond_even(std::unique_lock<std::mutex> &unlocked_ul)
+    void pop(_Type &e)
     {
-      assert(unlocked_ul.mutex() == &this->lock_data);
-      unlocked_ul.lock();
-      this->condv.wait(unlocked_ul,
-                       [&, this](void) -> bool {
-                         return !(this->value % 2);
-                       });
+      std::size_t head(head_.load(std::memory_order_relaxed));
+      for (std::size_t tail(tail_.load(std::memory_order_acquire));
+           tail == head; tail = tail_.load(std::memory_order_acquire))
+        tail_.wait(tail, std::memory_order_acquire);
+      take_and_release(head, e);
     }
 
-    void unlock(std::unique_lock<std::mutex> &locked_ul)
-    { 
-      assert(locked_ul.mutex() == &this->lock_data);
-      locked_ul.unlock();
+  private:
+    void store_and_publish(std::size_t tail, _Type &&e)
+    {
+      slots_[tail & (_Size - 1)] = std::move(e);
+      tail_.store(tail + 1, std::memory_order_release);
+      tail_.notify_one();
     }
 
-    void update(void) { ++value; }
-    void notify_one(void) { condv.notify_one(); }
-
-    void update_and_notify(std::unique_lock<std::mutex> &locked_ul)
+    void take_and_release(std::size_t head, _Type &e)
     {
-      update();
-      unlock(locked_ul);
-      notify_one();
+      e = std::move(slots_[head & (_Size - 1)]);
+      head_.store(head + 1, std::memory_order_release);
+      head_.notify_one();
     }
+
+    // the indexes are placed in different cache lines
+    alignas(64) std::atomic<std::size_t> head_;
+    alignas(64) std::atomic<std::size_t> tail_;
+    _Type slots_[_Size];
   };
 
-  /* UIEXE_STATUS - enumerators for uiexemsgexchg.status */
-  enum class UIEXE_STATUS : uint8_t { EXE_NOMSG, EXE_ONEMSG, EXE_MOREMSG, UI_CMD };
+  /**
+   * UIEXE_STATUS - enumerators for uiexemsg.status
+   * @EXE_STOPPED:  same as EXE_NOMSG,and Executor stopped after the
+   *                command,the commands queued behind are dropped
+   */
+  enum class UIEXE_STATUS : uint8_t { EXE_NOMSG, EXE_ONEMSG, EXE_MOREMSG, UI_CMD, EXE_STOPPED };
+
+  /**
+   * uiexemsg - message between UI and Executor
+   * @status:   type of this message,UI_CMD from UI,the others from
+   *            Executor
+   * @io_buf:   command line or a chunk of command output
+   */
+  struct uiexemsg {
+    UIEXE_STATUS status;
+    std::string io_buf;
+  };
+
+  /* UIEXE_RING_SIZE - number of messages can be queued in each direction */
+  constexpr std::size_t UIEXE_RING_SIZE(16);
 
   /**
    * uiexemsgexchg - structure used to represents the message exechanging
    *                 between UI and Executor
-   * @status:        current status of UI or Executor,used to tell each
-   *                 other what is the current status and what is the type
-   *                 of this message
-   * @new_msg:       indicator for whether new message been produced or the
-   *                 recently produced message been retrieved
-   * @io_buf:        message buffer
-   * @lock:          lock used to protect the object,also used to make a
-   *                 sync between UI and Executor
+   * @cmd_ring:      command lines from UI to Executor,UI can queue the
+   *                 pasted commands while Executor works
+   * @output_ring:   output of each command from Executor to UI,ends with
+   *                 an EXE_NOMSG or EXE_STOPPED message
    */
   struct uiexemsgexchg {
-    UIEXE_STATUS status;
-    std::string io_buf;
-    struct conditionv condv_sync;
+    spsc_ring<uiexemsg, UIEXE_RING_SIZE> cmd_ring;
+    spsc_ring<uiexemsg, UIEXE_RING_SIZE> output_ring;
   };
 
   /**
-   * mod_files_list - structure used to store mod file info
+   * mod_files_list - structure used to store mod file info,the paths
+   *                  are kept in arenas which are reused by each command
    * @regular_file_list:    regular file list
    * @directory_list:       directory list
    * @mod_name_list:        mod name list from DB
+   * @conflict_list:        files of @regular_file_list which been
+   *                        installed by the other mods
+   * @content_hash_list:    content hashes of @regular_file_list in the
+   *                        same order if the mod is deployed from content
+   *                        store,or the hashes referenced by database
+   * @removed_list:         paths to be removed from the records of the
+   *                        mod by UPDATE,@regular_file_list and
+   *                        @directory_list are the paths to be added
+   * @file_meta_list:       metadata of @regular_file_list in the same
+   *                        order,after deployed or as recorded
+   * @deployed_hash_list:   content hashes of the deployed files of
+   *                        @regular_file_list in the same order,empty if
+   *                        @content_hash_list has them already
+   * @source_list:          sources of the mods of @regular_file_list as
+   *                        recorded
+   * @mod_source:           absolute path of the mod directory or archive
+   *                        to be recorded
    * @lock:                 concurrent access protection
    */
   struct mod_files_list {
-    std::list<std::string> regular_file_list;
-    std::list<std::string> directory_list;
-    std::list<std::string> &mod_name_list = directory_list;
+    mhwimm_path_list_ns::path_list regular_file_list;
+    mhwimm_path_list_ns::path_list directory_list;
+    mhwimm_path_list_ns::path_list &mod_name_list = directory_list;
+    std::list<mhwimm_db_ns::db_conflict> conflict_list;
+    mhwimm_path_list_ns::path_list content_hash_list;
+    mhwimm_path_list_ns::path_list removed_list;
+    std::vector<mhwimm_db_ns::db_file_meta> file_meta_list;
+    mhwimm_path_list_ns::path_list deployed_hash_list;
+    mhwimm_path_list_ns::path_list source_list;
+    std::string mod_source;
     std::mutex lock;
   };
 
@@ -147,35 +186,109 @@ namespace mhwimm_sync_mechanism_ns {
    * @INTEREST_NAME:  want mod_name field
    * @INTEREST_PATH:  want file_path field
    * @INTEREST_DATE:  want install_date field
+   * @INTEREST_CONFLICT:  want the owners of regular files
+   * @INTEREST_HASH:  want the content hashes referenced by database
+   * @INTEREST_META:  want the regular files with their metadata
    */
   enum INTEREST_FIELD : uint8_t {
     NO_INTEREST = 0,
     INTEREST_NAME = 1,
     INTEREST_PATH,
-    INTEREST_DATE
+    INTEREST_DATE,
+    INTEREST_CONFLICT,
+    INTEREST_HASH,
+    INTEREST_META
   };
   using interest_db_field_t = uint8_t;
+
+  /* PATH_CHUNK_SIZE - number of records in one chunk of a path stream */
+  constexpr std::size_t PATH_CHUNK_SIZE(1024);
+
+  /**
+   * path_chunk - records of a mod streamed by DB thread
+   * @paths:      the paths tagged with their types
+   * @last:       no more chunk follows,@paths might be empty
+   */
+  struct path_chunk {
+    mhwimm_path_list_ns::path_list paths;
+    bool last;
+  };
+
+  /**
+   * path_stream - chunks from DB thread to Executor while the cursor
+   *               is stepping
+   * # the consumer must pop until the last chunk,and then wait for
+   *   the request,DB thread touches the stream until the request
+   *   accomplished.
+   */
+  using path_stream = spsc_ring<path_chunk, 8>;
+
+  /**
+   * db_request - a request to DB thread
+   * @op:        database operation,SQL_NOP stops DB thread
+   * @interest:  the field wanted by SQL_ASK
+   * @mod_name:  the mod to be operated on,if the operation needs
+   * @mfl:       where the inputs are read from and the result is stored
+   * @stream:    for SQL_ASK with INTEREST_PATH,the rows are pushed to it
+   *             instead of @mfl,which is neither used nor locked
+   * @gate:      for SQL_ADD,the records are committed only if it becomes
+   *             true,and @mfl is not locked because its owner holds the
+   *             lock until the gate opened
+   * @result:    whether the request succeed
+   */
+  struct db_request {
+    mhwimm_db_ns::SQL_OP op;
+    interest_db_field_t interest;
+    std::string mod_name;
+    mod_files_list *mfl;
+    path_stream *stream;
+    std::shared_future<bool> gate;
+    std::promise<bool> result;
+  };
+
+  /* DB_QUEUE_SIZE - number of requests can be queued to DB thread */
+  constexpr std::size_t DB_QUEUE_SIZE(16);
+
+  /* db_request_queue - requests from Executor to DB thread in order */
+  using db_request_queue = spsc_ring<db_request, DB_QUEUE_SIZE>;
 }
 
 /* program_exit - value used to indicates whether the program should stop */
 extern atomic_t program_exit;
 
-/* exedb_sync - synchronization between Executor and DB */
-extern mhwimm_sync_mechanism_ns::conditionv exedb_condv_sync;
-
-/* is_db_op_succeed - indicate whether the last db operation is succeed */
-extern bool is_db_op_succeed;
+/* exedb_queue - DB requests from Executor */
+extern mhwimm_sync_mechanism_ns::db_request_queue exedb_queue;
 
-/* Database Register Helpers related */
-extern mhwimm_sync_mechanism_ns::interest_db_field_t interest_field;
-extern mhwimm_sync_mechanism_ns::mod_files_list *mfl_for_db;
-
-extern void regDBop_getAllInstalled_Modsname(typename mhwimm_sync_mechanism_ns::mod_files_list *mfl);
-extern void regDBop_getInstalled_Modinfo(const std::string &modname,
-                                         typename mhwimm_sync_mechanism_ns::mod_files_list *mfl);
-extern void regDBop_add_mod_info(const std::string &modname,
-                                 typename mhwimm_sync_mechanism_ns::mod_files_list *mfl);
-extern void regDBop_remove_mod_info(const std::string &modname);
-extern void init_regDB_routines(typename mhwimm_db_ns::mhwimm_db *db_impl);
+/**
+ * Database Register Helpers
+ * each one queues a request to @exedb_queue,the future becomes ready
+ * after DB processed it.
+ */
+extern std::future<bool>
+regDBop_getAllInstalled_Modsname(typename mhwimm_sync_mechanism_ns::mod_files_list *mfl);
+extern std::future<bool>
+regDBop_getInstalled_Modinfo(std::string_view modname,
+                             typename mhwimm_sync_mechanism_ns::mod_files_list *mfl);
+extern std::future<bool>
+regDBop_streamInstalled_Modinfo(std::string_view modname,
+                                typename mhwimm_sync_mechanism_ns::path_stream *stream);
+extern std::future<bool>
+regDBop_add_mod_info(std::string_view modname,
+                     typename mhwimm_sync_mechanism_ns::mod_files_list *mfl,
+                     std::shared_future<bool> gate = {});
+extern std::future<bool> regDBop_remove_mod_info(std::string_view modname);
+extern std::future<bool>
+regDBop_update_mod_info(std::string_view modname,
+                        typename mhwimm_sync_mechanism_ns::mod_files_list *mfl);
+extern std::future<bool>
+regDBop_set_deployed_hashes(std::string_view modname,
+                            typename mhwimm_sync_mechanism_ns::mod_files_list *mfl);
+extern std::future<bool> regDBop_find_conflicts(typename mhwimm_sync_mechanism_ns::mod_files_list *mfl);
+extern std::future<bool> regDBop_get_content_hashes(typename mhwimm_sync_mechanism_ns::mod_files_list *mfl);
+extern std::future<bool>
+regDBop_get_file_meta(std::string_view modname,
+                      typename mhwimm_sync_mechanism_ns::mod_files_list *mfl);
+extern void regDBop_stop(void);
 
 #endif
+
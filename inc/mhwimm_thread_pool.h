@@ -0,0 +1,102 @@
+/**
+ * Monster Hunter World Iceborne Mod Manager Thread Pool
+ * This file contains the definition of a work-stealing
+ * thread pool,it is used by the Executor to process
+ * filesystem works in parallel.
+ */
+#ifndef _MHWIMM_THREAD_POOL_H_
+#define _MHWIMM_THREAD_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mhwimm_thread_pool_ns {
+
+  /**
+   * work_stealing_pool - thread pool which each worker owns a task queue,
+   *                      worker pops task from the back of its own queue,
+   *                      and steals task from the front of the others'
+   *                      queue when its own queue is empty
+   * # task submitted by a worker is pushed into the queue of the worker,
+   *   thus recursive works(e.g. traverse directory) stay local as much as
+   *   possible.
+   * # task submitted by a non-worker thread is distributed to the queues
+   *   in round-robin.
+   */
+  class work_stealing_pool final {
+  public:
+    using task_t = std::function<void(void)>;
+
+    /**
+     * constructor
+     * @nworkers:  number of worker threads,_zero_ means number of
+     *             hardware threads
+     */
+    explicit work_stealing_pool(unsigned int nworkers);
+    ~work_stealing_pool();
+
+    // disabled copying,moving
+    work_stealing_pool(const work_stealing_pool &) =delete;
+    work_stealing_pool &operator=(const work_stealing_pool &) =delete;
+    work_stealing_pool(work_stealing_pool &&) =delete;
+    work_stealing_pool &operator=(work_stealing_pool &&) =delete;
+
+    /* submit - submit a task to pool */
+    void submit(task_t task);
+
+    /**
+     * wait - wait until all submitted tasks completed
+     * # must not be called by worker thread of this pool
+     */
+    void wait(void);
+
+    std::size_t size(void) const noexcept { return workers_.size(); }
+
+    /* requested_size - the value passed to constructor */
+    unsigned int requested_size(void) const noexcept { return requested_size_; }
+
+  private:
+    /**
+     * worker_queue - task queue of a worker
+     * @lock:         protect @tasks
+     * @tasks:        tasks
+     */
+    struct worker_queue {
+      std::mutex lock;
+      std::deque<task_t> tasks;
+    };
+
+    void workerLoop(std::size_t idx);
+    bool popTask(std::size_t idx, task_t &task);
+
+    unsigned int requested_size_;
+    std::vector<std::thread> workers_;
+    std::vector<std::unique_ptr<worker_queue>> queues_;
+
+    /* sleep_lock_ - protect @stop_,and used to sleep/wakeup workers */
+    std::mutex sleep_lock_;
+    std::condition_variable sleep_condv_;
+    /* idle_condv_ - notified when @pending_ drops to _zero_ */
+    std::condition_variable idle_condv_;
+
+    /* queued_ - number of tasks in all queues */
+    std::atomic<std::size_t> queued_;
+    /* pending_ - number of tasks submitted but not completed */
+    std::atomic<std::size_t> pending_;
+    /* next_queue_ - round-robin index for non-worker submitting */
+    std::atomic<std::size_t> next_queue_;
+    bool stop_;
+  };
+
+}
+
+#endif
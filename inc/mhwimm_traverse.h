@@ -0,0 +1,37 @@
+/**
+ * Monster Hunter World Iceborne Mod Manager Directory Traversal
+ * This file contains the definition of the parallel directory
+ * traversal engine used by Executor to makeup mod file list.
+ */
+#ifndef _MHWIMM_TRAVERSE_H_
+#define _MHWIMM_TRAVERSE_H_
+
+#include "mhwimm_thread_pool.h"
+
+#include <string>
+
+#include "mhwimm_path_list.h"
+
+namespace mhwimm_traverse_ns {
+
+  /**
+   * parallel_traverse - traverse directory @root via the workers of @pool
+   * @root:              directory to traverse
+   * @pool:              thread pool,each directory is scanned by one task
+   * @directory_list:    where to append the directories under @root
+   * @regular_file_list: where to append the regular files under @root
+   * return:             0 OR -1
+   * # paths are relative to @root and start with "/",e.g. "/nativePC/a.tex"
+   * # the order of output is the same as a recursive depth-first traversal,
+   *   that is,a directory always comes before its children,no matter how
+   *   the tasks been scheduled.
+   * # symbolic links are skipped.
+   */
+  int parallel_traverse(const std::string &root,
+                        mhwimm_thread_pool_ns::work_stealing_pool &pool,
+                        mhwimm_path_list_ns::path_list &directory_list,
+                        mhwimm_path_list_ns::path_list &regular_file_list);
+
+}
+
+#endif
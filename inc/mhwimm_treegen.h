@@ -0,0 +1,75 @@
+/**
+ * Monster Hunter World Iceborne Mod Manager Tree Generator
+ * This file contains the definition of synthetic mod tree generator,
+ * which makes up mod directories of any shape for benchmark.
+ */
+#ifndef _MHWIMM_TREEGEN_H_
+#define _MHWIMM_TREEGEN_H_
+
+#include "mhwimm_thread_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <string>
+
+namespace mhwimm_treegen_ns {
+
+  /**
+   * tree_spec - shape of a synthetic mod tree
+   * @depth:     levels of directories under "nativePC",_zero_ means
+   *             the files are placed in "nativePC" directly
+   * @fanout:    subdirectories of each directory
+   * @nfiles:    number of regular files,they are spread over the
+   *             directories of the deepest level round-robin
+   * @file_size: bytes of each file
+   * @first_index: index of the first file,the trees share no path if
+   *             their ranges of index do not overlap
+   * @seed:      seed of the content,the content of a file is derived
+   *             from @seed and its index,thus the content store hardly
+   *             shares their blobs
+   */
+  struct tree_spec {
+    unsigned int depth;
+    unsigned int fanout;
+    std::size_t nfiles;
+    std::size_t file_size;
+    std::size_t first_index;
+    uint64_t seed;
+  };
+
+  /**
+   * tree_stats - what been generated
+   * @ndirs:     directories,"nativePC" is included
+   * @nfiles:    regular files
+   * @nbytes:    bytes written
+   */
+  struct tree_stats {
+    std::size_t ndirs;
+    std::size_t nfiles;
+    uint64_t nbytes;
+  };
+
+  /**
+   * generate_tree - makeup the mod tree described by @spec under @root
+   * @root:          directory to be created,must not exist
+   * @spec:          shape of the tree
+   * @stats:         where to store the statistics
+   * @pool:          the files are written by the workers in parallel
+   * return:         0 OR -1,errno is set
+   * # the paths are "/nativePC/d<i>/.../f<index>.bin",the same @spec
+   *   always makes up the same tree.
+   */
+  int generate_tree(const std::string &root, const tree_spec &spec, tree_stats &stats,
+                    mhwimm_thread_pool_ns::work_stealing_pool &pool);
+
+  /**
+   * remove_tree - remove the tree under @root and @root itself
+   * return:       0 OR -1,errno is set
+   * # symbolic links are removed,never followed.
+   */
+  int remove_tree(const std::string &root);
+
+}
+
+#endif
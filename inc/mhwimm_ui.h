@@ -19,7 +19,7 @@ namespace mhwimm_ui_ns {
   class mhwimm_ui final {
   public:
     mhwimm_ui()
-      : local_msg_buffer_("nil"),
+      : local_msg_buffer_(),
         prompt_msg_("mhwimm: "),
         startup_msg_("Monster Hunter World:Iceborne Mod Manager cmd tool"),
         space_indent_(8)
@@ -61,18 +61,50 @@ namespace mhwimm_ui_ns {
     }
 
     /**
-     * readFromUser - read user input from standard input stream
+     * printMessageLines - print the lines in @chunk,each one begins at
+     *                     a new line with indent
+     * @chunk:             lines separated by '\n' from Command Module
+     * # all lines are written at once.
+     */
+    void printMessageLines(const std::string &chunk);
+
+    /**
+     * readFromUser - read user input from standard input stream,the
+     *                line has no length limit
      * return:        size of characters this routine have been readed
      */
     ssize_t readFromUser(void);
 
+    /**
+     * hasPendingInput - whether user input been read into stream buffer
+     *                   or kernel,e.g. pasted lines
+     * # needs std::ios::sync_with_stdio(false),otherwise std::cin has no
+     *   buffer.
+     */
+    bool hasPendingInput(void)
+    {
+      return std::cin.rdbuf()->in_avail() > 0;
+    }
+
     /**
      * sendCMDTo - send command input from user to the destination
      * @des:       where to place
+     * # the buffer is moved to @des,no copy.
      */
     void sendCMDTo(std::string &des)
     {
-      des = local_msg_buffer_;
+      des = std::move(local_msg_buffer_);
+      local_msg_buffer_.clear();
+    }
+
+    /**
+     * recycleBuffer - take back a buffer been sent,and reuse it for the
+     *                 next input line
+     */
+    void recycleBuffer(std::string &&buf)
+    {
+      if (buf.capacity() > local_msg_buffer_.capacity())
+        local_msg_buffer_ = std::move(buf);
     }
 
     /* printIndentSpaces - print indent */
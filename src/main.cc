@@ -13,7 +13,7 @@
  *   4> Setup signal blocking.
  *   5> intialize global variable @pmhwiroot
  *      which will be used by Database
- *   6> initialize Database Register Helpers
+ *   6> create Executor,DB request queue
  *   7> start thread works
  *   8> sigwait() async signals come
  *   9> send signal to threads for interrupt
@@ -21,6 +21,16 @@
  *      join to main thread
  *  10> write config options to config file
  *      and exit
+ * Batch mode :
+ *   mhwimm -c "cmd; cmd"  executes the commands split by ';'
+ *   mhwimm -f script      executes the commands in @script line by line,
+ *                         "-" is stdin,empty line and line begin with '#'
+ *                         are skipped
+ *   mhwimm cmd args...    executes one command
+ *   -k                    keep going after a command failed
+ *   UI,Executor,Database threads are not started,the commands are executed
+ *   back to back in main thread with one Executor and one database session,
+ *   exit status is 0 if all commands succeed,1 if any command failed.
  */
 #include "mhwimm_ui.h"
 #include "mhwimm_executor.h"
@@ -44,9 +54,11 @@
 #include <mutex>
 #include <thread>
 #include <string>
+#include <vector>
 #include <memory>
 #include <functional>
 #include <iostream>
+#include <fstream>
 
 constexpr const char *mhwimm_config_filename("mhwimm_config");
 constexpr const char *mhwimmroot_name("mhwimm");
@@ -54,10 +66,8 @@ constexpr const char *mhwimm_db_name("mhwimm_db");
 
 atomic_t program_exit = 0;
 
-mhwimm_sync_mechanism_ns::conditionv exedb_condv_sync;
-mhwimm_sync_mechanism_ns::uiexemsgexchg uiexe_ctrl_msg = {
-  .status = mhwimm_sync_mechanism_ns::UIEXE_STATUS::EXE_NOMSG,
-};
+mhwimm_sync_mechanism_ns::db_request_queue exedb_queue;
+mhwimm_sync_mechanism_ns::uiexemsgexchg uiexe_ctrl_msg;
 mhwimm_sync_mechanism_ns::mod_files_list mfl;
 
 const typename mhwimm_config_ns::get_config_traits<mhwimm_config_ns::config_t>::skey_t *
@@ -69,14 +79,29 @@ static bool mhwimm_need_initialization(const std::string &config_path);
 
 static bool ask_user_to_setup_mhwimmroot(mhwimm_config_ns::config_t &conf);
 
-int main(void)
+static int parse_batch_args(int argc, char *argv[], std::vector<std::string> &cmd_lines,
+                            bool &keep_going);
+
+int main(int argc, char *argv[])
 {
-  std::cout << "Initializing..." << std::endl;
+  // std::cin has its own buffer,UI checks it for pasted commands.
+  std::ios::sync_with_stdio(false);
+
+  std::vector<std::string> cmd_lines;
+  bool keep_going(false);
+  int batch(parse_batch_args(argc, argv, cmd_lines, keep_going));
+  if (batch < 0)
+    return -1;
+
+  if (!batch)
+    std::cout << "Initializing..." << std::endl;
 
   mhwimm_config_ns::config_t conf = {
     .userhome = "nil",
     .mhwiroot = "nil",
     .mhwimmroot = "nil",
+    .nworkers = 0,
+    .deploy = "link",
   };
 
   char *penv_buf(nullptr);
@@ -102,6 +127,12 @@ int main(void)
   std::string config_file_path(conf.mhwimmroot + "/" + mhwimm_config_filename);
 
   if (mhwimm_need_initialization(config_file_path)) {
+    if (batch) {
+      // stdin might be the script.
+      std::cerr << "main(): error: mhwimm is not initialized,"
+                << "run it interactively once at first." << std::endl;
+      return -1;
+    }
     if (!ask_user_to_setup_mhwimmroot(conf)) {
       std::cerr << "main(): error: Failed to setup mhwimm." << std::endl;
       std::cerr << "config path: " << config_file_path << std::endl
@@ -139,6 +170,24 @@ int main(void)
     return -1;
   }
 
+  std::string db_path = conf.mhwimmroot;
+  pmhwiroot_path = &conf.mhwiroot;
+
+  if (batch) {
+    // signals are not blocked,the intent journal recovers an interrupted
+    // command in next run.
+    mhwimm_executor_ns::mhwimm_executor exe(&conf);
+    mhwimm_db_ns::mhwimm_db db(mhwimm_db_name, db_path.c_str());
+    if (mhwimm_db_prepare(db) < 0)
+      return -1;
+
+    int nfailed(mhwimm_executor_batch_worker(exe, mfl, db, cmd_lines, keep_going));
+    db.closeDB();
+
+    mhwimm_config_ns::makeup_config_file<mhwimm_config_ns::config_t>(&conf, config_file_path.c_str());
+    return nfailed ? 1 : 0;
+  }
+
   // setup signal mask
   sigset_t new_mask;
   sigemptyset(&new_mask);
@@ -149,19 +198,18 @@ int main(void)
     return -1;
   }
 
-  std::string db_path = conf.mhwimmroot;
-  pmhwiroot_path = &conf.mhwiroot;
   // print the paths
   std::cout << "userhome: " << conf.userhome
             << "\nmhwiroot: " << conf.mhwiroot
             << "\nmhwimmroot: " << conf.mhwimmroot
+            << "\nnworkers: " << conf.nworkers
+            << "\ndeploy: " << conf.deploy
             << std::endl;
 
   /* prepare threads */
   mhwimm_ui_ns::mhwimm_ui ui;
   mhwimm_executor_ns::mhwimm_executor exe(&conf);
   mhwimm_db_ns::mhwimm_db db(mhwimm_db_name, db_path.c_str());
-  init_regDB_routines(&db);
 
   std::thread ui_thread(mhwimm_ui_thread_worker, std::ref(ui), std::ref(uiexe_ctrl_msg));
   std::thread exe_thread(mhwimm_executor_thread_worker, std::ref(exe), std::ref(uiexe_ctrl_msg),
@@ -237,3 +285,84 @@ static bool ask_user_to_setup_mhwimmroot(mhwimm_config_ns::config_t &conf)
   conf.mhwiroot = buf.get();
   return true;
 }
+
+/**
+ * parse_batch_args - parse command line arguments for batch mode
+ * @argc:             argument count
+ * @argv:             argument vector
+ * @cmd_lines:        where to save the command lines
+ * @keep_going:       set if -k is specified
+ * return:            1 => batch mode,0 => interactive mode,-1 => bad usage
+ */
+static int parse_batch_args(int argc, char *argv[], std::vector<std::string> &cmd_lines,
+                            bool &keep_going)
+{
+  const char *cmds(nullptr), *script(nullptr);
+  int opt(0);
+
+  auto add_cmd_line = [&cmd_lines](const std::string &line) {
+    std::size_t b(line.find_first_not_of(" \t\r"));
+    if (b == std::string::npos || line[b] == '#')
+      return;
+    std::size_t e(line.find_last_not_of(" \t\r"));
+    cmd_lines.push_back(line.substr(b, e - b + 1));
+  };
+
+  // stop at the first non-option,it is the one-shot command.
+  while ((opt = getopt(argc, argv, "+kc:f:h")) != -1) {
+    switch (opt) {
+    case 'k':
+      keep_going = true;
+      break;
+    case 'c':
+      cmds = optarg;
+      break;
+    case 'f':
+      script = optarg;
+      break;
+    default:
+      goto usage;
+    }
+  }
+
+  if ((cmds != nullptr) + (script != nullptr) + (optind < argc) > 1)
+    goto usage;
+
+  if (cmds) {
+    std::string s(cmds);
+    for (std::size_t b(0), e(0); b <= s.length(); b = e + 1) {
+      e = s.find(';', b);
+      if (e == std::string::npos)
+        e = s.length();
+      add_cmd_line(s.substr(b, e - b));
+    }
+  } else if (script) {
+    std::ifstream ifs;
+    bool is_stdin(strcmp(script, "-") == 0);
+    if (!is_stdin) {
+      ifs.open(script);
+      if (!ifs.is_open()) {
+        std::cerr << "main(): error: Failed to open script " << script << std::endl;
+        return -1;
+      }
+    }
+    std::istream &is(is_stdin ? std::cin : ifs);
+    for (std::string line; std::getline(is, line); )
+      add_cmd_line(line);
+  } else if (optind < argc) {
+    std::string line(argv[optind]);
+    for (int i(optind + 1); i < argc; ++i)
+      line += std::string{" "} + argv[i];
+    add_cmd_line(line);
+  } else if (keep_going)
+    goto usage;
+  else
+    return 0;
+
+  return 1;
+
+ usage:
+  std::cerr << "usage: " << argv[0] << " [-k] [-c \"cmd; cmd...\" | -f script | cmd args...]"
+            << std::endl;
+  return -1;
+}
@@ -0,0 +1,1063 @@
+/**
+ * Mod Archive Reader
+ * Zip archive is mapped into memory,the central directory gives
+ * every entry and its offset,thus the entries are inflated by
+ * the workers in parallel.tar archive is decoded as a stream,
+ * gzip by zlib,zstd by zstd(1) through a pipe,each file is
+ * written to its destination while the stream goes.
+ */
+#include "mhwimm_archive.h"
+
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <zlib.h>
+
+extern char **environ;
+
+namespace mhwimm_archive_ns {
+
+  /* io_buf_size - size of the buffer of decoding and writing */
+  static constexpr std::size_t io_buf_size = 256 * 1024;
+
+  static constexpr std::size_t tar_block_size = 512;
+
+  /* zip signatures */
+  static constexpr uint32_t zip_eocd_sig = 0x06054b50;
+  static constexpr uint32_t zip64_eocd_locator_sig = 0x07064b50;
+  static constexpr uint32_t zip64_eocd_sig = 0x06064b50;
+  static constexpr uint32_t zip_cdir_sig = 0x02014b50;
+  static constexpr uint32_t zip_local_sig = 0x04034b50;
+
+  static constexpr uint16_t zip_method_stored = 0;
+  static constexpr uint16_t zip_method_deflated = 8;
+
+  archive_format archive_format_of(const std::string &path)
+  {
+    if (path.ends_with(".zip"))
+      return archive_format::ARCHIVE_ZIP;
+    else if (path.ends_with(".tar"))
+      return archive_format::ARCHIVE_TAR;
+    else if (path.ends_with(".tar.gz") || path.ends_with(".tgz"))
+      return archive_format::ARCHIVE_TAR_GZ;
+    else if (path.ends_with(".tar.zst") || path.ends_with(".tzst"))
+      return archive_format::ARCHIVE_TAR_ZST;
+    return archive_format::ARCHIVE_NONE;
+  }
+
+  /**
+   * normalize_path - normalize entry path @raw to "a/b/c"
+   * return:          0 OR -1 if @raw is absolute or contains ".."
+   * # "\" written by some Windows archivers is treated as "/",
+   *   empty and "." components are dropped.
+   */
+  static int normalize_path(std::string_view raw, std::string &path)
+  {
+    path.clear();
+    if (!raw.empty() && (raw[0] == '/' || raw[0] == '\\'))
+      return -1;
+
+    std::size_t begin(0);
+    while (begin <= raw.length()) {
+      std::size_t end(raw.find_first_of("/\\", begin));
+      if (end == std::string_view::npos)
+        end = raw.length();
+      std::string_view component(raw.substr(begin, end - begin));
+      begin = end + 1;
+
+      if (component.empty() || component == ".")
+        continue;
+      if (component == "..")
+        return -1;
+      if (!path.empty())
+        path.push_back('/');
+      path.append(component);
+    }
+    return 0;
+  }
+
+  /**
+   * list_builder - makeup file list as parallel_traverse() does
+   * # parents are added before children,even if they have no entry.
+   */
+  struct list_builder {
+    mhwimm_path_list_ns::path_list &directory_list;
+    mhwimm_path_list_ns::path_list &regular_file_list;
+    std::unordered_set<std::string> dirs;
+    std::unordered_set<std::string> files;
+
+    /* addParents - return -1 if a parent is a regular file */
+    int addParents(const std::string &path)
+    {
+      for (std::size_t pos(path.find('/')); pos != std::string::npos;
+           pos = path.find('/', pos + 1))
+        if (addDir(path.substr(0, pos)) < 0)
+          return -1;
+      return 0;
+    }
+
+    int addDir(const std::string &path)
+    {
+      if (path.empty() || dirs.count(path))
+        return 0;
+      if (files.count(path) || addParents(path) < 0)
+        return -1;
+      dirs.insert(path);
+      directory_list.push_back("/" + path, mhwimm_path_list_ns::path_type::PATH_DIRECTORY);
+      return 0;
+    }
+
+    int addFile(const std::string &path)
+    {
+      if (files.count(path))
+        return 0;
+      if (path.empty() || dirs.count(path) || addParents(path) < 0)
+        return -1;
+      files.insert(path);
+      regular_file_list.push_back("/" + path, mhwimm_path_list_ns::path_type::PATH_REGULAR);
+      return 0;
+    }
+  };
+
+  /* write_all - return 0 OR -errno */
+  static int write_all(int fd, const char *buf, std::size_t len)
+  {
+    while (len) {
+      ssize_t nwritten(write(fd, buf, len));
+      if (nwritten < 0) {
+        if (errno == EINTR)
+          continue;
+        return -errno;
+      }
+      buf += nwritten;
+      len -= nwritten;
+    }
+    return 0;
+  }
+
+  /**
+   * create_file - create destination exclusively
+   * return:       fd OR -errno
+   */
+  static int create_file(int dirfd, const char *path, mode_t mode)
+  {
+    mode &= 0777;
+    if (!mode)
+      mode = 0644;
+    int fd(openat(dirfd, path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, mode));
+    if (fd < 0)
+      return -errno;
+    (void)fchmod(fd, mode);
+    return fd;
+  }
+
+  /**
+   * io_buffer - buffer of decoding and writing,one for each thread
+   */
+  static char *io_buffer(void)
+  {
+    static thread_local std::unique_ptr<char[]> buf;
+    if (!buf)
+      buf.reset(new char[io_buf_size]);
+    return buf.get();
+  }
+
+  void archive_reader::close(void)
+  {
+    if (map_)
+      (void)munmap(const_cast<unsigned char *>(map_), map_size_);
+    if (fd_ >= 0)
+      (void)::close(fd_);
+    map_ = nullptr;
+    map_size_ = 0;
+    fd_ = -1;
+    format_ = archive_format::ARCHIVE_NONE;
+  }
+
+  int archive_reader::open(const std::string &path)
+  {
+    close();
+    format_ = archive_format_of(path);
+    if (format_ == archive_format::ARCHIVE_NONE)
+      return -1;
+    path_ = path;
+
+    fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0)
+      goto err_exit;
+
+    if (format_ == archive_format::ARCHIVE_ZIP) {
+      struct stat zip_stat = {0};
+      if (fstat(fd_, &zip_stat) < 0 || !zip_stat.st_size)
+        goto err_exit;
+      void *map(mmap(nullptr, zip_stat.st_size, PROT_READ, MAP_PRIVATE, fd_, 0));
+      if (map == MAP_FAILED)
+        goto err_exit;
+      map_ = static_cast<const unsigned char *>(map);
+      map_size_ = zip_stat.st_size;
+    }
+    return 0;
+
+  err_exit:
+    close();
+    return -1;
+  }
+
+  int archive_reader::list(mhwimm_path_list_ns::path_list &directory_list,
+                           mhwimm_path_list_ns::path_list &regular_file_list)
+  {
+    switch (format_) {
+    case archive_format::ARCHIVE_NONE:
+      return -1;
+    case archive_format::ARCHIVE_ZIP:
+      return listZip(directory_list, regular_file_list);
+    default:
+      return listTar(directory_list, regular_file_list);
+    }
+  }
+
+  std::size_t archive_reader::extract(int dirfd, mhwimm_fsbatch_ns::fs_op *ops, std::size_t nops,
+                                      mhwimm_thread_pool_ns::work_stealing_pool &pool)
+  {
+    std::size_t nfailed(0);
+
+    for (std::size_t i(0); i < nops; ++i)
+      ops[i].result = mhwimm_fsbatch_ns::fs_op_pending;
+    if (format_ == archive_format::ARCHIVE_ZIP)
+      nfailed = extractZip(dirfd, ops, nops, pool);
+    else if (format_ != archive_format::ARCHIVE_NONE)
+      nfailed = extractTar(dirfd, ops, nops);
+    else
+      for (std::size_t i(0); i < nops; ++i, ++nfailed)
+        ops[i].result = -EINVAL;
+    return nfailed;
+  }
+
+  /* zip */
+
+  /* little-endian readers,@p must be bounds checked by caller */
+  static uint16_t get_le16(const unsigned char *p)
+  {
+    return p[0] | p[1] << 8;
+  }
+
+  static uint32_t get_le32(const unsigned char *p)
+  {
+    return get_le16(p) | static_cast<uint32_t>(get_le16(p + 2)) << 16;
+  }
+
+  static uint64_t get_le64(const unsigned char *p)
+  {
+    return get_le32(p) | static_cast<uint64_t>(get_le32(p + 4)) << 32;
+  }
+
+  /**
+   * zip_entry - an entry in central directory
+   * @local_offset:  offset of the local header
+   */
+  struct zip_entry {
+    std::string path;
+    bool is_dir;
+    uint16_t method;
+    uint32_t crc;
+    uint64_t compressed_size;
+    uint64_t size;
+    uint64_t local_offset;
+    mode_t mode;
+  };
+
+  int archive_reader::zipEntries(std::list<zip_entry> &entries) const
+  {
+    constexpr std::size_t eocd_size = 22;
+    constexpr std::size_t max_comment = 0xffff;
+
+    if (map_size_ < eocd_size)
+      return -1;
+
+    // end of central directory is followed by a comment up to 64KiB
+    const unsigned char *eocd(nullptr);
+    std::size_t lowest(map_size_ - eocd_size > max_comment ?
+                       map_size_ - eocd_size - max_comment : 0);
+    for (std::size_t pos(map_size_ - eocd_size); ; --pos) {
+      if (get_le32(map_ + pos) == zip_eocd_sig) {
+        eocd = map_ + pos;
+        break;
+      }
+      if (pos == lowest)
+        return -1;
+    }
+
+    uint64_t nentries(get_le16(eocd + 10));
+    uint64_t cdir_size(get_le32(eocd + 12));
+    uint64_t cdir_offset(get_le32(eocd + 16));
+
+    // zip64,the real values are in zip64 end of central directory
+    if (nentries == 0xffff || cdir_size == 0xffffffff || cdir_offset == 0xffffffff) {
+      constexpr std::size_t locator_size = 20;
+      constexpr std::size_t eocd64_size = 56;
+      if (static_cast<std::size_t>(eocd - map_) < locator_size ||
+          get_le32(eocd - locator_size) != zip64_eocd_locator_sig)
+        return -1;
+      uint64_t eocd64_offset(get_le64(eocd - locator_size + 8));
+      if (map_size_ < eocd64_size || eocd64_offset > map_size_ - eocd64_size ||
+          get_le32(map_ + eocd64_offset) != zip64_eocd_sig)
+        return -1;
+      nentries = get_le64(map_ + eocd64_offset + 32);
+      cdir_size = get_le64(map_ + eocd64_offset + 40);
+      cdir_offset = get_le64(map_ + eocd64_offset + 48);
+    }
+    if (cdir_offset > map_size_ || cdir_size > map_size_ - cdir_offset)
+      return -1;
+
+    constexpr std::size_t cdir_header_size = 46;
+    const unsigned char *pos(map_ + cdir_offset);
+    const unsigned char *end(pos + cdir_size);
+    for (uint64_t i(0); i < nentries; ++i) {
+      if (static_cast<std::size_t>(end - pos) < cdir_header_size ||
+          get_le32(pos) != zip_cdir_sig)
+        return -1;
+
+      uint16_t made_by(get_le16(pos + 4));
+      uint16_t flags(get_le16(pos + 8));
+      std::size_t name_len(get_le16(pos + 28));
+      std::size_t extra_len(get_le16(pos + 30));
+      std::size_t comment_len(get_le16(pos + 32));
+      uint32_t external_attr(get_le32(pos + 38));
+      if (static_cast<std::size_t>(end - pos) < cdir_header_size + name_len + extra_len + comment_len)
+        return -1;
+
+      zip_entry entry;
+      entry.method = get_le16(pos + 10);
+      entry.crc = get_le32(pos + 16);
+      entry.compressed_size = get_le32(pos + 20);
+      entry.size = get_le32(pos + 24);
+      entry.local_offset = get_le32(pos + 42);
+
+      // zip64 extended information,only the saturated fields are present
+      const unsigned char *extra(pos + cdir_header_size + name_len);
+      for (std::size_t off(0); off + 4 <= extra_len; ) {
+        uint16_t id(get_le16(extra + off));
+        std::size_t len(get_le16(extra + off + 2));
+        if (off + 4 + len > extra_len)
+          break;
+        if (id == 0x0001) {
+          const unsigned char *field(extra + off + 4);
+          const unsigned char *field_end(field + len);
+          for (uint64_t *v : { &entry.size, &entry.compressed_size, &entry.local_offset })
+            if (*v == 0xffffffff) {
+              if (field_end - field < 8)
+                return -1;
+              *v = get_le64(field);
+              field += 8;
+            }
+        }
+        off += 4 + len;
+      }
+
+      std::string_view raw(reinterpret_cast<const char *>(pos + cdir_header_size), name_len);
+      pos += cdir_header_size + name_len + extra_len + comment_len;
+
+      // encrypted entry is not supported
+      if (flags & 0x1)
+        return -1;
+
+      mode_t unix_mode((made_by >> 8) == 3 ? external_attr >> 16 : 0);
+      entry.is_dir = raw.ends_with('/') || raw.ends_with('\\') || S_ISDIR(unix_mode);
+      // some archivers leave the file type bits zero for regular file
+      if (!entry.is_dir && (unix_mode & S_IFMT) && !S_ISREG(unix_mode))
+        continue;   // symbolic link,etc.
+      if (!entry.is_dir && entry.method != zip_method_stored &&
+          entry.method != zip_method_deflated)
+        return -1;
+      entry.mode = unix_mode & 0777;
+
+      if (normalize_path(raw, entry.path) < 0)
+        return -1;
+      entries.push_back(std::move(entry));
+    }
+    return 0;
+  }
+
+  int archive_reader::listZip(mhwimm_path_list_ns::path_list &directory_list,
+                              mhwimm_path_list_ns::path_list &regular_file_list)
+  {
+    std::list<zip_entry> entries;
+    if (zipEntries(entries) < 0)
+      return -1;
+
+    list_builder builder = {
+      .directory_list = directory_list,
+      .regular_file_list = regular_file_list,
+    };
+    for (const auto &entry : entries)
+      if ((entry.is_dir ? builder.addDir(entry.path) : builder.addFile(entry.path)) < 0)
+        return -1;
+    return 0;
+  }
+
+  /**
+   * extract_zip_entry - write @entry to @op->path
+   * return:             0 OR -errno
+   */
+  static int extract_zip_entry(int dirfd, const unsigned char *map, std::size_t map_size,
+                               const zip_entry *entry,
+                               mhwimm_fsbatch_ns::fs_op *op);
+
+  std::size_t archive_reader::extractZip(int dirfd, mhwimm_fsbatch_ns::fs_op *ops, std::size_t nops,
+                                         mhwimm_thread_pool_ns::work_stealing_pool &pool)
+  {
+    std::list<zip_entry> entries;
+    if (zipEntries(entries) < 0) {
+      for (std::size_t i(0); i < nops; ++i)
+        ops[i].result = -EIO;
+      return nops;
+    }
+
+    std::unordered_map<std::string_view, const zip_entry *> entry_of;
+    for (const auto &entry : entries)
+      if (!entry.is_dir)
+        (void)entry_of.emplace(entry.path, &entry);
+
+    for (std::size_t i(0); i < nops; ++i) {
+      auto found(entry_of.find(ops[i].path));
+      if (found == entry_of.end()) {
+        ops[i].result = -ENOENT;
+        continue;
+      }
+      const unsigned char *map(map_);
+      std::size_t map_size(map_size_);
+      const zip_entry *entry(found->second);
+      mhwimm_fsbatch_ns::fs_op *op(&ops[i]);
+      pool.submit([dirfd, map, map_size, entry, op](void) -> void {
+                    op->result = extract_zip_entry(dirfd, map, map_size, entry, op);
+                  });
+    }
+    pool.wait();
+
+    std::size_t nfailed(0);
+    for (std::size_t i(0); i < nops; ++i)
+      if (ops[i].result)
+        ++nfailed;
+    return nfailed;
+  }
+
+  static int extract_zip_entry(int dirfd, const unsigned char *map, std::size_t map_size,
+                               const zip_entry *entry,
+                               mhwimm_fsbatch_ns::fs_op *op)
+  {
+    constexpr std::size_t local_header_size = 30;
+
+    // the data follows local header,whose name and extra field
+    // might differ from the ones in central directory
+    if (entry->local_offset > map_size - local_header_size ||
+        get_le32(map + entry->local_offset) != zip_local_sig)
+      return -EIO;
+    uint64_t data_offset(entry->local_offset + local_header_size +
+                         get_le16(map + entry->local_offset + 26) +
+                         get_le16(map + entry->local_offset + 28));
+    if (data_offset > map_size || entry->compressed_size > map_size - data_offset)
+      return -EIO;
+    const unsigned char *data(map + data_offset);
+
+    int fd(create_file(dirfd, op->path, entry->mode));
+    if (fd < 0)
+      return fd;
+
+    int ret(0);
+    uLong crc(crc32(0, Z_NULL, 0));
+    if (entry->method == zip_method_stored) {
+      if (entry->compressed_size != entry->size) {
+        ret = -EIO;
+        goto out;
+      }
+      // zlib takes uInt length
+      for (uint64_t off(0); off < entry->size; off += io_buf_size) {
+        std::size_t len(entry->size - off < io_buf_size ? entry->size - off : io_buf_size);
+        crc = crc32(crc, data + off, len);
+        if ((ret = write_all(fd, reinterpret_cast<const char *>(data + off), len)) < 0)
+          goto out;
+      }
+    } else {
+      z_stream stream;
+      memset(&stream, 0, sizeof(stream));
+      if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+        ret = -ENOMEM;
+        goto out;
+      }
+
+      char *buf(io_buffer());
+      uint64_t consumed(0), produced(0);
+      int zret(Z_OK);
+      while (zret != Z_STREAM_END) {
+        if (!stream.avail_in) {
+          uint64_t left(entry->compressed_size - consumed);
+          stream.next_in = const_cast<Bytef *>(data + consumed);
+          stream.avail_in = left < io_buf_size ? left : io_buf_size;
+          consumed += stream.avail_in;
+        }
+        stream.next_out = reinterpret_cast<Bytef *>(buf);
+        stream.avail_out = io_buf_size;
+        zret = inflate(&stream, Z_NO_FLUSH);
+        if (zret != Z_OK && zret != Z_STREAM_END) {
+          ret = -EIO;
+          break;
+        }
+        // truncated stream makes inflate() return Z_BUF_ERROR
+        std::size_t len(io_buf_size - stream.avail_out);
+        produced += len;
+        crc = crc32(crc, reinterpret_cast<const Bytef *>(buf), len);
+        if ((ret = write_all(fd, buf, len)) < 0)
+          break;
+      }
+      (void)inflateEnd(&stream);
+      if (!ret && produced != entry->size)
+        ret = -EIO;
+    }
+    if (!ret && crc != entry->crc)
+      ret = -EIO;
+
+  out:
+    (void)::close(fd);
+    // the destination is created by us
+    if (ret)
+      (void)unlinkat(dirfd, op->path, 0);
+    return ret;
+  }
+
+  /* tar */
+
+  /**
+   * byte_source - decoded byte stream of tar archive
+   * read:         return number of bytes,_zero_ for the end,-errno
+   *               if failed
+   * skip:         discard @len bytes,return 0 OR -errno
+   * finish:       return 0 if the whole stream is valid
+   */
+  class byte_source {
+  public:
+    virtual ~byte_source() = default;
+    virtual ssize_t read(char *buf, std::size_t len) = 0;
+
+    virtual int skip(uint64_t len)
+    {
+      char *buf(io_buffer());
+      while (len) {
+        ssize_t nread(read(buf, len < io_buf_size ? len : io_buf_size));
+        if (nread <= 0)
+          return nread < 0 ? nread : -EIO;
+        len -= nread;
+      }
+      return 0;
+    }
+
+    virtual int finish(void) { return 0; }
+
+    /* drain - read the padding after the end of archive */
+    int drain(void)
+    {
+      char *buf(io_buffer());
+      ssize_t nread(0);
+      while ((nread = read(buf, io_buf_size)) > 0)
+        ;
+      return nread;
+    }
+
+    /* readFull - read exactly @len bytes,return 0 OR -errno */
+    int readFull(char *buf, std::size_t len)
+    {
+      while (len) {
+        ssize_t nread(read(buf, len));
+        if (nread <= 0)
+          return nread < 0 ? nread : -EIO;
+        buf += nread;
+        len -= nread;
+      }
+      return 0;
+    }
+  };
+
+  /* fd_source - plain tar,or the read end of pipe */
+  class fd_source : public byte_source {
+  public:
+    explicit fd_source(int fd) : fd_(fd) {}
+
+    ssize_t read(char *buf, std::size_t len) override
+    {
+      for (; ;) {
+        ssize_t nread(::read(fd_, buf, len));
+        if (nread < 0 && errno == EINTR)
+          continue;
+        return nread < 0 ? -errno : nread;
+      }
+    }
+
+    int skip(uint64_t len) override
+    {
+      // plain file,the data is never read
+      if (lseek(fd_, len, SEEK_CUR) >= 0)
+        return 0;
+      return byte_source::skip(len);
+    }
+
+  protected:
+    int fd_;
+  };
+
+  /**
+   * gzip_source - .tar.gz,decoded by zlib
+   * # concatenated gzip members are decoded as one stream,the
+   *   trailer of each member is verified by zlib.
+   */
+  class gzip_source final : public byte_source {
+  public:
+    explicit gzip_source(int fd) : fd_(fd), in_(new unsigned char[io_buf_size]),
+                                   ended_(false), failed_(false)
+    {
+      memset(&stream_, 0, sizeof(stream_));
+      // 32 : detect gzip / zlib header automatically
+      failed_ = inflateInit2(&stream_, MAX_WBITS + 32) != Z_OK;
+    }
+
+    ~gzip_source() { (void)inflateEnd(&stream_); }
+
+    ssize_t read(char *buf, std::size_t len) override
+    {
+      if (failed_)
+        return -EIO;
+
+      stream_.next_out = reinterpret_cast<Bytef *>(buf);
+      stream_.avail_out = len;
+      while (stream_.avail_out == len) {
+        if (!stream_.avail_in) {
+          ssize_t nread(::read(fd_, in_.get(), io_buf_size));
+          if (nread < 0 && errno == EINTR)
+            continue;
+          if (nread < 0)
+            return -errno;
+          if (!nread)
+            return ended_ ? 0 : -EIO;   // truncated
+          stream_.next_in = in_.get();
+          stream_.avail_in = nread;
+        }
+        if (ended_) {
+          // next member
+          if (inflateReset(&stream_) != Z_OK)
+            return -EIO;
+          ended_ = false;
+        }
+
+        int zret(inflate(&stream_, Z_NO_FLUSH));
+        if (zret == Z_STREAM_END)
+          ended_ = true;
+        else if (zret != Z_OK && zret != Z_BUF_ERROR) {
+          failed_ = true;
+          return -EIO;
+        }
+      }
+      return len - stream_.avail_out;
+    }
+
+    int finish(void) override
+    {
+      return failed_ || !ended_ ? -1 : 0;
+    }
+
+  private:
+    int fd_;
+    std::unique_ptr<unsigned char[]> in_;
+    z_stream stream_;
+    bool ended_;
+    bool failed_;
+  };
+
+  /**
+   * zstd_source - .tar.zst,decoded by zstd(1)
+   * # the child writes decoded stream into a pipe,its exit status
+   *   tells whether the stream is valid.
+   */
+  class zstd_source final : public fd_source {
+  public:
+    zstd_source() : fd_source(-1), pid_(-1) {}
+
+    ~zstd_source() { (void)finish(); }
+
+    int spawn(const std::string &path)
+    {
+      int pipefd[2] = {-1, -1};
+      if (pipe2(pipefd, O_CLOEXEC) < 0)
+        return -1;
+
+      posix_spawn_file_actions_t actions;
+      (void)posix_spawn_file_actions_init(&actions);
+      (void)posix_spawn_file_actions_adddup2(&actions, pipefd[1], STDOUT_FILENO);
+
+      const char *argv[] = { "zstd", "-dcq", "--", path.c_str(), nullptr };
+      int ret(posix_spawnp(&pid_, "zstd", &actions, nullptr,
+                           const_cast<char *const *>(argv), environ));
+      (void)posix_spawn_file_actions_destroy(&actions);
+      (void)::close(pipefd[1]);
+      if (ret) {
+        pid_ = -1;
+        (void)::close(pipefd[0]);
+        return -1;
+      }
+      fd_ = pipefd[0];
+      return 0;
+    }
+
+    int skip(uint64_t len) override
+    {
+      // pipe can not seek
+      return byte_source::skip(len);
+    }
+
+    int finish(void) override
+    {
+      // the child gets EPIPE if it has not finished
+      if (fd_ >= 0)
+        (void)::close(fd_);
+      fd_ = -1;
+      if (pid_ < 0)
+        return -1;
+
+      int status(0);
+      while (waitpid(pid_, &status, 0) < 0 && errno == EINTR)
+        ;
+      pid_ = -1;
+      return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+    }
+
+  private:
+    pid_t pid_;
+  };
+
+  /**
+   * open_source - open decoded stream of tar archive
+   * return:       nullptr if failed
+   * # @fd is used by the stream,but not owned.
+   */
+  static std::unique_ptr<byte_source> open_source(int fd, const std::string &path,
+                                                  archive_format format)
+  {
+    if (format == archive_format::ARCHIVE_TAR_ZST) {
+      auto source(std::make_unique<zstd_source>());
+      if (source->spawn(path) < 0)
+        return nullptr;
+      return source;
+    }
+
+    // every pass starts from the beginning
+    if (lseek(fd, 0, SEEK_SET) < 0)
+      return nullptr;
+    if (format == archive_format::ARCHIVE_TAR_GZ)
+      return std::make_unique<gzip_source>(fd);
+    return std::make_unique<fd_source>(fd);
+  }
+
+  /**
+   * tar_entry - an entry in tar archive
+   * @type:      typeflag,'0' for regular file,'5' for directory
+   */
+  struct tar_entry {
+    std::string path;
+    char type;
+    uint64_t size;
+    mode_t mode;
+  };
+
+  /* tar_number - octal,or base-256 if the highest bit been set */
+  static uint64_t tar_number(const char *field, std::size_t len)
+  {
+    uint64_t v(0);
+    if (static_cast<unsigned char>(field[0]) & 0x80) {
+      v = static_cast<unsigned char>(field[0]) & 0x7f;
+      for (std::size_t i(1); i < len; ++i)
+        v = v << 8 | static_cast<unsigned char>(field[i]);
+      return v;
+    }
+    for (std::size_t i(0); i < len; ++i) {
+      if (field[i] == ' ' && !v)
+        continue;
+      if (field[i] < '0' || field[i] > '7')
+        break;
+      v = v << 3 | (field[i] - '0');
+    }
+    return v;
+  }
+
+  /* tar_string - NUL terminated field */
+  static std::string_view tar_string(const char *field, std::size_t len)
+  {
+    return std::string_view(field, strnlen(field, len));
+  }
+
+  static uint64_t tar_padding(uint64_t size)
+  {
+    return (tar_block_size - size % tar_block_size) % tar_block_size;
+  }
+
+  /**
+   * read_long_data - read the data of GNU long name / pax header
+   * return:          0 OR -errno
+   */
+  static int read_long_data(byte_source &source, uint64_t size, std::string &data)
+  {
+    // the names are limited by PATH_MAX,a huge one is corrupted
+    if (size > 1 << 20)
+      return -EIO;
+    data.resize(size);
+    int ret(source.readFull(data.data(), size));
+    if (!ret)
+      ret = source.skip(tar_padding(size));
+    return ret;
+  }
+
+  /**
+   * next_tar_entry - read header of the next entry
+   * return:          1 => @entry is filled,its data is the next to read
+   *                  0 => end of archive
+   *                  -1 => corrupted
+   * # GNU long name and pax path / size are applied to the entry.
+   */
+  static int next_tar_entry(byte_source &source, tar_entry &entry)
+  {
+    char block[tar_block_size];
+    std::string long_name;
+    bool has_long_name(false);
+    uint64_t pax_size(0);
+    bool has_pax_size(false);
+
+    for (; ;) {
+      int ret(source.readFull(block, tar_block_size));
+      if (ret < 0)
+        return -1;
+
+      bool zero_block(true);
+      for (std::size_t i(0); i < tar_block_size && zero_block; ++i)
+        zero_block = !block[i];
+      if (zero_block)
+        return 0;
+
+      // checksum is computed as the field filled with spaces
+      uint64_t checksum(0);
+      for (std::size_t i(0); i < tar_block_size; ++i)
+        checksum += (i >= 148 && i < 156) ? ' ' : static_cast<unsigned char>(block[i]);
+      if (checksum != tar_number(block + 148, 8))
+        return -1;
+
+      char type(block[156]);
+      uint64_t size(tar_number(block + 124, 12));
+      std::string data;
+
+      switch (type) {
+      case 'L':
+        if (read_long_data(source, size, long_name) < 0)
+          return -1;
+        long_name.resize(strnlen(long_name.c_str(), long_name.length()));
+        has_long_name = true;
+        continue;
+      case 'x':
+        // records are "<length> <key>=<value>\n"
+        if (read_long_data(source, size, data) < 0)
+          return -1;
+        for (std::size_t pos(0); pos < data.length(); ) {
+          std::size_t space(data.find(' ', pos));
+          if (space == std::string::npos || data[pos] < '0' || data[pos] > '9')
+            return -1;
+          // the length is all digits before the space,and covers at
+          // least the space,one byte of the record and the newline.
+          char *len_end(nullptr);
+          uint64_t len(strtoull(data.c_str() + pos, &len_end, 10));
+          if (len_end != data.c_str() + space || len > data.length() - pos ||
+              len < space - pos + 3 || data[pos + len - 1] != '\n')
+            return -1;
+          std::string_view record(data.data() + space + 1, pos + len - space - 2);
+          if (record.starts_with("path=")) {
+            long_name = record.substr(5);
+            has_long_name = true;
+          } else if (record.starts_with("size=")) {
+            std::string value(record.substr(5));
+            char *value_end(nullptr);
+            errno = 0;
+            pax_size = strtoull(value.c_str(), &value_end, 10);
+            if (value.empty() || *value_end || errno == ERANGE)
+              return -1;
+            has_pax_size = true;
+          }
+          pos += len;
+        }
+        continue;
+      case 'g':
+      case 'K':
+        // global pax header,GNU long link name
+        if (source.skip(size + tar_padding(size)) < 0)
+          return -1;
+        continue;
+      default:
+        break;
+      }
+
+      if (has_long_name)
+        entry.path = long_name;
+      else {
+        entry.path.clear();
+        // ustar splits long name into prefix and name
+        if (!memcmp(block + 257, "ustar", 5) && block[345]) {
+          entry.path = tar_string(block + 345, 155);
+          entry.path.push_back('/');
+        }
+        entry.path.append(tar_string(block, 100));
+      }
+      entry.type = type ? type : '0';
+      // old tar marks directory by the trailing "/"
+      if (entry.type == '0' && entry.path.ends_with('/'))
+        entry.type = '5';
+      entry.size = has_pax_size ? pax_size : size;
+      entry.mode = tar_number(block + 100, 8) & 0777;
+      // links,devices,directories and FIFOs have no data
+      if (entry.type >= '1' && entry.type <= '6')
+        entry.size = 0;
+      return 1;
+    }
+  }
+
+  static bool is_tar_regular(char type)
+  {
+    // '7' is contiguous file,treated as regular
+    return type == '0' || type == '7';
+  }
+
+  int archive_reader::listTar(mhwimm_path_list_ns::path_list &directory_list,
+                              mhwimm_path_list_ns::path_list &regular_file_list)
+  {
+    auto source(open_source(fd_, path_, format_));
+    if (!source)
+      return -1;
+
+    list_builder builder = {
+      .directory_list = directory_list,
+      .regular_file_list = regular_file_list,
+    };
+    tar_entry entry;
+    std::string path;
+    int ret(0);
+    while ((ret = next_tar_entry(*source, entry)) > 0) {
+      if (normalize_path(entry.path, path) < 0 ||
+          source->skip(entry.size + tar_padding(entry.size)) < 0) {
+        ret = -1;
+        break;
+      }
+      if (entry.type == '5')
+        ret = builder.addDir(path);
+      else if (is_tar_regular(entry.type))
+        ret = builder.addFile(path);
+      if (ret < 0)
+        break;
+    }
+    if (!ret && source->drain() < 0)
+      ret = -1;
+    if (source->finish() < 0)
+      ret = -1;
+    return ret < 0 ? -1 : 0;
+  }
+
+  /**
+   * write_tar_data - write @size bytes from @source to @fd
+   * return:          0 => succeed
+   *                  -errno => failed to write,the data is skipped
+   *                  1 => failed to read the stream
+   */
+  static int write_tar_data(byte_source &source, int fd, uint64_t size)
+  {
+    char *buf(io_buffer());
+    while (size) {
+      std::size_t len(size < io_buf_size ? size : io_buf_size);
+      if (source.readFull(buf, len) < 0)
+        return 1;
+      size -= len;
+      int ret(write_all(fd, buf, len));
+      if (ret < 0)
+        return source.skip(size) < 0 ? 1 : ret;
+    }
+    return 0;
+  }
+
+  std::size_t archive_reader::extractTar(int dirfd, mhwimm_fsbatch_ns::fs_op *ops, std::size_t nops)
+  {
+    std::unordered_map<std::string_view, mhwimm_fsbatch_ns::fs_op *> op_of;
+    for (std::size_t i(0); i < nops; ++i)
+      (void)op_of.emplace(ops[i].path, &ops[i]);
+
+    auto source(open_source(fd_, path_, format_));
+    bool stream_err(!source);
+    tar_entry entry;
+    std::string path;
+
+    while (!stream_err) {
+      int ret(next_tar_entry(*source, entry));
+      if (ret <= 0) {
+        stream_err = ret < 0 || source->drain() < 0;
+        break;
+      }
+      if (normalize_path(entry.path, path) < 0) {
+        stream_err = true;
+        break;
+      }
+
+      auto found(is_tar_regular(entry.type) ? op_of.find(path) : op_of.end());
+      if (found == op_of.end() ||
+          found->second->result != mhwimm_fsbatch_ns::fs_op_pending) {
+        if (source->skip(entry.size + tar_padding(entry.size)) < 0)
+          stream_err = true;
+        continue;
+      }
+
+      mhwimm_fsbatch_ns::fs_op *op(found->second);
+      int fd(create_file(dirfd, op->path, entry.mode));
+      if (fd < 0) {
+        op->result = fd;
+        stream_err = source->skip(entry.size + tar_padding(entry.size)) < 0;
+        continue;
+      }
+      ret = write_tar_data(*source, fd, entry.size);
+      (void)::close(fd);
+      if (ret == 1) {
+        stream_err = true;
+        (void)unlinkat(dirfd, op->path, 0);
+        break;
+      }
+      op->result = ret;
+      if (ret)
+        (void)unlinkat(dirfd, op->path, 0);
+      if (source->skip(tar_padding(entry.size)) < 0)
+        stream_err = true;
+    }
+    if (source && source->finish() < 0)
+      stream_err = true;
+
+    // the files written from a corrupted stream can not be trusted
+    std::size_t nfailed(0);
+    for (std::size_t i(0); i < nops; ++i) {
+      if (stream_err && !ops[i].result) {
+        (void)unlinkat(dirfd, ops[i].path, 0);
+        ops[i].result = -EIO;
+      } else if (ops[i].result == mhwimm_fsbatch_ns::fs_op_pending)
+        ops[i].result = stream_err ? -EIO : -ENOENT;
+      if (ops[i].result)
+        ++nfailed;
+    }
+    return nfailed;
+  }
+
+}
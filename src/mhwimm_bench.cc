@@ -0,0 +1,540 @@
+/**
+ * Benchmark
+ * Drives mhwimm_executor and mhwimm_db without UI,the same way the
+ * batch worker does,that is,Executor and DB work back to back in
+ * main thread.the round with DB before Executor,the command itself
+ * and the round with DB after Executor are timed apart.
+ * For each size,a session of its own is made up under the benchmark
+ * root,and the files are spread over the synthetic mods evenly :
+ *   generate  => makeup the mod trees
+ *   install   => query : is the mod installed,execute : deploy,
+ *                record : DB inserts the records
+ *   installed => query : names of installed mods,execute : list
+ *   uninstall => query : records of the mod,execute : remove,
+ *                record : DB deletes the records
+ * The result is written in JSON,"scaling" has the exponent of each
+ * phase between adjacent sizes,1.0 is linear.
+ * usage :
+ *   mhwimm_bench [--root=<dir>] [--sizes=<n,n,...>] [--mods=<n>]
+ *                [--depth=<n>] [--fanout=<n>] [--file-size=<bytes>]
+ *                [--deploy=link|reflink|copy|store] [--nworkers=<n>]
+ *                [--out=<file>] [--keep]
+ */
+#include "mhwimm_executor.h"
+#include "mhwimm_database.h"
+#include "mhwimm_database_thread.h"
+#include "mhwimm_sync_mechanism.h"
+#include "mhwimm_config.h"
+#include "mhwimm_treegen.h"
+
+#include <getopt.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <string>
+#include <vector>
+
+atomic_t program_exit = 0;
+
+mhwimm_sync_mechanism_ns::db_request_queue exedb_queue;
+
+const typename mhwimm_config_ns::get_config_traits<mhwimm_config_ns::config_t>::skey_t *
+pmhwiroot_path(nullptr);
+
+constexpr const char *mhwimm_db_name("mhwimm_db");
+
+using db_req_t = std::function<std::future<bool>(void)>;
+
+/**
+ * bench_options - options from command line
+ * @root:          where the sessions are made up,a temporary directory
+ *                 is created if it is empty
+ * @sizes:         total number of files of each run
+ * @nmods:         the files of a run are spread over @nmods mods
+ * @tree:          shape of the mod trees,nfiles and seed are set by run
+ * @deploy:        deploy strategy of install
+ * @nworkers:      workers of Executor,_zero_ means number of CPUs
+ * @out:           where to write the result,stdout if it is empty
+ * @keep:          keep the sessions after the runs
+ */
+struct bench_options {
+  std::string root;
+  std::vector<std::size_t> sizes;
+  std::size_t nmods;
+  mhwimm_treegen_ns::tree_spec tree;
+  std::string deploy;
+  int nworkers;
+  std::string out;
+  bool keep;
+};
+
+/**
+ * step_times - elapsed milliseconds of the steps of a phase
+ * @query:      round with DB before Executor
+ * @execute:    Executor
+ * @record:     round with DB after Executor
+ */
+struct step_times {
+  double query;
+  double execute;
+  double record;
+
+  double total(void) const noexcept { return query + execute + record; }
+};
+
+/**
+ * run_result - result of one size
+ * @stats:      what been generated,all mods
+ * @generate:   milliseconds to generate the mod trees
+ * @stmt_cache_hits:   counters of the compiled statement cache of DB,
+ * @stmt_cache_misses: all phases are counted
+ */
+struct run_result {
+  mhwimm_treegen_ns::tree_stats stats;
+  double generate;
+  std::size_t stmt_cache_hits;
+  std::size_t stmt_cache_misses;
+  step_times install;
+  step_times installed;
+  step_times uninstall;
+};
+
+/**
+ * bench_session - Executor and DB of one run
+ * @conf:          config of the session,paths are under the session root
+ * @mfl:           containers used to interactive with database
+ */
+struct bench_session {
+  mhwimm_config_ns::config_t conf;
+  mhwimm_sync_mechanism_ns::mod_files_list mfl;
+  std::unique_ptr<mhwimm_executor_ns::mhwimm_executor> exe;
+  std::unique_ptr<mhwimm_db_ns::mhwimm_db> db;
+};
+
+static double elapsed_ms(std::chrono::steady_clock::time_point since)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+/* db_round - queue the request and process it in current thread */
+static bool db_round(bench_session &s, const db_req_t &req)
+{
+  std::future<bool> f(req());
+  mhwimm_db_process_queue(*s.db);
+  return f.get();
+}
+
+/* drain_output - discard the command output,or print it to stderr if @print */
+static void drain_output(bench_session &s, bool print)
+{
+  std::string msg;
+  while (s.exe->getCMDOutput(msg) == 0)
+    if (print)
+      std::cerr << msg << std::endl;
+}
+
+/**
+ * run_cmd - execute @cmd_line as the batch worker does
+ * @before:  request of the round before Executor,nullptr if none
+ * @after:   request of the round after Executor,nullptr if none
+ * @t:       where to add the elapsed time of each step
+ * return:   0 OR -1,the output is printed to stderr if failed
+ */
+static int run_cmd(bench_session &s, const std::string &cmd_line,
+                   const db_req_t &before, const db_req_t &after, step_times &t)
+{
+  s.mfl.lock.lock();
+  s.mfl.regular_file_list.clear();
+  s.mfl.directory_list.clear();
+  s.mfl.conflict_list.clear();
+  s.mfl.content_hash_list.clear();
+  s.mfl.removed_list.clear();
+  s.mfl.file_meta_list.clear();
+  s.mfl.deployed_hash_list.clear();
+  s.mfl.source_list.clear();
+  s.mfl.mod_source.clear();
+  s.mfl.lock.unlock();
+  s.exe->resetStatus();
+
+  (void)s.exe->parseCMD(cmd_line);
+  if (s.exe->currentStatus() == mhwimm_executor_ns::mhwimm_executor_status::ERROR)
+    goto err_output;
+
+  {
+    auto start(std::chrono::steady_clock::now());
+    if (before && !db_round(s, before))
+      goto err_db;
+    t.query += elapsed_ms(start);
+
+    start = std::chrono::steady_clock::now();
+    (void)s.exe->executeCurrentCMD();
+    if (s.exe->currentStatus() == mhwimm_executor_ns::mhwimm_executor_status::ERROR)
+      goto err_output;
+    t.execute += elapsed_ms(start);
+
+    // DB is consistent with filesystem,the journal is finished,
+    // the files of INSTALL are removed if DB failed to record them.
+    start = std::chrono::steady_clock::now();
+    if (after && !db_round(s, after)) {
+      if (s.exe->currentCMD() == mhwimm_executor_ns::mhwimm_executor_cmd::INSTALL)
+        (void)s.exe->rollbackJournal();
+      else
+        (void)s.exe->commitJournal();
+      goto err_db;
+    }
+    if (after)
+      (void)s.exe->commitJournal();
+    t.record += elapsed_ms(start);
+  }
+
+  drain_output(s, false);
+  return 0;
+
+ err_db:
+  std::cerr << "mhwimm_bench: error: DB failed - " << cmd_line << std::endl;
+  return -1;
+
+ err_output:
+  std::cerr << "mhwimm_bench: error: command failed - " << cmd_line << std::endl;
+  drain_output(s, true);
+  return -1;
+}
+
+/**
+ * setup_session - makeup the directories of a session under @root,
+ *                 and prepare Executor and DB
+ * return:         0 OR -1
+ */
+static int setup_session(bench_session &s, const std::string &root, const bench_options &opts)
+{
+  s.conf = mhwimm_config_ns::config_t {
+    .userhome = root,
+    .mhwiroot = root + "/game",
+    .mhwimmroot = root + "/mhwimm",
+    .nworkers = opts.nworkers,
+    .deploy = opts.deploy,
+  };
+  std::string mods_dir(root + "/mods");
+  for (const auto *dir : std::initializer_list<const std::string *> {
+      &root, &s.conf.mhwiroot, &s.conf.mhwimmroot, &mods_dir })
+    if (mkdir(dir->c_str(), 0755) < 0) {
+      std::cerr << "mhwimm_bench: error: mkdir " << *dir << " : " << strerror(errno) << std::endl;
+      return -1;
+    }
+
+  pmhwiroot_path = &s.conf.mhwiroot;
+  s.db = std::make_unique<mhwimm_db_ns::mhwimm_db>(mhwimm_db_name, s.conf.mhwimmroot.c_str());
+  if (mhwimm_db_prepare(*s.db) < 0)
+    return -1;
+
+  s.exe = std::make_unique<mhwimm_executor_ns::mhwimm_executor>(&s.conf);
+  s.exe->setMFLImpl(&s.mfl);
+  s.exe->setConflictQuery([&s](void) -> int {
+                            return db_round(s, [&s](void) {
+                                                 return regDBop_find_conflicts(&s.mfl);
+                                               }) ? 0 : -1;
+                          });
+  s.exe->setOutputSink([](const std::string &) {});
+  return 0;
+}
+
+/**
+ * run_size - generate,install,list and uninstall @nfiles files
+ * @root:     root of the session
+ * return:    0 OR -1
+ */
+static int run_size(const bench_options &opts, const std::string &root, std::size_t nfiles,
+                    run_result &r)
+{
+  bench_session s;
+  if (setup_session(s, root, opts) < 0)
+    return -1;
+
+  // install takes the mod directory relative to current work directory
+  std::string mods_dir(root + "/mods");
+  if (chdir(mods_dir.c_str()) < 0)
+    return -1;
+
+  std::vector<std::string> mods;
+  {
+    mhwimm_thread_pool_ns::work_stealing_pool pool(opts.nworkers);
+    auto start(std::chrono::steady_clock::now());
+    for (std::size_t m(0), first(0); m < opts.nmods; ++m) {
+      // the mods never conflict,because the files have distinct indexes
+      mhwimm_treegen_ns::tree_spec spec(opts.tree);
+      spec.nfiles = nfiles / opts.nmods + (m < nfiles % opts.nmods);
+      spec.first_index = first;
+      spec.seed = nfiles;
+      first += spec.nfiles;
+      mhwimm_treegen_ns::tree_stats stats;
+      mods.push_back(std::string{"mod"} + std::to_string(m));
+      if (mhwimm_treegen_ns::generate_tree(mods_dir + "/" + mods.back(), spec, stats, pool) < 0) {
+        std::cerr << "mhwimm_bench: error: generate " << mods.back() << " : "
+                  << strerror(errno) << std::endl;
+        return -1;
+      }
+      r.stats.ndirs += stats.ndirs;
+      r.stats.nfiles += stats.nfiles;
+      r.stats.nbytes += stats.nbytes;
+    }
+    r.generate = elapsed_ms(start);
+  }
+
+  auto ask_mod = [&s](void) {
+                   return regDBop_getInstalled_Modinfo(s.exe->getCurrentModName(), &s.mfl);
+                 };
+  for (const auto &mod : mods)
+    if (run_cmd(s, "install " + mod + " " + mod + " " + opts.deploy, ask_mod,
+                [&s](void) {
+                  return regDBop_add_mod_info(s.exe->getCurrentModName(), &s.mfl);
+                }, r.install) < 0)
+      return -1;
+
+  if (run_cmd(s, "installed",
+              [&s](void) { return regDBop_getAllInstalled_Modsname(&s.mfl); },
+              nullptr, r.installed) < 0)
+    return -1;
+
+  for (const auto &mod : mods)
+    if (run_cmd(s, "uninstall " + mod, ask_mod,
+                [&s](void) {
+                  return regDBop_remove_mod_info(s.exe->getCurrentModName());
+                }, r.uninstall) < 0)
+      return -1;
+
+  s.db->getStmtCacheStats(r.stmt_cache_hits, r.stmt_cache_misses);
+  s.db->closeDB();
+  return 0;
+}
+
+/* json_steps - "name": {steps} of a phase */
+static void json_steps(FILE *fp, const char *name, const step_times &t, std::size_t nfiles,
+                       bool last)
+{
+  fprintf(fp, "        \"%s\": { \"query_ms\": %.3f, \"execute_ms\": %.3f, \"record_ms\": %.3f, "
+          "\"total_ms\": %.3f, \"us_per_file\": %.3f }%s\n",
+          name, t.query, t.execute, t.record, t.total(),
+          nfiles ? t.total() * 1000 / nfiles : 0.0, last ? "" : ",");
+}
+
+/* write_json - write the result of all runs */
+static void write_json(FILE *fp, const bench_options &opts, const std::vector<run_result> &runs)
+{
+  fprintf(fp, "{\n  \"benchmark\": \"mhwimm\",\n");
+  fprintf(fp, "  \"config\": { \"mods\": %zu, \"depth\": %u, \"fanout\": %u, \"file_size\": %zu, "
+          "\"deploy\": \"%s\", \"nworkers\": %d },\n",
+          opts.nmods, opts.tree.depth, opts.tree.fanout, opts.tree.file_size,
+          opts.deploy.c_str(), opts.nworkers);
+
+  fprintf(fp, "  \"runs\": [\n");
+  for (std::size_t i(0); i < runs.size(); ++i) {
+    const auto &r(runs[i]);
+    fprintf(fp, "    {\n      \"files\": %zu, \"dirs\": %zu, \"bytes\": %llu,\n",
+            r.stats.nfiles, r.stats.ndirs, static_cast<unsigned long long>(r.stats.nbytes));
+    fprintf(fp, "      \"phases\": {\n");
+    fprintf(fp, "        \"generate\": { \"total_ms\": %.3f },\n", r.generate);
+    json_steps(fp, "install", r.install, r.stats.nfiles, false);
+    json_steps(fp, "installed", r.installed, r.stats.nfiles, false);
+    json_steps(fp, "uninstall", r.uninstall, r.stats.nfiles, true);
+    fprintf(fp, "      },\n");
+    std::size_t nlookups(r.stmt_cache_hits + r.stmt_cache_misses);
+    fprintf(fp, "      \"stmt_cache\": { \"hits\": %zu, \"misses\": %zu, \"hit_rate\": %.3f }\n",
+            r.stmt_cache_hits, r.stmt_cache_misses,
+            nlookups ? static_cast<double>(r.stmt_cache_hits) / nlookups : 0.0);
+    fprintf(fp, "    }%s\n", i + 1 < runs.size() ? "," : "");
+  }
+  fprintf(fp, "  ],\n");
+
+  // t ~ n^k between adjacent sizes
+  const char *names[] = { "install", "installed", "uninstall" };
+  const step_times run_result::*phases[] = {
+    &run_result::install, &run_result::installed, &run_result::uninstall
+  };
+  fprintf(fp, "  \"scaling\": {\n");
+  for (std::size_t p(0); p < 3; ++p) {
+    fprintf(fp, "    \"%s\": [", names[p]);
+    for (std::size_t i(1); i < runs.size(); ++i) {
+      double t0((runs[i - 1].*phases[p]).total()), t1((runs[i].*phases[p]).total());
+      double n0(runs[i - 1].stats.nfiles), n1(runs[i].stats.nfiles);
+      double k(t0 > 0 && t1 > 0 && n0 > 0 && n1 > n0 ? std::log(t1 / t0) / std::log(n1 / n0) : 0);
+      fprintf(fp, "%s{ \"from\": %zu, \"to\": %zu, \"exponent\": %.3f }", i > 1 ? ", " : " ",
+              runs[i - 1].stats.nfiles, runs[i].stats.nfiles, k);
+    }
+    fprintf(fp, " ]%s\n", p < 2 ? "," : "");
+  }
+  fprintf(fp, "  }\n}\n");
+}
+
+/**
+ * parse_sizes - parse "n,n,..." into @sizes
+ * return:       0 OR -1
+ */
+static int parse_sizes(const char *arg, std::vector<std::size_t> &sizes)
+{
+  sizes.clear();
+  for (const char *p(arg); *p; ) {
+    char *end(nullptr);
+    unsigned long long n(strtoull(p, &end, 10));
+    if (end == p || !n)
+      return -1;
+    sizes.push_back(n);
+    if (*end == ',')
+      ++end;
+    else if (*end)
+      return -1;
+    p = end;
+  }
+  return sizes.empty() ? -1 : 0;
+}
+
+/**
+ * parse_args - parse command line arguments
+ * return:      0 OR -1
+ */
+static int parse_args(int argc, char *argv[], bench_options &opts)
+{
+  static const struct option longopts[] = {
+    { "root", required_argument, nullptr, 'r' },
+    { "sizes", required_argument, nullptr, 'n' },
+    { "mods", required_argument, nullptr, 'm' },
+    { "depth", required_argument, nullptr, 'd' },
+    { "fanout", required_argument, nullptr, 'f' },
+    { "file-size", required_argument, nullptr, 's' },
+    { "deploy", required_argument, nullptr, 'D' },
+    { "nworkers", required_argument, nullptr, 'w' },
+    { "out", required_argument, nullptr, 'o' },
+    { "keep", no_argument, nullptr, 'k' },
+    { nullptr, 0, nullptr, 0 },
+  };
+
+  int opt(0);
+  while ((opt = getopt_long(argc, argv, "", longopts, nullptr)) != -1) {
+    switch (opt) {
+    case 'r':
+      opts.root = optarg;
+      break;
+    case 'n':
+      if (parse_sizes(optarg, opts.sizes) < 0)
+        goto usage;
+      break;
+    case 'm':
+      opts.nmods = strtoul(optarg, nullptr, 10);
+      if (!opts.nmods)
+        goto usage;
+      break;
+    case 'd':
+      opts.tree.depth = strtoul(optarg, nullptr, 10);
+      break;
+    case 'f':
+      opts.tree.fanout = strtoul(optarg, nullptr, 10);
+      break;
+    case 's':
+      opts.tree.file_size = strtoull(optarg, nullptr, 10);
+      break;
+    case 'D':
+      opts.deploy = optarg;
+      break;
+    case 'w':
+      opts.nworkers = atoi(optarg);
+      if (opts.nworkers < 0)
+        goto usage;
+      break;
+    case 'o':
+      opts.out = optarg;
+      break;
+    case 'k':
+      opts.keep = true;
+      break;
+    default:
+      goto usage;
+    }
+  }
+  if (optind < argc)
+    goto usage;
+  return 0;
+
+ usage:
+  std::cerr << "usage: mhwimm_bench [--root=<dir>] [--sizes=<n,n,...>] [--mods=<n>]\n"
+            << "                    [--depth=<n>] [--fanout=<n>] [--file-size=<bytes>]\n"
+            << "                    [--deploy=link|reflink|copy|store] [--nworkers=<n>]\n"
+            << "                    [--out=<file>] [--keep]" << std::endl;
+  return -1;
+}
+
+int main(int argc, char *argv[])
+{
+  bench_options opts = {
+    .sizes = { 1000, 10000, 100000, 1000000 },
+    .nmods = 1,
+    .tree = mhwimm_treegen_ns::tree_spec {
+      .depth = 3,
+      .fanout = 8,
+      .file_size = 1024,
+    },
+    .deploy = "link",
+    .nworkers = 0,
+    .keep = false,
+  };
+  if (parse_args(argc, argv, opts) < 0)
+    return 2;
+
+  // the root is removed at last only if it is made by us
+  bool made_root(true);
+  if (opts.root.empty()) {
+    char tmpl[] = "/tmp/mhwimm_bench.XXXXXX";
+    if (!mkdtemp(tmpl)) {
+      std::cerr << "mhwimm_bench: error: mkdtemp : " << strerror(errno) << std::endl;
+      return 1;
+    }
+    opts.root = tmpl;
+  } else if (mkdir(opts.root.c_str(), 0755) < 0) {
+    if (errno != EEXIST) {
+      std::cerr << "mhwimm_bench: error: mkdir " << opts.root << " : " << strerror(errno) << std::endl;
+      return 1;
+    }
+    made_root = false;
+  }
+
+  std::vector<run_result> runs;
+  int ret(0);
+  for (std::size_t n : opts.sizes) {
+    std::string session_root(opts.root + "/n" + std::to_string(n));
+    run_result r = {};
+    std::cerr << "mhwimm_bench: " << n << " files ..." << std::endl;
+    if (run_size(opts, session_root, n, r) < 0)
+      ret = 1;
+
+    if (!opts.keep && (chdir(opts.root.c_str()) < 0 ||
+                       mhwimm_treegen_ns::remove_tree(session_root) < 0))
+      std::cerr << "mhwimm_bench: warning: failed to remove " << session_root << std::endl;
+    if (ret)
+      break;
+
+    std::cerr << "mhwimm_bench: " << n << " files : install " << r.install.total()
+              << " ms,installed " << r.installed.total()
+              << " ms,uninstall " << r.uninstall.total() << " ms" << std::endl;
+    runs.push_back(r);
+  }
+  if (!opts.keep && made_root)
+    (void)rmdir(opts.root.c_str());
+
+  FILE *fp(opts.out.empty() ? stdout : fopen(opts.out.c_str(), "w"));
+  if (!fp) {
+    std::cerr << "mhwimm_bench: error: open " << opts.out << " : " << strerror(errno) << std::endl;
+    return 1;
+  }
+  write_json(fp, opts, runs);
+  if (fp != stdout)
+    (void)fclose(fp);
+  return ret;
+}
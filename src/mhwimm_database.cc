@@ -13,7 +13,6 @@
 #define DB_ERROR_OPEN "db: error: failed to open database."
 #define DB_ERROR_CLOSE "db: error: failed to close database."
 #define DB_ERROR_BADHANDLER "db: error: attempt to operate a invalid database."
-#define DB_ERROR_PRETABLE "db: error: failed to prepare SQL statment for create table."
 #define DB_ERROR_CRTABLE "db: error: failed to create table."
 #define DB_ERROR_LACKVS "db: error: lack values to be inserted."
 #define DB_ERROR_BADOP "db: error: un-supported database operation."
@@ -21,9 +20,121 @@
 #define DB_ERROR_BINDV "db: error: failed to setup field values."
 #define DB_ERROR_FAILEDAD "db: error: failed to process insert/delete."
 #define DB_ERROR_FAILEDASK "db: error: failed to retrieve data records."
+#define DB_ERROR_TRANSACTION "db: error: failed to begin/commit transaction."
+#define DB_ERROR_SCHEMAVER "db: error: failed to read schema version."
+#define DB_ERROR_NEWSCHEMA "db: error: database was created by a newer version."
+#define DB_ERROR_FOREIGNKEY "db: error: failed to enable foreign key constraints."
+#define DB_ERROR_TEMPTABLE "db: error: failed to setup temporary table."
+#define DB_ERROR_NOMOD "db: error: the mod is not recorded."
+#define DB_ERROR_ABORTED "db: error: transaction aborted by caller."
 
 namespace mhwimm_db_ns {
 
+  /**
+   * sqlSchemaUpgrade - SQL statements to upgrade database schema,
+   *                    element at index N upgrades the schema from
+   *                    version N to N + 1
+   * # version 0 is an empty database or the database which only
+   *   have the legacy table "mhwimm_db_table"
+   * # mods :  one row for each installed mod
+   *   files : one row for each file of the mod,refer to mods.id,
+   *           entry_type is the value of db_entry_type
+   * # files_owner_idx covers the lookup from a path to the mod owns it
+   * # content_hash is the key of the blob in content store,NULL if the
+   *   file is not deployed from the store
+   * # inode,size,mtime_ns,nlink are the metadata of the regular file
+   *   after deployed,NULL if not recorded
+   */
+  static const char *const sqlSchemaUpgrade[] = {
+    /* 0 -> 1 */
+    "CREATE TABLE mods ("
+    "id INTEGER PRIMARY KEY,"
+    "name TEXT NOT NULL UNIQUE,"
+    "install_date TEXT NOT NULL,"
+    "file_count INTEGER NOT NULL DEFAULT 0);"
+    "CREATE TABLE files ("
+    "mod_id INTEGER NOT NULL REFERENCES mods(id) ON DELETE CASCADE,"
+    "file_path TEXT NOT NULL);"
+    "CREATE INDEX files_mod_id_idx ON files(mod_id);"
+    "CREATE INDEX files_file_path_idx ON files(file_path);",
+    /* 1 -> 2 */
+    "ALTER TABLE files ADD COLUMN entry_type INTEGER NOT NULL DEFAULT 0;",
+    /* 2 -> 3 */
+    "DROP INDEX files_file_path_idx;"
+    "CREATE INDEX files_owner_idx ON files(file_path, mod_id, entry_type);",
+    /* 3 -> 4 */
+    "ALTER TABLE files ADD COLUMN content_hash TEXT;"
+    "CREATE INDEX files_content_hash_idx ON files(content_hash) "
+    "WHERE content_hash IS NOT NULL;",
+    /* 4 -> 5 */
+    "ALTER TABLE files ADD COLUMN inode INTEGER;"
+    "ALTER TABLE files ADD COLUMN size INTEGER;"
+    "ALTER TABLE files ADD COLUMN mtime_ns INTEGER;"
+    "ALTER TABLE files ADD COLUMN nlink INTEGER;",
+    /* 5 -> 6 */
+    "ALTER TABLE mods ADD COLUMN source TEXT;",
+  };
+  static_assert(sizeof(sqlSchemaUpgrade) / sizeof(sqlSchemaUpgrade[0]) ==
+                mhwimm_db::schema_version_);
+
+  /**
+   * sqlMigrateLegacyTable - SQL statement to move the records in legacy
+   *                         table into schema version 1
+   */
+  static const char *const sqlMigrateLegacyTable =
+    "INSERT INTO mods (name, install_date, file_count) "
+    "SELECT mod_name, MIN(install_date), COUNT(*) FROM mhwimm_db_table "
+    "GROUP BY mod_name ORDER BY MIN(rowid);"
+    "INSERT INTO files (mod_id, file_path) "
+    "SELECT mods.id, mhwimm_db_table.file_path FROM mhwimm_db_table "
+    "JOIN mods ON mods.name = mhwimm_db_table.mod_name "
+    "ORDER BY mhwimm_db_table.rowid;"
+    "DROP TABLE mhwimm_db_table;";
+
+  /* sqlFixedStmts - SQL statements of db_stmt_id */
+  static const char *const sqlFixedStmts[] = {
+    /* ADD_MOD */
+    "INSERT INTO mods (name, install_date, file_count, source) VALUES (?1, ?2, ?3, ?4);",
+    /* ADD_MOD_FILE */
+    "INSERT INTO files (mod_id, file_path, entry_type, content_hash) VALUES (?1, ?2, ?3, ?4);",
+    /* UPSERT_MOD */
+    "INSERT INTO mods (name, install_date, file_count) VALUES ($key1, $key3, 1) "
+    "ON CONFLICT (name) DO UPDATE SET file_count = file_count + 1;",
+    /* ADD_CANDIDATE */
+    "INSERT OR IGNORE INTO temp.candidate_paths (file_path) VALUES (?1);",
+    /* ASK_CONFLICTS */
+    /* CROSS JOIN forces candidates to be the outer loop */
+    "SELECT mods.name, files.file_path FROM temp.candidate_paths "
+    "CROSS JOIN files ON files.file_path = candidate_paths.file_path "
+    "JOIN mods ON mods.id = files.mod_id "
+    "WHERE files.entry_type != 2 "
+    "ORDER BY mods.name, files.file_path;",
+    /* ASK_CONTENT_HASHES */
+    "SELECT DISTINCT content_hash FROM files WHERE content_hash IS NOT NULL;",
+    /* ASK_MOD_ID */
+    "SELECT id FROM mods WHERE name = ?1;",
+    /* DEL_MOD_FILE */
+    /* files_owner_idx leads with file_path,thus the lookup is one probe */
+    "DELETE FROM files WHERE file_path = ?2 AND mod_id = ?1;",
+    /* UPDATE_MOD */
+    "UPDATE mods SET install_date = ?2, file_count = file_count + ?3, "
+    "source = COALESCE(?4, source) WHERE id = ?1;",
+    /* SET_FILE_META */
+    /* NULL ?6 keeps the content hash recorded at inserting */
+    "UPDATE files SET inode = ?2, size = ?3, mtime_ns = ?4, nlink = ?5, "
+    "content_hash = COALESCE(?6, content_hash) WHERE rowid = ?1;",
+    /* ASK_FILE_META */
+    /* NULL ?1 selects all mods */
+    "SELECT mods.name, files.file_path, files.inode, files.size, files.mtime_ns, files.nlink, "
+    "files.content_hash, mods.source "
+    "FROM files JOIN mods ON mods.id = files.mod_id "
+    "WHERE files.entry_type != 2 AND (?1 IS NULL OR mods.name = ?1) "
+    "ORDER BY mods.id, files.rowid;",
+    /* SET_FILE_HASH */
+    "UPDATE files SET content_hash = ?3 WHERE file_path = ?2 AND mod_id = ?1;",
+  };
+  static_assert(sizeof(sqlFixedStmts) / sizeof(sqlFixedStmts[0]) ==
+                static_cast<std::size_t>(db_stmt_id::NR_STMT_ID));
 
   /* openDB - method to open a sqlite3 database */
   int mhwimm_db::openDB(void)
@@ -40,6 +151,14 @@ namespace mhwimm_db_ns {
     if (ret < 0) {
       current_status_ = DB_STATUS::DB_ERROR;
       local_err_msg_ = DB_ERROR_OPEN;
+      return ret;
+    }
+
+    // files are removed together with their mod via ON DELETE CASCADE
+    if (execRawSQL("PRAGMA foreign_keys = ON;") < 0) {
+      current_status_ = DB_STATUS::DB_ERROR;
+      local_err_msg_ = DB_ERROR_FOREIGNKEY;
+      ret = -1;
     }
     return ret;
   }
@@ -48,6 +167,8 @@ namespace mhwimm_db_ns {
   int mhwimm_db::closeDB(void)
   {
     current_status_ = DB_STATUS::DB_WORKING;
+    releaseStmt();
+    finalizeStmtCache();
     int ret = sqlite3_close_v2(db_handler_);
     current_status_ = DB_STATUS::DB_IDLE;
     ret = ret != SQLITE_OK ? -1 : 0;
@@ -58,7 +179,45 @@ namespace mhwimm_db_ns {
     return ret;
   }
 
-  /* tryCreateTable - method to create table */
+  /* getSchemaVersion - read PRAGMA user_version */
+  int mhwimm_db::getSchemaVersion(int &version)
+  {
+    sqlite3_stmt *stmt(nullptr);
+    if (sqlite3_prepare_v2(db_handler_, "PRAGMA user_version;", -1, &stmt,
+                           NULL) != SQLITE_OK)
+      return -1;
+
+    int ret(-1);
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+      version = sqlite3_column_int(stmt, 0);
+      ret = 0;
+    }
+    sqlite3_finalize(stmt);
+    return ret;
+  }
+
+  /* isLegacyTableExist - lookup legacy table in sqlite_master */
+  bool mhwimm_db::isLegacyTableExist(void)
+  {
+    sqlite3_stmt *stmt(nullptr);
+    if (sqlite3_prepare_v2(db_handler_,
+                           "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = ?1;",
+                           -1, &stmt, NULL) != SQLITE_OK)
+      return false;
+
+    sqlite3_bind_text(stmt, 1, legacy_table_name_, -1, SQLITE_STATIC);
+    bool exist(sqlite3_step(stmt) == SQLITE_ROW);
+    sqlite3_finalize(stmt);
+    return exist;
+  }
+
+  /**
+   * tryCreateTable - method to create tables,or upgrade the tables
+   *                  of an existed database to current schema version
+   * return:          0 OR -1
+   * # all upgrade steps are processed in one transaction,if any of
+   *   them failed,the database is left untouched.
+   */
   int mhwimm_db::tryCreateTable(void)
   {
     current_status_ = DB_STATUS::DB_WORKING;
@@ -68,110 +227,261 @@ namespace mhwimm_db_ns {
       return -1;
     }
 
-    int ret = sqlite3_prepare_v2(db_handler_, sqlCreateTable_, -1,
-                                 &sql_stmt_, NULL);
-    if (ret != SQLITE_OK) {
+    int version(0);
+    if (getSchemaVersion(version) < 0) {
       current_status_ = DB_STATUS::DB_ERROR;
-      local_err_msg_ = DB_ERROR_PRETABLE;
+      local_err_msg_ = DB_ERROR_SCHEMAVER;
       return -1;
     }
 
-    ret = sqlite3_step(sql_stmt_);
-    current_status_ = DB_STATUS::DB_IDLE;
+    if (version == schema_version_) {
+      current_status_ = DB_STATUS::DB_IDLE;
+      return 0;
+    } else if (version > schema_version_) {
+      current_status_ = DB_STATUS::DB_ERROR;
+      local_err_msg_ = DB_ERROR_NEWSCHEMA;
+      return -1;
+    }
 
-    ret = ret != SQLITE_DONE ? -1 : 0;
-    if (ret < 0) {
+    if (execRawSQL("BEGIN TRANSACTION;") < 0) {
       current_status_ = DB_STATUS::DB_ERROR;
-      local_err_msg_ = DB_ERROR_CRTABLE;
+      local_err_msg_ = DB_ERROR_TRANSACTION;
+      return -1;
+    }
+
+    bool need_migrate_legacy(version == 0 && isLegacyTableExist());
+    std::string set_version(std::string{"PRAGMA user_version = "} +
+                            std::to_string(schema_version_) + ";");
+
+    for (; version < schema_version_; ++version) {
 #ifdef DEBUG
-      std::cerr << "SQL statement - Create Table \n"
-                << sqlCreateTable_ << std::endl;
+      std::cerr << "Upgrade schema from version " << version << std::endl;
 #endif
+      if (execRawSQL(sqlSchemaUpgrade[version]) < 0)
+        goto err_rollback;
+      if (version == 0 && need_migrate_legacy &&
+          execRawSQL(sqlMigrateLegacyTable) < 0)
+        goto err_rollback;
     }
 
-    sqlite3_finalize(sql_stmt_);
-    sql_stmt_ = nullptr;
-    return ret;
+    if (execRawSQL(set_version.c_str()) < 0 ||
+        execRawSQL("COMMIT TRANSACTION;") < 0)
+      goto err_rollback;
+
+    current_status_ = DB_STATUS::DB_IDLE;
+    return 0;
+
+  err_rollback:
+    (void)execRawSQL("ROLLBACK TRANSACTION;");
+    current_status_ = DB_STATUS::DB_ERROR;
+    local_err_msg_ = DB_ERROR_CRTABLE;
+    return -1;
   }
 
   /**
-   * executeDBOPeration - method to execute current registered database
-   *                      operation
-   * return:              0 OR -1
-   * # this routine will construct SQL statement for current registered
-   *   operation
-   * # for SQL_ASK,subsequent executeDBOperation() will works on the
-   *   same database transaction,until it completed or detected an error
+   * buildSQL - construct SQL statement
+   * @op:       SQL_ADD, SQL_DEL, SQL_ASK, SQL_ASK_MODS
+   * @filter_bits:  fields used in WHERE condition,they are linked
+   *                by AND,ignored by SQL_ADD
+   * return:    SQL statement in C++-style string
+   * # SQL_ADD inserts file record of an existed mod,UPSERT_MOD must
+   *   be executed before it.
+   * # SQL_DEL without file_path removes the mod,and its files are
+   *   removed by ON DELETE CASCADE.
    */
-  int mhwimm_db::executeDBOperation(void)
+  std::string mhwimm_db::buildSQL(SQL_OP op, uint8_t filter_bits) const
   {
-    current_status_ = DB_STATUS::DB_WORKING;
+    std::string sqlstmt;
+    const char *order_by("");
 
-    // no SQL operation specified.
-    if (current_op_ == SQL_OP::SQL_NOP) {
-      current_status_ = DB_STATUS::DB_IDLE;
-      return 0;
+    switch (op) {
+    case SQL_OP::SQL_ADD:
+      /* INSERT command no WHERE substatement */
+      sqlstmt = "INSERT INTO files (mod_id, file_path) "
+        "SELECT id, $key2 FROM mods WHERE name = $key1;";
+      return sqlstmt;
+    case SQL_OP::SQL_DEL:
+      if (!(filter_bits & 2)) {
+        sqlstmt = "DELETE FROM mods";
+        break;
+      }
+      sqlstmt = "DELETE FROM files WHERE file_path = $key2";
+      if (filter_bits & 5) {
+        sqlstmt += " AND mod_id IN (SELECT mods.id FROM mods";
+        filter_bits &= 5;
+        order_by = ")";
+        break;
+      }
+      return sqlstmt;
+    case SQL_OP::SQL_ASK:
+      sqlstmt = "SELECT mods.name, files.file_path, mods.install_date, files.entry_type "
+        "FROM files JOIN mods ON mods.id = files.mod_id";
+      order_by = " ORDER BY files.rowid";
+      break;
+    case SQL_OP::SQL_ASK_MODS:
+      sqlstmt = "SELECT mods.name, '', mods.install_date, 0 FROM mods";
+      filter_bits &= 5;
+      order_by = " ORDER BY mods.id";
+      break;
+    default:
+      return sqlstmt;
     }
 
-    int ret = 0;
-    // SQL statements
-    std::string SELECT(std::string{"SELECT * FROM "} + table_name_);
-    std::string INSERT(std::string{"INSERT INTO "} + table_name_);
-    std::string DELETE(std::string{"DELETE FROM "} + table_name_);
-
-#ifdef DEBUG
-    std::cerr << "Execute DB - SQL Statements \n"
-              << SELECT << "\n"
-              << INSERT << "\n"
-              << DELETE << std::endl;
-#endif
-
-    /**
-     * construct_stmt_with_where_cond - construct SQL statement with additional logical operator
-     * @sqlstmt:                        SQL statement in C++-style string
-     * @LINKER:                         SQL logical operator,it could be AND, OR
-     */
-    auto construct_stmt_with_where_cond = [&](std::string &sqlstmt, const char *LINKER)
-      ->void {
-
-      if (!record_buf_.is_mod_name_set &&
-          !record_buf_.is_file_path_set &&
-          !record_buf_.is_install_date_set)
-        return;
-
+    if (filter_bits) {
       sqlstmt += " WHERE ";
-
       bool need_linker(false);
 
-      if (record_buf_.is_mod_name_set) {
-        sqlstmt += " mod_name = $key1 ";
+      if (filter_bits & 1) {
+        sqlstmt += " mods.name = $key1 ";
         need_linker = true;
       }
-      if (record_buf_.is_file_path_set) {
+      if (filter_bits & 2) {
         if (need_linker)
-          sqlstmt += LINKER;
-        sqlstmt += " file_path = $key2 ";
+          sqlstmt += "AND";
+        sqlstmt += " files.file_path = $key2 ";
         need_linker = true;
       }
-      if (record_buf_.is_install_date_set) {
+      if (filter_bits & 4) {
         if (need_linker)
-          sqlstmt += LINKER;
-        sqlstmt += " install_date = $key3 ";
+          sqlstmt += "AND";
+        sqlstmt += " mods.install_date = $key3 ";
       }
+    }
+    sqlstmt += order_by;
+    return sqlstmt;
+  }
+
+  /* compileStmt - compile a statement into cache */
+  sqlite3_stmt *mhwimm_db::compileStmt(std::size_t slot, const char *sqlstmt)
+  {
+#ifdef DEBUG
+    std::cerr << "Compile SQL statement - \n"
+              << sqlstmt
+              << std::endl;
+#endif
+    if (sqlite3_prepare_v2(db_handler_, sqlstmt, -1, &stmt_cache_[slot],
+                           NULL) != SQLITE_OK) {
+#ifdef DEBUG
+      std::cerr << sqlite3_errmsg(db_handler_) << std::endl;
+#endif
+      sqlite3_finalize(stmt_cache_[slot]);
+      stmt_cache_[slot] = nullptr;
+      return nullptr;
+    }
+    ++stmt_cache_misses_;
+    return stmt_cache_[slot];
+  }
+
+  /* cachedStmt - get a compiled statement for SQL_OP from cache */
+  sqlite3_stmt *mhwimm_db::cachedStmt(SQL_OP op, uint8_t filter_bits)
+  {
+    std::size_t idx((static_cast<std::size_t>(op) << 3) | (filter_bits & 7));
+    if (idx >= stmt_op_slots_)
+      return nullptr;
+
+    if (stmt_cache_[idx]) {
+      ++stmt_cache_hits_;
+      /* the statement might be abandoned by last SQL_ASK */
+      sqlite3_reset(stmt_cache_[idx]);
+      return stmt_cache_[idx];
+    }
+    return compileStmt(idx, buildSQL(op, filter_bits).c_str());
+  }
+
+  /* cachedStmt - get a compiled statement of db_stmt_id from cache */
+  sqlite3_stmt *mhwimm_db::cachedStmt(db_stmt_id id)
+  {
+    std::size_t idx(static_cast<std::size_t>(id));
+    if (idx >= static_cast<std::size_t>(db_stmt_id::NR_STMT_ID))
+      return nullptr;
+
+    if (stmt_cache_[stmt_op_slots_ + idx]) {
+      ++stmt_cache_hits_;
+      sqlite3_reset(stmt_cache_[stmt_op_slots_ + idx]);
+      return stmt_cache_[stmt_op_slots_ + idx];
+    }
+    return compileStmt(stmt_op_slots_ + idx, sqlFixedStmts[idx]);
+  }
+
+  /* releaseStmt - statement is owned by cache,just reset it */
+  void mhwimm_db::releaseStmt(void)
+  {
+    if (sql_stmt_) {
+      sqlite3_reset(sql_stmt_);
+      sqlite3_clear_bindings(sql_stmt_);
+      sql_stmt_ = nullptr;
+    }
+    more_rows_indicator_ = false;
+  }
+
+  /* finalizeStmtCache - must be called before close database */
+  void mhwimm_db::finalizeStmtCache(void)
+  {
+    for (auto &stmt : stmt_cache_) {
+      sqlite3_finalize(stmt);
+      stmt = nullptr;
+    }
+  }
+
+  /**
+   * bindRecord - bind fields of @record_buf_ to the parameters of @stmt,
+   *              the parameters which not in the statement are skipped
+   * return:      SQLITE_OK OR sqlite3 error code
+   * # SQL_ASK overwrites @record_buf_ with each row,thus let sqlite3
+   *   keeps its own copy.
+   */
+  int mhwimm_db::bindRecord(sqlite3_stmt *stmt)
+  {
+    int ret(SQLITE_OK);
+    const char *key_mod_name = record_buf_.mod_name.c_str();
+    const char *key_file_path = record_buf_.file_path.c_str();
+    const char *key_ins_date = record_buf_.install_date.c_str();
+#ifdef DEBUG
+    std::cerr << "SQL binds - \n"
+              << key_mod_name
+              << "\n"
+              << key_file_path
+              << "\n"
+              << key_ins_date
+              << std::endl;
+#endif
+    int key_idx(0);
 
-    };
+    key_idx = sqlite3_bind_parameter_index(stmt, "$key1");
+    if (key_idx)
+      ret |= sqlite3_bind_text(stmt, key_idx, key_mod_name, -1, SQLITE_TRANSIENT);
 
-    auto construct_select = [&](const char *LINKER) -> void {
-      construct_stmt_with_where_cond(SELECT, LINKER);
-    };
-    auto construct_delete = [&](const char *LINKER) -> void {
-      construct_stmt_with_where_cond(DELETE, LINKER);
-    };
+    key_idx = sqlite3_bind_parameter_index(stmt, "$key2");
+    if (key_idx)
+      ret |= sqlite3_bind_text(stmt, key_idx, key_file_path, -1, SQLITE_TRANSIENT);
 
-    /* INSERT command no WHERE substatement */
-    auto construct_insert = [&](void) -> void {
-      INSERT += " (mod_name, file_path, install_date) VALUES ($key1, $key2, $key3);";
-    };
+    key_idx = sqlite3_bind_parameter_index(stmt, "$key3");
+    if (key_idx)
+      ret |= sqlite3_bind_text(stmt, key_idx, key_ins_date, -1, SQLITE_TRANSIENT);
+
+    return ret;
+  }
+
+  /**
+   * executeDBOPeration - method to execute current registered database
+   *                      operation
+   * return:              0 OR -1
+   * # the compiled statement for current registered operation is
+   *   fetched from cache,it will be compiled only when first used
+   * # for SQL_ASK,subsequent executeDBOperation() will works on the
+   *   same database transaction,until it completed or detected an error
+   */
+  int mhwimm_db::executeDBOperation(void)
+  {
+    current_status_ = DB_STATUS::DB_WORKING;
+
+    // no SQL operation specified.
+    if (current_op_ == SQL_OP::SQL_NOP) {
+      current_status_ = DB_STATUS::DB_IDLE;
+      return 0;
+    }
+
+    int ret = 0;
 
     /* if we are still in SQL_ASK,then continue from last operation */
     if (more_rows_indicator_)
@@ -185,34 +495,25 @@ namespace mhwimm_db_ns {
         local_err_msg_ = DB_ERROR_LACKVS;
         return -1;
       }
-      construct_insert();
+      // record of the mod must exist before insert file record
+      sql_stmt_ = cachedStmt(db_stmt_id::UPSERT_MOD);
+      if (!sql_stmt_ || bindRecord(sql_stmt_) != SQLITE_OK ||
+          sqlite3_step(sql_stmt_) != SQLITE_DONE) {
 #ifdef DEBUG
-      std::cerr << "INSERT after construct - \n"
-                << INSERT
-                << std::endl;
+        std::cerr << sqlite3_errmsg(db_handler_) << std::endl;
 #endif
-      ret = sqlite3_prepare_v2(db_handler_, INSERT.c_str(), -1, &sql_stmt_,
-                               NULL);
+        current_status_ = DB_STATUS::DB_ERROR;
+        local_err_msg_ = DB_ERROR_FAILEDAD;
+        releaseStmt();
+        return -1;
+      }
+      releaseStmt();
+      sql_stmt_ = cachedStmt(current_op_, filterBits());
       break;
     case SQL_OP::SQL_DEL:
-      construct_delete("AND");
-#ifdef DEBUG
-      std::cerr << "DELETE after construct - \n"
-                << DELETE
-                << std::endl;
-#endif
-      ret = sqlite3_prepare_v2(db_handler_, DELETE.c_str(), -1, &sql_stmt_,
-                               NULL);
-      break;
     case SQL_OP::SQL_ASK:
-      construct_select("AND");
-#ifdef DEBUG
-      std::cerr << "SELECT after construct - \n"
-                << SELECT
-                << std::endl;
-#endif
-      ret = sqlite3_prepare_v2(db_handler_, SELECT.c_str(), -1, &sql_stmt_,
-                               NULL);
+    case SQL_OP::SQL_ASK_MODS:
+      sql_stmt_ = cachedStmt(current_op_, filterBits());
       break;
     default:
       current_status_ = DB_STATUS::DB_ERROR;
@@ -220,62 +521,15 @@ namespace mhwimm_db_ns {
       return -1;
     }
 
-    if (ret != SQLITE_OK) {
-#ifdef DEBUG
-      std::cerr << sqlite3_errmsg(db_handler_) << std::endl;
-#endif
+    if (!sql_stmt_) {
       current_status_ = DB_STATUS::DB_ERROR;
       local_err_msg_ = DB_ERROR_PRESQL;
       return -1;
     }
 
-    ret = SQLITE_OK;
     // the sqlite_stmt object have been prepared.
     // now we can bind parameters.
-    if (current_op_ == SQL_OP::SQL_ADD) {
-#ifdef DEBUG
-      std::cerr << "INSERT binds - \n"
-                << record_buf_.mod_name
-                << "\n"
-                << record_buf_.file_path
-                << "\n"
-                << record_buf_.install_date
-                << std::endl;
-#endif
-      ret |= sqlite3_bind_text(sql_stmt_, 1, record_buf_.mod_name.c_str(), -1,
-                               SQLITE_STATIC);
-      ret |= sqlite3_bind_text(sql_stmt_, 2, record_buf_.file_path.c_str(), -1,
-                               SQLITE_STATIC);
-      ret |= sqlite3_bind_text(sql_stmt_, 3, record_buf_.install_date.c_str(), -1,
-                               SQLITE_STATIC);
-    } else if (record_buf_.is_mod_name_set) {
-      const char *key_mod_name = record_buf_.mod_name.c_str();
-      const char *key_file_path = record_buf_.file_path.c_str();
-      const char *key_ins_date = record_buf_.install_date.c_str();
-#ifdef DEBUG
-      std::cerr << "SELECT/DELETE binds - \n"
-                << key_mod_name
-                << "\n"
-                << key_file_path
-                << "\n"
-                << key_ins_date
-                << std::endl;
-#endif
-      uint8_t key_idx(0);
-
-      key_idx = sqlite3_bind_parameter_index(sql_stmt_, "$key1");
-      if (key_idx)
-        ret |= sqlite3_bind_text(sql_stmt_, key_idx, key_mod_name, -1, SQLITE_STATIC);
-
-      key_idx = sqlite3_bind_parameter_index(sql_stmt_, "$key2");
-      if (key_idx)
-        ret |= sqlite3_bind_text(sql_stmt_, key_idx, key_file_path, -1, SQLITE_STATIC);
-
-      key_idx = sqlite3_bind_parameter_index(sql_stmt_, "$key3");
-      if (key_idx)
-        ret |= sqlite3_bind_text(sql_stmt_, key_idx, key_ins_date, -1, SQLITE_STATIC);
-    }
-
+    ret = bindRecord(sql_stmt_);
     if (ret != SQLITE_OK) {
       current_status_ = DB_STATUS::DB_ERROR;
       local_err_msg_ = DB_ERROR_BINDV;
@@ -283,7 +537,7 @@ namespace mhwimm_db_ns {
 #ifdef DEBUG
         std::cerr << sqlite3_errmsg(db_handler_) << std::endl;
 #endif
-      goto finalize_out;
+      goto release_out;
     }
     
     // now we can evaluate sql statement.
@@ -298,20 +552,27 @@ namespace mhwimm_db_ns {
 #ifdef DEBUG
         std::cerr << sqlite3_errmsg(db_handler_) << std::endl;
 #endif
-        goto finalize_out;
+        goto release_out;
       }
       break;
     case SQL_OP::SQL_ASK:
+    case SQL_OP::SQL_ASK_MODS:
       goto more_row;
+    default:
+      // SQL_UPDATE is applied by updateModFilesList(),never by a single
+      // statement.
+      current_status_ = DB_STATUS::DB_ERROR;
+      local_err_msg_ = DB_ERROR_BADOP;
+      ret = -1;
+      goto release_out;
     }
 
   complete_executing:
     current_status_ = DB_STATUS::DB_IDLE;
     ret = 0;
 
-  finalize_out:
-    sqlite3_finalize(sql_stmt_);
-    sql_stmt_ = nullptr;
+  release_out:
+    releaseStmt();
     return ret;
 
   more_row:
@@ -322,6 +583,7 @@ namespace mhwimm_db_ns {
       record_buf_.mod_name = reinterpret_cast<const char *>(sqlite3_column_text(sql_stmt_, 0));
       record_buf_.file_path = reinterpret_cast<const char *>(sqlite3_column_text(sql_stmt_, 1));
       record_buf_.install_date = reinterpret_cast<const char *>(sqlite3_column_text(sql_stmt_, 2));
+      record_buf_.entry_type = static_cast<db_entry_type>(sqlite3_column_int(sql_stmt_, 3));
 #ifdef DEBUG
       std::cerr << "SELECT returned - "
                 << record_buf_.mod_name << " "
@@ -338,8 +600,656 @@ namespace mhwimm_db_ns {
 #ifdef DEBUG
         std::cerr << sqlite3_errmsg(db_handler_) << std::endl;
 #endif
-      goto finalize_out;
+      goto release_out;
+    }
+  }
+
+  /* execRawSQL - execute @sql which returns no result */
+  int mhwimm_db::execRawSQL(const char *sql)
+  {
+    int ret = sqlite3_exec(db_handler_, sql, NULL, NULL, NULL);
+    if (ret != SQLITE_OK) {
+#ifdef DEBUG
+      std::cerr << sql << " - " << sqlite3_errmsg(db_handler_) << std::endl;
+#endif
+      return -1;
+    }
+    return 0;
+  }
+
+  /**
+   * addModFilesList - insert all paths in @directory_list and
+   *                   @regular_file_list as records of @mod_name
+   * return:           0 OR -1
+   * # the mod is recorded in mods table,and then its files are
+   *   recorded in files table.directories are inserted at first,
+   *   this is the same order as the mod been installed.
+   * # content_hash is NULL for directories,and for regular files if
+   *   @content_hash_list is empty.
+   */
+  int mhwimm_db::addModFilesList(const std::string &mod_name, const std::string &install_date,
+                                 const std::string &source,
+                                 const mhwimm_path_list_ns::path_list &directory_list,
+                                 const mhwimm_path_list_ns::path_list &regular_file_list,
+                                 const mhwimm_path_list_ns::path_list &content_hash_list,
+                                 const std::vector<db_file_meta> &file_meta_list,
+                                 const mhwimm_path_list_ns::path_list &deployed_hash_list,
+                                 const std::function<bool(void)> &before_commit)
+  {
+    current_status_ = DB_STATUS::DB_WORKING;
+    if (!db_handler_) {
+      current_status_ = DB_STATUS::DB_ERROR;
+      local_err_msg_ = DB_ERROR_BADHANDLER;
+      return -1;
+    }
+
+    sqlite3_stmt *insert_stmt(nullptr);
+
+    if (execRawSQL("BEGIN TRANSACTION;") < 0) {
+      current_status_ = DB_STATUS::DB_ERROR;
+      local_err_msg_ = DB_ERROR_TRANSACTION;
+      return -1;
+    }
+
+    int ret(SQLITE_OK);
+    sqlite3_int64 mod_id(0);
+
+    /* step1 : record the mod,file_count is known at there */
+    insert_stmt = cachedStmt(db_stmt_id::ADD_MOD);
+    if (!insert_stmt) {
+      local_err_msg_ = DB_ERROR_PRESQL;
+      goto err_rollback;
+    }
+    ret = sqlite3_bind_text(insert_stmt, 1, mod_name.c_str(), -1, SQLITE_STATIC);
+    ret |= sqlite3_bind_text(insert_stmt, 2, install_date.c_str(), -1, SQLITE_STATIC);
+    ret |= sqlite3_bind_int64(insert_stmt, 3, directory_list.size() + regular_file_list.size());
+    ret |= source.empty() ? sqlite3_bind_null(insert_stmt, 4) :
+      sqlite3_bind_text(insert_stmt, 4, source.c_str(), -1, SQLITE_STATIC);
+    if (ret != SQLITE_OK) {
+      local_err_msg_ = DB_ERROR_BINDV;
+      goto err_rollback;
+    }
+    if (sqlite3_step(insert_stmt) != SQLITE_DONE) {
+      local_err_msg_ = DB_ERROR_FAILEDAD;
+      goto err_rollback;
+    }
+    mod_id = sqlite3_last_insert_rowid(db_handler_);
+    sqlite3_reset(insert_stmt);
+    sqlite3_clear_bindings(insert_stmt);
+
+    /* step2 : record files,mod id is same for each record */
+    insert_stmt = nullptr;
+    if (insertModFiles(mod_id, directory_list, regular_file_list, content_hash_list) < 0)
+      goto err_rollback;
+
+    /* step3 : the caller decides whether the records are wanted */
+    if (before_commit && !before_commit()) {
+      local_err_msg_ = DB_ERROR_ABORTED;
+      goto err_rollback;
+    }
+
+    /* step4 : metadata is known after the files deployed */
+    if (setFileMeta(file_meta_list, deployed_hash_list) < 0)
+      goto err_rollback;
+
+    if (execRawSQL("COMMIT TRANSACTION;") < 0) {
+      local_err_msg_ = DB_ERROR_TRANSACTION;
+      goto err_rollback;
+    }
+
+    current_status_ = DB_STATUS::DB_IDLE;
+    return 0;
+
+  err_rollback:
+#ifdef DEBUG
+    std::cerr << sqlite3_errmsg(db_handler_) << std::endl;
+#endif
+    if (insert_stmt) {
+      sqlite3_reset(insert_stmt);
+      sqlite3_clear_bindings(insert_stmt);
+    }
+    (void)execRawSQL("ROLLBACK TRANSACTION;");
+    current_status_ = DB_STATUS::DB_ERROR;
+    return -1;
+  }
+
+  /**
+   * insertModFiles - insert file records of the mod @mod_id,the caller
+   *                  must be in a transaction
+   * return:          0 OR -1,@local_err_msg_ is set if failed
+   * # one INSERT statement is reused for every record,content_hash
+   *   is NULL for directories,and for regular files if
+   *   @content_hash_list is empty.
+   */
+  int mhwimm_db::insertModFiles(int64_t mod_id,
+                                const mhwimm_path_list_ns::path_list &directory_list,
+                                const mhwimm_path_list_ns::path_list &regular_file_list,
+                                const mhwimm_path_list_ns::path_list &content_hash_list)
+  {
+    inserted_rowids_.clear();
+    inserted_rowids_.reserve(regular_file_list.size());
+
+    sqlite3_stmt *insert_stmt(cachedStmt(db_stmt_id::ADD_MOD_FILE));
+    if (!insert_stmt) {
+      local_err_msg_ = DB_ERROR_PRESQL;
+      return -1;
+    }
+    if (sqlite3_bind_int64(insert_stmt, 1, mod_id) != SQLITE_OK) {
+      local_err_msg_ = DB_ERROR_BINDV;
+      goto err_reset;
+    }
+
+    for (const auto *plist : { &directory_list, &regular_file_list }) {
+      db_entry_type type(plist == &directory_list ? db_entry_type::ENTRY_DIRECTORY :
+                         db_entry_type::ENTRY_REGULAR);
+      if (sqlite3_bind_int(insert_stmt, 3, static_cast<int>(type)) != SQLITE_OK) {
+        local_err_msg_ = DB_ERROR_BINDV;
+        goto err_reset;
+      }
+      auto hash(content_hash_list.cbegin());
+      for (const auto &path : *plist) {
+#ifdef DEBUG
+        std::cerr << "SQL_ADD - path - " << path << std::endl;
+#endif
+        int ret(sqlite3_bind_text(insert_stmt, 2, path.data(), path.length(), SQLITE_STATIC));
+        if (plist == &regular_file_list && hash != content_hash_list.cend()) {
+          ret |= sqlite3_bind_text(insert_stmt, 4, (*hash).data(), (*hash).length(), SQLITE_STATIC);
+          ++hash;
+        } else
+          ret |= sqlite3_bind_null(insert_stmt, 4);
+        if (ret != SQLITE_OK) {
+          local_err_msg_ = DB_ERROR_BINDV;
+          goto err_reset;
+        }
+        if (sqlite3_step(insert_stmt) != SQLITE_DONE) {
+          local_err_msg_ = DB_ERROR_FAILEDAD;
+          goto err_reset;
+        }
+        if (plist == &regular_file_list)
+          inserted_rowids_.push_back(sqlite3_last_insert_rowid(db_handler_));
+        sqlite3_reset(insert_stmt);
+      }
+    }
+    sqlite3_clear_bindings(insert_stmt);
+    return 0;
+
+  err_reset:
+    sqlite3_reset(insert_stmt);
+    sqlite3_clear_bindings(insert_stmt);
+    return -1;
+  }
+
+  /**
+   * setFileMeta - set @metas and @hashes to the regular files inserted
+   *               by last insertModFiles() in the same order,the caller
+   *               must be in a transaction
+   * return:       0 OR -1,@local_err_msg_ is set if failed
+   * # nothing to do if @metas does not match the inserted files,e.g.
+   *   it is empty because the metadata is unknown.
+   * # the content hash is kept if @hashes does not match,or the hash
+   *   of the file is empty.
+   */
+  int mhwimm_db::setFileMeta(const std::vector<db_file_meta> &metas,
+                             const mhwimm_path_list_ns::path_list &hashes)
+  {
+    if (metas.size() != inserted_rowids_.size() || metas.empty())
+      return 0;
+    bool with_hash(hashes.size() == metas.size());
+
+    sqlite3_stmt *stmt(cachedStmt(db_stmt_id::SET_FILE_META));
+    if (!stmt) {
+      local_err_msg_ = DB_ERROR_PRESQL;
+      return -1;
+    }
+
+    for (std::size_t i(0); i < metas.size(); ++i) {
+      const auto &m(metas[i]);
+      int ret(sqlite3_bind_int64(stmt, 1, inserted_rowids_[i]));
+      // the file could not be stated after deployed
+      if (!m.inode)
+        ret |= sqlite3_bind_null(stmt, 2) | sqlite3_bind_null(stmt, 3) |
+          sqlite3_bind_null(stmt, 4) | sqlite3_bind_null(stmt, 5);
+      else
+        ret |= sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(m.inode)) |
+          sqlite3_bind_int64(stmt, 3, static_cast<sqlite3_int64>(m.size)) |
+          sqlite3_bind_int64(stmt, 4, m.mtime_ns) |
+          sqlite3_bind_int64(stmt, 5, m.nlink);
+      if (with_hash && !hashes[i].empty())
+        ret |= sqlite3_bind_text(stmt, 6, hashes[i].data(), hashes[i].length(), SQLITE_STATIC);
+      else
+        ret |= sqlite3_bind_null(stmt, 6);
+      if (ret != SQLITE_OK) {
+        local_err_msg_ = DB_ERROR_BINDV;
+        goto err_reset;
+      }
+      if (sqlite3_step(stmt) != SQLITE_DONE) {
+        local_err_msg_ = DB_ERROR_FAILEDAD;
+        goto err_reset;
+      }
+      sqlite3_reset(stmt);
+    }
+    sqlite3_clear_bindings(stmt);
+    return 0;
+
+  err_reset:
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    return -1;
+  }
+
+  int mhwimm_db::setDeployedHashes(const std::string &mod_name,
+                                   const mhwimm_path_list_ns::path_list &regular_file_list,
+                                   const mhwimm_path_list_ns::path_list &deployed_hash_list)
+  {
+    current_status_ = DB_STATUS::DB_WORKING;
+    if (!db_handler_) {
+      current_status_ = DB_STATUS::DB_ERROR;
+      local_err_msg_ = DB_ERROR_BADHANDLER;
+      return -1;
+    }
+    if (deployed_hash_list.size() != regular_file_list.size()) {
+      current_status_ = DB_STATUS::DB_ERROR;
+      local_err_msg_ = DB_ERROR_LACKVS;
+      return -1;
+    }
+
+    if (execRawSQL("BEGIN TRANSACTION;") < 0) {
+      current_status_ = DB_STATUS::DB_ERROR;
+      local_err_msg_ = DB_ERROR_TRANSACTION;
+      return -1;
+    }
+
+    sqlite3_stmt *stmt(nullptr);
+    sqlite3_int64 mod_id(0);
+    int ret(SQLITE_OK);
+
+    /* step1 : look up the mod */
+    stmt = cachedStmt(db_stmt_id::ASK_MOD_ID);
+    if (!stmt) {
+      local_err_msg_ = DB_ERROR_PRESQL;
+      goto err_rollback;
+    }
+    if (sqlite3_bind_text(stmt, 1, mod_name.c_str(), -1, SQLITE_STATIC) != SQLITE_OK) {
+      local_err_msg_ = DB_ERROR_BINDV;
+      goto err_rollback;
+    }
+    if ((ret = sqlite3_step(stmt)) != SQLITE_ROW) {
+      local_err_msg_ = ret == SQLITE_DONE ? DB_ERROR_NOMOD : DB_ERROR_FAILEDASK;
+      goto err_rollback;
+    }
+    mod_id = sqlite3_column_int64(stmt, 0);
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+
+    /* step2 : the hashes,one probe of files_owner_idx for each */
+    stmt = cachedStmt(db_stmt_id::SET_FILE_HASH);
+    if (!stmt) {
+      local_err_msg_ = DB_ERROR_PRESQL;
+      goto err_rollback;
+    }
+    if (sqlite3_bind_int64(stmt, 1, mod_id) != SQLITE_OK) {
+      local_err_msg_ = DB_ERROR_BINDV;
+      goto err_rollback;
+    }
+    for (std::size_t i(0); i < regular_file_list.size(); ++i) {
+      std::string_view path(regular_file_list[i]), hash(deployed_hash_list[i]);
+      if (hash.empty())
+        continue;
+      if (sqlite3_bind_text(stmt, 2, path.data(), path.length(), SQLITE_STATIC) != SQLITE_OK ||
+          sqlite3_bind_text(stmt, 3, hash.data(), hash.length(), SQLITE_STATIC) != SQLITE_OK) {
+        local_err_msg_ = DB_ERROR_BINDV;
+        goto err_rollback;
+      }
+      if (sqlite3_step(stmt) != SQLITE_DONE) {
+        local_err_msg_ = DB_ERROR_FAILEDAD;
+        goto err_rollback;
+      }
+      sqlite3_reset(stmt);
+    }
+    sqlite3_clear_bindings(stmt);
+
+    if (execRawSQL("COMMIT TRANSACTION;") < 0) {
+      local_err_msg_ = DB_ERROR_TRANSACTION;
+      stmt = nullptr;
+      goto err_rollback;
+    }
+
+    current_status_ = DB_STATUS::DB_IDLE;
+    return 0;
+
+  err_rollback:
+#ifdef DEBUG
+    std::cerr << sqlite3_errmsg(db_handler_) << std::endl;
+#endif
+    if (stmt) {
+      sqlite3_reset(stmt);
+      sqlite3_clear_bindings(stmt);
+    }
+    (void)execRawSQL("ROLLBACK TRANSACTION;");
+    current_status_ = DB_STATUS::DB_ERROR;
+    return -1;
+  }
+
+  /**
+   * updateModFilesList - remove the paths in @removed_list,and then
+   *                      insert the added paths as addModFilesList()
+   *                      does,file_count is adjusted by the number of
+   *                      rows really changed
+   * return:              0 OR -1
+   */
+  int mhwimm_db::updateModFilesList(const std::string &mod_name, const std::string &install_date,
+                                    const std::string &source,
+                                    const mhwimm_path_list_ns::path_list &removed_list,
+                                    const mhwimm_path_list_ns::path_list &directory_list,
+                                    const mhwimm_path_list_ns::path_list &regular_file_list,
+                                    const mhwimm_path_list_ns::path_list &content_hash_list,
+                                    const std::vector<db_file_meta> &file_meta_list,
+                                    const mhwimm_path_list_ns::path_list &deployed_hash_list)
+  {
+    current_status_ = DB_STATUS::DB_WORKING;
+    if (!db_handler_) {
+      current_status_ = DB_STATUS::DB_ERROR;
+      local_err_msg_ = DB_ERROR_BADHANDLER;
+      return -1;
+    }
+
+    if (execRawSQL("BEGIN TRANSACTION;") < 0) {
+      current_status_ = DB_STATUS::DB_ERROR;
+      local_err_msg_ = DB_ERROR_TRANSACTION;
+      return -1;
+    }
+
+    sqlite3_stmt *stmt(nullptr);
+    sqlite3_int64 mod_id(0);
+    sqlite3_int64 nremoved(0);
+    int ret(SQLITE_OK);
+
+    /* step1 : look up the mod */
+    stmt = cachedStmt(db_stmt_id::ASK_MOD_ID);
+    if (!stmt) {
+      local_err_msg_ = DB_ERROR_PRESQL;
+      goto err_rollback;
+    }
+    if (sqlite3_bind_text(stmt, 1, mod_name.c_str(), -1, SQLITE_STATIC) != SQLITE_OK) {
+      local_err_msg_ = DB_ERROR_BINDV;
+      goto err_rollback;
+    }
+    if ((ret = sqlite3_step(stmt)) != SQLITE_ROW) {
+      local_err_msg_ = ret == SQLITE_DONE ? DB_ERROR_NOMOD : DB_ERROR_FAILEDASK;
+      goto err_rollback;
+    }
+    mod_id = sqlite3_column_int64(stmt, 0);
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+
+    /* step2 : remove the paths no longer in the mod,or been replaced */
+    stmt = cachedStmt(db_stmt_id::DEL_MOD_FILE);
+    if (!stmt) {
+      local_err_msg_ = DB_ERROR_PRESQL;
+      goto err_rollback;
+    }
+    if (sqlite3_bind_int64(stmt, 1, mod_id) != SQLITE_OK) {
+      local_err_msg_ = DB_ERROR_BINDV;
+      goto err_rollback;
+    }
+    for (const auto &path : removed_list) {
+#ifdef DEBUG
+      std::cerr << "SQL_UPDATE - remove path - " << path << std::endl;
+#endif
+      if (sqlite3_bind_text(stmt, 2, path.data(), path.length(), SQLITE_STATIC) != SQLITE_OK) {
+        local_err_msg_ = DB_ERROR_BINDV;
+        goto err_rollback;
+      }
+      if (sqlite3_step(stmt) != SQLITE_DONE) {
+        local_err_msg_ = DB_ERROR_FAILEDAD;
+        goto err_rollback;
+      }
+      nremoved += sqlite3_changes(db_handler_);
+      sqlite3_reset(stmt);
+    }
+    sqlite3_clear_bindings(stmt);
+
+    /* step3 : record the added paths */
+    stmt = nullptr;
+    if (insertModFiles(mod_id, directory_list, regular_file_list, content_hash_list) < 0 ||
+        setFileMeta(file_meta_list, deployed_hash_list) < 0)
+      goto err_rollback;
+
+    /* step4 : the mod itself */
+    stmt = cachedStmt(db_stmt_id::UPDATE_MOD);
+    if (!stmt) {
+      local_err_msg_ = DB_ERROR_PRESQL;
+      goto err_rollback;
+    }
+    ret = sqlite3_bind_int64(stmt, 1, mod_id);
+    ret |= sqlite3_bind_text(stmt, 2, install_date.c_str(), -1, SQLITE_STATIC);
+    ret |= sqlite3_bind_int64(stmt, 3, static_cast<sqlite3_int64>(directory_list.size() +
+                                                                  regular_file_list.size()) -
+                              nremoved);
+    ret |= source.empty() ? sqlite3_bind_null(stmt, 4) :
+      sqlite3_bind_text(stmt, 4, source.c_str(), -1, SQLITE_STATIC);
+    if (ret != SQLITE_OK) {
+      local_err_msg_ = DB_ERROR_BINDV;
+      goto err_rollback;
+    }
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+      local_err_msg_ = DB_ERROR_FAILEDAD;
+      goto err_rollback;
+    }
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    stmt = nullptr;
+
+    if (execRawSQL("COMMIT TRANSACTION;") < 0) {
+      local_err_msg_ = DB_ERROR_TRANSACTION;
+      goto err_rollback;
+    }
+
+    current_status_ = DB_STATUS::DB_IDLE;
+    return 0;
+
+  err_rollback:
+#ifdef DEBUG
+    std::cerr << sqlite3_errmsg(db_handler_) << std::endl;
+#endif
+    if (stmt) {
+      sqlite3_reset(stmt);
+      sqlite3_clear_bindings(stmt);
+    }
+    (void)execRawSQL("ROLLBACK TRANSACTION;");
+    current_status_ = DB_STATUS::DB_ERROR;
+    return -1;
+  }
+
+  /**
+   * findConflicts - load @candidates into temporary table,and find out
+   *                 the owners of them
+   * return:         0 OR -1
+   * # temporary table is private to this connection,it is created at
+   *   the first time to use,and emptied before each query.
+   */
+  int mhwimm_db::findConflicts(const mhwimm_path_list_ns::path_list &candidates,
+                               std::list<db_conflict> &conflicts)
+  {
+    current_status_ = DB_STATUS::DB_WORKING;
+    if (!db_handler_) {
+      current_status_ = DB_STATUS::DB_ERROR;
+      local_err_msg_ = DB_ERROR_BADHANDLER;
+      return -1;
+    }
+
+    // statements refer to the temporary table can only be compiled
+    // after the table exists.
+    if (execRawSQL("CREATE TEMP TABLE IF NOT EXISTS candidate_paths ("
+                   "file_path TEXT PRIMARY KEY) WITHOUT ROWID;") < 0) {
+      current_status_ = DB_STATUS::DB_ERROR;
+      local_err_msg_ = DB_ERROR_TEMPTABLE;
+      return -1;
     }
+
+    if (execRawSQL("BEGIN TRANSACTION;") < 0) {
+      current_status_ = DB_STATUS::DB_ERROR;
+      local_err_msg_ = DB_ERROR_TRANSACTION;
+      return -1;
+    }
+
+    sqlite3_stmt *stmt(nullptr);
+    int ret(SQLITE_OK);
+
+    if (execRawSQL("DELETE FROM temp.candidate_paths;") < 0) {
+      local_err_msg_ = DB_ERROR_TEMPTABLE;
+      goto err_rollback;
+    }
+
+    /* step1 : load candidates */
+    stmt = cachedStmt(db_stmt_id::ADD_CANDIDATE);
+    if (!stmt) {
+      local_err_msg_ = DB_ERROR_PRESQL;
+      goto err_rollback;
+    }
+    for (const auto &path : candidates) {
+      if (sqlite3_bind_text(stmt, 1, path.data(), path.length(),
+                            SQLITE_STATIC) != SQLITE_OK) {
+        local_err_msg_ = DB_ERROR_BINDV;
+        goto err_rollback;
+      }
+      if (sqlite3_step(stmt) != SQLITE_DONE) {
+        local_err_msg_ = DB_ERROR_FAILEDAD;
+        goto err_rollback;
+      }
+      sqlite3_reset(stmt);
+    }
+    sqlite3_clear_bindings(stmt);
+
+    /* step2 : join against recorded files */
+    stmt = cachedStmt(db_stmt_id::ASK_CONFLICTS);
+    if (!stmt) {
+      local_err_msg_ = DB_ERROR_PRESQL;
+      goto err_rollback;
+    }
+    while ((ret = sqlite3_step(stmt)) == SQLITE_ROW) {
+      conflicts.push_back(db_conflict {
+          .owner = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)),
+          .file_path = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1)),
+        });
+    }
+    if (ret != SQLITE_DONE) {
+      local_err_msg_ = DB_ERROR_FAILEDASK;
+      goto err_rollback;
+    }
+    sqlite3_reset(stmt);
+
+    // nothing been modified in database,but the temporary table
+    // have not to keep the candidates.
+    if (execRawSQL("DELETE FROM temp.candidate_paths;") < 0 ||
+        execRawSQL("COMMIT TRANSACTION;") < 0) {
+      local_err_msg_ = DB_ERROR_TRANSACTION;
+      goto err_rollback;
+    }
+
+    current_status_ = DB_STATUS::DB_IDLE;
+    return 0;
+
+  err_rollback:
+#ifdef DEBUG
+    std::cerr << sqlite3_errmsg(db_handler_) << std::endl;
+#endif
+    if (stmt) {
+      sqlite3_reset(stmt);
+      sqlite3_clear_bindings(stmt);
+    }
+    (void)execRawSQL("ROLLBACK TRANSACTION;");
+    current_status_ = DB_STATUS::DB_ERROR;
+    return -1;
+  }
+
+  int mhwimm_db::getContentHashes(mhwimm_path_list_ns::path_list &hashes)
+  {
+    current_status_ = DB_STATUS::DB_WORKING;
+    if (!db_handler_) {
+      current_status_ = DB_STATUS::DB_ERROR;
+      local_err_msg_ = DB_ERROR_BADHANDLER;
+      return -1;
+    }
+
+    sqlite3_stmt *stmt(cachedStmt(db_stmt_id::ASK_CONTENT_HASHES));
+    if (!stmt) {
+      current_status_ = DB_STATUS::DB_ERROR;
+      local_err_msg_ = DB_ERROR_PRESQL;
+      return -1;
+    }
+
+    int ret(SQLITE_OK);
+    while ((ret = sqlite3_step(stmt)) == SQLITE_ROW)
+      hashes.push_back(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)));
+    sqlite3_reset(stmt);
+    if (ret != SQLITE_DONE) {
+      current_status_ = DB_STATUS::DB_ERROR;
+      local_err_msg_ = DB_ERROR_FAILEDASK;
+      return -1;
+    }
+
+    current_status_ = DB_STATUS::DB_IDLE;
+    return 0;
+  }
+
+  int mhwimm_db::getFileMeta(const std::string &mod_name,
+                             mhwimm_path_list_ns::path_list &owners,
+                             mhwimm_path_list_ns::path_list &paths,
+                             std::vector<db_file_meta> &metas,
+                             mhwimm_path_list_ns::path_list &hashes,
+                             mhwimm_path_list_ns::path_list &sources)
+  {
+    current_status_ = DB_STATUS::DB_WORKING;
+    if (!db_handler_) {
+      current_status_ = DB_STATUS::DB_ERROR;
+      local_err_msg_ = DB_ERROR_BADHANDLER;
+      return -1;
+    }
+
+    sqlite3_stmt *stmt(cachedStmt(db_stmt_id::ASK_FILE_META));
+    if (!stmt) {
+      current_status_ = DB_STATUS::DB_ERROR;
+      local_err_msg_ = DB_ERROR_PRESQL;
+      return -1;
+    }
+
+    int ret(mod_name.empty() ? sqlite3_bind_null(stmt, 1) :
+            sqlite3_bind_text(stmt, 1, mod_name.c_str(), -1, SQLITE_STATIC));
+    if (ret != SQLITE_OK) {
+      sqlite3_reset(stmt);
+      current_status_ = DB_STATUS::DB_ERROR;
+      local_err_msg_ = DB_ERROR_BINDV;
+      return -1;
+    }
+
+    while ((ret = sqlite3_step(stmt)) == SQLITE_ROW) {
+      owners.push_back(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)));
+      paths.push_back(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1)),
+                      mhwimm_path_list_ns::path_type::PATH_REGULAR);
+      // NULL is read as 0
+      metas.push_back(db_file_meta {
+          .inode = static_cast<uint64_t>(sqlite3_column_int64(stmt, 2)),
+          .size = static_cast<uint64_t>(sqlite3_column_int64(stmt, 3)),
+          .mtime_ns = sqlite3_column_int64(stmt, 4),
+          .nlink = static_cast<uint32_t>(sqlite3_column_int64(stmt, 5)),
+        });
+      // NULL is read as empty string
+      const unsigned char *text(sqlite3_column_text(stmt, 6));
+      hashes.push_back(text ? reinterpret_cast<const char *>(text) : "");
+      text = sqlite3_column_text(stmt, 7);
+      sources.push_back(text ? reinterpret_cast<const char *>(text) : "");
+    }
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    if (ret != SQLITE_DONE) {
+      current_status_ = DB_STATUS::DB_ERROR;
+      local_err_msg_ = DB_ERROR_FAILEDASK;
+      return -1;
+    }
+
+    current_status_ = DB_STATUS::DB_IDLE;
+    return 0;
   }
 
 }
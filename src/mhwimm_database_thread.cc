@@ -1,10 +1,11 @@
 /**
  * Database Thread Worker
- * The synchronizatioon between DB and Executor :
- *   DB thread wait until the value becomes odd
- *   Executor thread wait until the value becomes even
- *   - In this way,can let Executor process at first,and
- *     DB thread at the second.
+ * The communication between DB and Executor :
+ *   Executor queues requests into @exedb_queue
+ *   DB thread processes them in order,and fulfills the
+ *   promise of each request
+ *   - Executor waits on the future only when it needs the
+ *     result,DB thread waits only when the queue is empty.
  */
 #include "mhwimm_database_thread.h"
 #include "mhwimm_database.h"
@@ -18,291 +19,450 @@
 
 #include <chrono>
 #include <iostream>
+#include <functional>
+#include <future>
 #include <cstdbool>
 
 /* ins_date -  used  by ADD operation for field "install_date" */
 static std::time_t ins_date(0);
 
-/* is_db_op_succeed - used to tell CMD module whether DB operation is succeed */
-bool is_db_op_succeed(false);
-
-/* used to indicates what field the Executor needs. */
-mhwimm_sync_mechanism_ns::interest_db_field_t
-interest_field(mhwimm_sync_mechanism_ns::INTEREST_FIELD::NO_INTEREST);
-
-/* reg helper will setup this pointer variable */
-mhwimm_sync_mechanism_ns::mod_files_list *mfl_for_db(nullptr);
-
 /* path of mhwi root */
 extern typename mhwimm_config_ns::get_config_traits<mhwimm_config_ns::config_t>::skey_t *
 pmhwiroot_path;
 
-// caller must ensures @db been opened
-// we do not check it at there
 /**
- * mhwimm_db_thread_worker - DB module control thread
- * @db:                      db handler passed by caller
+ * stat_entry_type - stat the file of a record has no type
+ * @file_path:       path of the record,relative to mhwi root
+ * @entry_type:      where to store the type
+ * return:           0 OR -1
  */
-void mhwimm_db_thread_worker(mhwimm_db_ns::mhwimm_db &db)
+static int stat_entry_type(const std::string &file_path, mhwimm_db_ns::db_entry_type &entry_type)
 {
-  {
-    auto db_file_path(db.returnDBpath());
-    struct stat the_stat = {0};
-    bool need_create_table(false);
-    errno = 0;
-    if (stat(db_file_path.c_str(), &the_stat) < 0)
-      if (errno == ENOENT)
-        need_create_table = true;
+  assert(pmhwiroot_path != nullptr);
+  std::string stat_file_path(*pmhwiroot_path);
+  struct stat the_stat = {0};
 
-    std::string err_msg;
-    if (db.openDB() < 0) {
-      db.getDBErrMsg(err_msg);
-      std::cerr << err_msg << std::endl;
-      std::abort(); /* fatal error */
-    }
+  errno = 0;
+  stat_file_path += file_path;
 
-    if (need_create_table) {
 #ifdef DEBUG
-      std::cerr << "Prepare to create table." << std::endl;
+  std::cerr << "db thread: SQL_ASK - stat path - " << stat_file_path << std::endl;
 #endif
-      /**
-       * we'll create table at the first time to launch this application.
-       */
-      db.tryCreateTable();
-      if (db.getDBStatus() == mhwimm_db_ns::DB_STATUS::DB_ERROR) {
-        /* we failed to create table */
-        db.getDBErrMsg(err_msg);
-        std::cerr << err_msg << std::endl;
-        std::abort(); /* fatal error */
-      }
-    }
+  if (stat(stat_file_path.c_str(), &the_stat) < 0) {
+    if (errno == ENOENT) {
+      std::string err_msg = std::string{"db thread error: file - "} + file_path + " does not exist.";
+      std::cerr << err_msg << std::endl;
+    } else
+      std::cerr << "db thread error: cannot retrieve file's stat info - "
+                << file_path
+                << std::endl;
+    return -1;
   }
+  entry_type = S_ISDIR(the_stat.st_mode) ? mhwimm_db_ns::db_entry_type::ENTRY_DIRECTORY :
+    mhwimm_db_ns::db_entry_type::ENTRY_REGULAR;
+  return 0;
+}
 
-  /* do_DB_ask - do SQL_ASK on database */
-  auto do_DB_ask = [&, interest_field, mfl_for_db](void) -> void {
-    std::unique_lock<decltype(mfl_for_db->lock)> mfl_lock(mfl_for_db->lock);
-    int ret(0);
-
-    mhwimm_db_ns::db_tr_idx name_idx(mhwimm_db_ns::db_tr_idx::IDX_MOD_NAME);
-    mhwimm_db_ns::db_tr_idx path_idx(mhwimm_db_ns::db_tr_idx::IDX_FILE_PATH);
-
-    /* prepare to get result */
-  repeat_get:
-    ret = db.executeDBOperation();
-
-    if (!ret && db.getCurrentStatus() == mhwimm_db_ns::DB_STATUS::DB_WORKING) {
-      if (interest_field == mhwimm_sync_mechanism_ns::INTEREST_FIELD::INTEREST_NAME) {
-        std::string mod_name;
-        ret = db.getFieldValue(name_idx, mod_name);
-        if (ret < 0)
-          goto err_getField;
-        mfl_for_db->mod_name_list.insert(mfl_for_db->mod_name_list.begin(), mod_name);
-        goto repeat_get;
-      } else if (interest_field == mhwimm_sync_mechanism_ns::INTEREST_FIELD::INTEREST_PATH) {
-        assert(pmhwiroot_path != nullptr);
-        std::string file_path;
-        std::string stat_file_path(*pmhwiroot_path);
-        struct stat the_stat = {0};
-        ret = db.getFieldValue(path_idx, file_path);
-        if (ret)
-          goto err_getField;
-
-        errno = 0;
-        stat_file_path += file_path;
-
-#ifdef DEBUG
-        std::cerr << "db thread: SQL_ASK - stat path - " << stat_file_path << std::endl;
-#endif
-        ret = stat(stat_file_path.c_str(), &the_stat);
-        if (ret < 0) {
-          if (errno == ENOENT) {
-            std::string err_msg = std::string{"db thread error: file - "} + file_path + " does not exist.";
-            std::cerr << err_msg << std::endl;
-            db.chgDBStatus(mhwimm_db_ns::DB_STATUS::DB_ERROR);
-            return;
-          } else {
-            std::cerr << "db thread error: cannot retrieve file's stat info - "
-                      << file_path
-                      << std::endl;
-            db.chgDBStatus(mhwimm_db_ns::DB_STATUS::DB_ERROR);
-            return;
-          }
-        } else if (S_ISDIR(the_stat.st_mode)) {
-          mfl_for_db->directory_list.insert(mfl_for_db->directory_list.begin(), file_path);
-        } else {
-          mfl_for_db->regular_file_list.insert(mfl_for_db->regular_file_list.begin(), file_path);
-        }
-        goto repeat_get;
-      }
-      else {
-        std::string err_msg("db thread error: this regDBop has not be implemented.");
-        std::cerr << err_msg << std::endl;
+/* do_DB_ask - do SQL_ASK on database */
+static void do_DB_ask(mhwimm_db_ns::mhwimm_db &db, mhwimm_sync_mechanism_ns::db_request &req)
+{
+  std::unique_lock<decltype(req.mfl->lock)> mfl_lock(req.mfl->lock);
+  int ret(0);
+
+  mhwimm_db_ns::db_tr_idx name_idx(mhwimm_db_ns::db_tr_idx::IDX_MOD_NAME);
+  mhwimm_db_ns::db_tr_idx path_idx(mhwimm_db_ns::db_tr_idx::IDX_FILE_PATH);
+
+  /* prepare to get result */
+repeat_get:
+  ret = db.executeDBOperation();
+
+  if (!ret && db.getCurrentStatus() == mhwimm_db_ns::DB_STATUS::DB_WORKING) {
+    if (req.interest == mhwimm_sync_mechanism_ns::INTEREST_FIELD::INTEREST_NAME) {
+      std::string mod_name;
+      ret = db.getFieldValue(name_idx, mod_name);
+      if (ret < 0)
+        goto err_getField;
+      req.mfl->mod_name_list.push_back(mod_name);
+      goto repeat_get;
+    } else if (req.interest == mhwimm_sync_mechanism_ns::INTEREST_FIELD::INTEREST_PATH) {
+      std::string file_path;
+      mhwimm_db_ns::db_entry_type entry_type(mhwimm_db_ns::db_entry_type::ENTRY_UNKNOWN);
+      ret = db.getFieldValue(path_idx, file_path);
+      if (ret)
+        goto err_getField;
+      ret = db.getEntryType(entry_type);
+      if (ret)
+        goto err_getField;
+
+      /* records migrated from legacy table have no type,stat the file */
+      if (entry_type == mhwimm_db_ns::db_entry_type::ENTRY_UNKNOWN &&
+          stat_entry_type(file_path, entry_type) < 0) {
         db.chgDBStatus(mhwimm_db_ns::DB_STATUS::DB_ERROR);
         return;
       }
 
-    } else if (db.getCurrentStatus() == mhwimm_db_ns::DB_STATUS::DB_ERROR)
-      goto err_execute;
-
-    /**
-     * no more result can be got,method executeDBOperation() returned _zero_,
-     * and in this case,db status must be DB_IDLE.
-     */
-    if (interest_field == mhwimm_sync_mechanism_ns::INTEREST_FIELD::INTEREST_NAME) {
-      // make mod name unique.
-      // because for each fiel,DB always construct one record and insert
-      // it.for the mod have more files,then there are more records,
-      // and each record contains the mod name.
-
-//      if (mfl_for_db->mod_name_list.size() != 0) {
-//        auto iter_current_pos(mfl_for_db->mod_name_list.begin());
-//        auto iter_next_pos(mfl_for_db->mod_name_list.begin());
-//        ++iter_next_pos;
-//        for (; iter_next_pos != mfl_for_db->mod_name_list.end();) {
-//          if (*iter_current_pos == *iter_next_pos) {
-//            iter_next_pos = mfl_for_db->mod_name_list.erase(iter_next_pos);
-//            continue;
-//          }
-//          iter_current_pos = iter_next_pos;
-//          ++iter_next_pos;
-//        }
-//      }
-
-      mfl_for_db->mod_name_list.unique();
+      if (entry_type == mhwimm_db_ns::db_entry_type::ENTRY_DIRECTORY)
+        req.mfl->directory_list.push_back(file_path, mhwimm_path_list_ns::path_type::PATH_DIRECTORY);
+      else
+        req.mfl->regular_file_list.push_back(file_path, mhwimm_path_list_ns::path_type::PATH_REGULAR);
+      goto repeat_get;
+    }
+    else {
+      std::string err_msg("db thread error: this regDBop has not be implemented.");
+      std::cerr << err_msg << std::endl;
+      db.chgDBStatus(mhwimm_db_ns::DB_STATUS::DB_ERROR);
+      return;
+    }
+
+  } else if (db.getCurrentStatus() == mhwimm_db_ns::DB_STATUS::DB_ERROR)
+    goto err_execute;
+
+  // rows come in the order of installing,the latest mod is listed at first.
+  if (req.interest == mhwimm_sync_mechanism_ns::INTEREST_FIELD::INTEREST_NAME)
+    req.mfl->mod_name_list.reverse();
+
+  /**
+   * no more result can be got,method executeDBOperation() returned _zero_,
+   * and in this case,db status must be DB_IDLE.
+   */
 #ifdef DEBUG
-        std::cerr << "DEBUG do_DB_ask() - mod name list :" << std::endl;
-        for (auto i : mfl_for_db->mod_name_list)
-          std::cerr << i << std::endl;
+  if (req.interest == mhwimm_sync_mechanism_ns::INTEREST_FIELD::INTEREST_NAME) {
+    // each mod has exactly one record in mods table,
+    // thus the names are unique already.
+    std::cerr << "DEBUG do_DB_ask() - mod name list :" << std::endl;
+    for (const auto &i : req.mfl->mod_name_list)
+      std::cerr << i << std::endl;
+  }
 #endif
+
+  return;
+
+err_execute:
+  /* error detected when executing DB operation */
+err_getField:
+  std::string err_msg;
+  db.getDBErrMsg(err_msg);
+  std::cerr << err_msg << std::endl;
+}
+
+/**
+ * do_DB_stream - do SQL_ASK with INTEREST_PATH,the rows are pushed
+ *                to req.stream chunk by chunk while stepping
+ * # the last chunk is always pushed,even if error occurred,the
+ *   consumer checks the result of the request.
+ */
+static void do_DB_stream(mhwimm_db_ns::mhwimm_db &db, mhwimm_sync_mechanism_ns::db_request &req)
+{
+  mhwimm_db_ns::db_tr_idx path_idx(mhwimm_db_ns::db_tr_idx::IDX_FILE_PATH);
+  mhwimm_sync_mechanism_ns::path_chunk chunk {.last = false};
+  std::string file_path;
+
+  while (!db.executeDBOperation() &&
+         db.getCurrentStatus() == mhwimm_db_ns::DB_STATUS::DB_WORKING) {
+    mhwimm_db_ns::db_entry_type entry_type(mhwimm_db_ns::db_entry_type::ENTRY_UNKNOWN);
+    if (db.getFieldValue(path_idx, file_path) || db.getEntryType(entry_type)) {
+      db.chgDBStatus(mhwimm_db_ns::DB_STATUS::DB_ERROR);
+      goto err_db;
+    }
+    if (entry_type == mhwimm_db_ns::db_entry_type::ENTRY_UNKNOWN &&
+        stat_entry_type(file_path, entry_type) < 0) {
+      db.chgDBStatus(mhwimm_db_ns::DB_STATUS::DB_ERROR);
+      goto last_chunk;
     }
 
-    return;
+    chunk.paths.push_back(file_path,
+                          entry_type == mhwimm_db_ns::db_entry_type::ENTRY_DIRECTORY ?
+                          mhwimm_path_list_ns::path_type::PATH_DIRECTORY :
+                          mhwimm_path_list_ns::path_type::PATH_REGULAR);
+    if (chunk.paths.size() == mhwimm_sync_mechanism_ns::PATH_CHUNK_SIZE) {
+      req.stream->push(std::move(chunk));
+      chunk = mhwimm_sync_mechanism_ns::path_chunk {.last = false};
+    }
+  }
 
-  err_execute:
-    /* error detected when executing DB operation */
-  err_getField:
+ err_db:
+  if (db.getCurrentStatus() == mhwimm_db_ns::DB_STATUS::DB_ERROR) {
     std::string err_msg;
     db.getDBErrMsg(err_msg);
     std::cerr << err_msg << std::endl;
-  };
-
-  /* ADD - no result return */
-  auto do_DB_add = [&, mfl_for_db](void) -> void {
-    ins_date = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-    std::string date(ctime(&ins_date));
-    std::string date_rec = date.substr(0, date.length() - 1);
-    
-    /* because regDBop been specified,we have retrieve it */
-    mhwimm_db_ns::db_table_record dtr = {
-      .mod_name = db.currentSelectedModName(),
-      .is_mod_name_set = 1,
-      .install_date = date_rec,
-      .is_install_date_set = 1,
-    };
-
-    std::unique_lock<decltype(mfl_for_db->lock)> mfl_lock(mfl_for_db->lock);
-
-    /* next,process two cycle for traverse file list */
-
-    dtr.is_file_path_set = 1;
-    /* step1 : import directory list */
-    for (auto e : mfl_for_db->directory_list) {
-      dtr.file_path = e;
+  }
 
-#ifdef DEBUG
-      std::cerr << "SQL_ADD - directory path - " << e << std::endl;
-#endif
+ last_chunk:
+  chunk.last = true;
+  req.stream->push(std::move(chunk));
+}
 
-      db.registerDBOperation(mhwimm_db_ns::SQL_OP::SQL_ADD, dtr);
-      db.executeDBOperation();
-      
-      if (db.getCurrentStatus() == mhwimm_db_ns::DB_STATUS::DB_ERROR)
-        goto err_exit_with_undo;
-    }
+/* ADD - no result return */
+static void do_DB_add(mhwimm_db_ns::mhwimm_db &db, mhwimm_sync_mechanism_ns::db_request &req)
+{
+  ins_date = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+  std::string date(ctime(&ins_date));
+  std::string date_rec = date.substr(0, date.length() - 1);
+
+  /* the owner of gated request holds the lock,and keeps the lists */
+  /* unchanged until the gate opened. */
+  std::unique_lock<decltype(req.mfl->lock)> mfl_lock(req.mfl->lock, std::defer_lock);
+  if (!req.gate.valid())
+    mfl_lock.lock();
+
+  /* records are inserted while the owner is deploying the mod, */
+  /* they are committed only if the deployment succeed. */
+  bool aborted(false);
+  std::function<bool(void)> before_commit;
+  if (req.gate.valid())
+    before_commit = [&req, &aborted](void) -> bool {
+                      try {
+                        aborted = !req.gate.get();
+                      } catch (const std::future_error &) {
+                        // the owner gave up without telling us
+                        aborted = true;
+                      }
+                      return !aborted;
+                    };
+
+  /* because regDBop been specified,we have retrieve it */
+  /* all records are written in one transaction,if it failed, */
+  /* database rolled back it,there is nothing need to undo. */
+  if (db.addModFilesList(db.currentSelectedModName(), date_rec,
+                         req.mfl->mod_source,
+                         req.mfl->directory_list,
+                         req.mfl->regular_file_list,
+                         req.mfl->content_hash_list,
+                         req.mfl->file_meta_list,
+                         req.mfl->deployed_hash_list,
+                         before_commit) < 0) {
+    std::string err_msg;
+    db.getDBErrMsg(err_msg);
+    if (!aborted)
+      std::cerr << err_msg << std::endl;
 
-    /* step2 : import regular file list */
-    for (auto e : mfl_for_db->regular_file_list) {
-      dtr.file_path = e;
+    /* tell Thread Worker we encountered error */
+    db.chgDBStatus(mhwimm_db_ns::DB_STATUS::DB_ERROR);
+  }
+}
 
-#ifdef DEBUG
-      std::cerr << "SQL_ADD - regular file path - " << e << std::endl;
-#endif
+/* UPDATE - delta of the mod,no result return */
+static void do_DB_update(mhwimm_db_ns::mhwimm_db &db, mhwimm_sync_mechanism_ns::db_request &req)
+{
+  ins_date = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+  std::string date(ctime(&ins_date));
+  std::string date_rec = date.substr(0, date.length() - 1);
+
+  std::unique_lock<decltype(req.mfl->lock)> mfl_lock(req.mfl->lock);
+
+  /* one transaction,nothing need to undo if it failed */
+  if (db.updateModFilesList(db.currentSelectedModName(), date_rec,
+                            req.mfl->mod_source,
+                            req.mfl->removed_list,
+                            req.mfl->directory_list,
+                            req.mfl->regular_file_list,
+                            req.mfl->content_hash_list,
+                            req.mfl->file_meta_list,
+                            req.mfl->deployed_hash_list) < 0) {
+    std::string err_msg;
+    db.getDBErrMsg(err_msg);
+    std::cerr << err_msg << std::endl;
+    db.chgDBStatus(mhwimm_db_ns::DB_STATUS::DB_ERROR);
+  }
+}
+
+/* HASH - hashes of the deployed files of the mod,no result return */
+static void do_DB_set_hashes(mhwimm_db_ns::mhwimm_db &db, mhwimm_sync_mechanism_ns::db_request &req)
+{
+  std::unique_lock<decltype(req.mfl->lock)> mfl_lock(req.mfl->lock);
 
-      db.registerDBOperation(mhwimm_db_ns::SQL_OP::SQL_ADD, dtr);
-      db.executeDBOperation();
+  if (db.setDeployedHashes(db.currentSelectedModName(),
+                           req.mfl->regular_file_list,
+                           req.mfl->deployed_hash_list) < 0) {
+    std::string err_msg;
+    db.getDBErrMsg(err_msg);
+    std::cerr << err_msg << std::endl;
+    db.chgDBStatus(mhwimm_db_ns::DB_STATUS::DB_ERROR);
+  }
+}
 
-      if (db.getCurrentStatus() == mhwimm_db_ns::DB_STATUS::DB_ERROR)
-        goto err_exit_with_undo;
-    }
-    return;
+/* CONFLICT - owners of the files to be installed,ordered by owner */
+static void do_DB_conflict(mhwimm_db_ns::mhwimm_db &db, mhwimm_sync_mechanism_ns::db_request &req)
+{
+  std::unique_lock<decltype(req.mfl->lock)> mfl_lock(req.mfl->lock);
 
-  err_exit_with_undo:
-    /* we encountered error when import record into db */
+  req.mfl->conflict_list.clear();
+  if (db.findConflicts(req.mfl->regular_file_list,
+                       req.mfl->conflict_list) < 0) {
     std::string err_msg;
     db.getDBErrMsg(err_msg);
     std::cerr << err_msg << std::endl;
+    db.chgDBStatus(mhwimm_db_ns::DB_STATUS::DB_ERROR);
+  }
+}
 
-    /* delete all records of current mod from db */
-    dtr.is_file_path_set = 0;
-    dtr.is_install_date_set = 0;
-    db.registerDBOperation(mhwimm_db_ns::SQL_OP::SQL_DEL, dtr);
-    db.executeDBOperation();
+/* HASH - content hashes referenced by installed mods */
+static void do_DB_hash(mhwimm_db_ns::mhwimm_db &db, mhwimm_sync_mechanism_ns::db_request &req)
+{
+  std::unique_lock<decltype(req.mfl->lock)> mfl_lock(req.mfl->lock);
 
-    if (db.getCurrentStatus() == mhwimm_db_ns::DB_STATUS::DB_ERROR) {
-      db.getDBErrMsg(err_msg);
-      std::cerr << err_msg << std::endl;
-    }
+  req.mfl->content_hash_list.clear();
+  if (db.getContentHashes(req.mfl->content_hash_list) < 0) {
+    std::string err_msg;
+    db.getDBErrMsg(err_msg);
+    std::cerr << err_msg << std::endl;
+    db.chgDBStatus(mhwimm_db_ns::DB_STATUS::DB_ERROR);
+  }
+}
 
-    /* tell Thread Worker we encountered error */
+/* META - regular files with their metadata,content hashes and sources,ordered by owner */
+static void do_DB_meta(mhwimm_db_ns::mhwimm_db &db, mhwimm_sync_mechanism_ns::db_request &req)
+{
+  std::unique_lock<decltype(req.mfl->lock)> mfl_lock(req.mfl->lock);
+
+  req.mfl->mod_name_list.clear();
+  req.mfl->regular_file_list.clear();
+  req.mfl->file_meta_list.clear();
+  req.mfl->content_hash_list.clear();
+  req.mfl->source_list.clear();
+  if (db.getFileMeta(req.mod_name, req.mfl->mod_name_list,
+                     req.mfl->regular_file_list, req.mfl->file_meta_list,
+                     req.mfl->content_hash_list, req.mfl->source_list) < 0) {
+    std::string err_msg;
+    db.getDBErrMsg(err_msg);
+    std::cerr << err_msg << std::endl;
     db.chgDBStatus(mhwimm_db_ns::DB_STATUS::DB_ERROR);
-  };
+  }
+}
 
-  /* DEL - no result return */
-  auto do_DB_del = [&](void) -> void {
-    /* actually,we just invoke method executeDBOperation() as well */
-    /* because the regDBop helper been registered OP and DTR filter */
+/* DEL - no result return */
+static void do_DB_del(mhwimm_db_ns::mhwimm_db &db, mhwimm_sync_mechanism_ns::db_request &req)
+{
+  /* actually,we just invoke method executeDBOperation() as well */
+  /* because the regDBop helper been registered OP and DTR filter */
 
-    db.executeDBOperation();
-    if (db.getCurrentStatus() == mhwimm_db_ns::DB_STATUS::DB_ERROR) {
-      std::string err_msg;
-      db.getDBErrMsg(err_msg);
-      std::cerr << err_msg << std::endl;
-    }
-  };
+  db.executeDBOperation();
+  if (db.getCurrentStatus() == mhwimm_db_ns::DB_STATUS::DB_ERROR) {
+    std::string err_msg;
+    db.getDBErrMsg(err_msg);
+    std::cerr << err_msg << std::endl;
+  }
+}
 
-  makeup_uniquelock_and_associate_condv(dbexe_lock, exedb_condv_sync);
-  dbexe_lock.unlock();
+/**
+ * mhwimm_db_prepare - open @db and create or upgrade the tables
+ * @db:                db handler passed by caller
+ * return:             0 => succeed,-1 => failed
+ */
+int mhwimm_db_prepare(mhwimm_db_ns::mhwimm_db &db)
+{
+  std::string err_msg;
+  if (db.openDB() < 0) {
+    db.getDBErrMsg(err_msg);
+    std::cerr << err_msg << std::endl;
+    return -1;
+  }
 
-  for (; ;) {
-    db.resetDB();
+  /**
+   * we'll create tables at the first time to launch this application,
+   * and the database created by older version will be upgraded.
+   */
+  db.tryCreateTable();
+  if (db.getDBStatus() == mhwimm_db_ns::DB_STATUS::DB_ERROR) {
+    /* we failed to create or upgrade tables */
+    db.getDBErrMsg(err_msg);
+    std::cerr << err_msg << std::endl;
+    return -1;
+  }
+  return 0;
+}
 
-    // It is my round now!
-    exedb_condv_sync.wait_cond_odd(dbexe_lock);
+/**
+ * mhwimm_db_process_request - process one request
+ * @db:                        db handler passed by caller
+ * @req:                       the request,its promise is fulfilled
+ */
+static void mhwimm_db_process_request(mhwimm_db_ns::mhwimm_db &db,
+                                      mhwimm_sync_mechanism_ns::db_request &req)
+{
+  mhwimm_db_ns::db_table_record dtr = _ZERO_dtr;
+  if (!req.mod_name.empty()) {
+    dtr.mod_name = req.mod_name; // as filter or the mod to be recorded
+    dtr.is_mod_name_set = 1;
+  }
+  db.registerDBOperation(req.op, dtr);
 
-    // DB is stopped as long as Executor no request.
-    // if Executor exit without any request,then
-    // we should not start a new DB transaction.
-    if (program_exit)
+  switch (req.op) {
+  case mhwimm_db_ns::SQL_OP::SQL_ASK:
+    if (req.interest == mhwimm_sync_mechanism_ns::INTEREST_FIELD::INTEREST_CONFLICT) {
+      do_DB_conflict(db, req);
       break;
-
-    // DB operation will be registered by Executor via call to register helpers.
-    switch (db.getCurrentOP()) {
-    case mhwimm_db_ns::SQL_OP::SQL_ASK:
-      do_DB_ask();
+    } else if (req.interest == mhwimm_sync_mechanism_ns::INTEREST_FIELD::INTEREST_HASH) {
+      do_DB_hash(db, req);
+      break;
+    } else if (req.interest == mhwimm_sync_mechanism_ns::INTEREST_FIELD::INTEREST_META) {
+      do_DB_meta(db, req);
       break;
-    case mhwimm_db_ns::SQL_OP::SQL_ADD:
-      do_DB_add();
+    } else if (req.stream) {
+      do_DB_stream(db, req);
       break;
-    case mhwimm_db_ns::SQL_OP::SQL_DEL:
-      do_DB_del();
     }
-    is_db_op_succeed = true;
-    if (db.getCurrentStatus() == mhwimm_db_ns::DB_STATUS::DB_ERROR)
-      is_db_op_succeed = false;
+    [[fallthrough]];
+  case mhwimm_db_ns::SQL_OP::SQL_ASK_MODS:
+    do_DB_ask(db, req);
+    break;
+  case mhwimm_db_ns::SQL_OP::SQL_ADD:
+    do_DB_add(db, req);
+    break;
+  case mhwimm_db_ns::SQL_OP::SQL_UPDATE:
+    if (req.interest == mhwimm_sync_mechanism_ns::INTEREST_FIELD::INTEREST_HASH)
+      do_DB_set_hashes(db, req);
+    else
+      do_DB_update(db, req);
+    break;
+  case mhwimm_db_ns::SQL_OP::SQL_DEL:
+    do_DB_del(db, req);
+  }
+  bool succeed(db.getCurrentStatus() != mhwimm_db_ns::DB_STATUS::DB_ERROR);
+
+  // reset DB before fulfill the promise,the owner might queue
+  // the next request at once.
+  db.resetDB();
+  req.result.set_value(succeed);
+}
 
-    // Round finished.
-    exedb_condv_sync.update_and_notify(dbexe_lock);
+/**
+ * mhwimm_db_process_queue - process the requests in @exedb_queue
+ *                           until it is empty
+ * @db:                      db handler passed by caller
+ */
+void mhwimm_db_process_queue(mhwimm_db_ns::mhwimm_db &db)
+{
+  for (mhwimm_sync_mechanism_ns::db_request req; exedb_queue.try_pop(req); )
+    if (req.op != mhwimm_db_ns::SQL_OP::SQL_NOP)
+      mhwimm_db_process_request(db, req);
+}
+
+/**
+ * mhwimm_db_thread_worker - DB module control thread
+ * @db:                      db handler passed by caller
+ */
+void mhwimm_db_thread_worker(mhwimm_db_ns::mhwimm_db &db)
+{
+  if (mhwimm_db_prepare(db) < 0)
+    std::abort(); /* fatal error */
+
+  for (mhwimm_sync_mechanism_ns::db_request req; ;) {
+    exedb_queue.pop(req);
+
+    // Executor stopped,it will not queue any request.
+    if (req.op == mhwimm_db_ns::SQL_OP::SQL_NOP)
+      break;
+
+    mhwimm_db_process_request(db, req);
   }
 
+#ifdef DEBUG
+  std::size_t stmt_cache_hits(0), stmt_cache_misses(0);
+  db.getStmtCacheStats(stmt_cache_hits, stmt_cache_misses);
+  std::cerr << "db thread: statement cache hits: " << stmt_cache_hits
+            << ", misses: " << stmt_cache_misses << std::endl;
+#endif
+
   db.closeDB();
 }
@@ -4,65 +4,151 @@
 #include "mhwimm_sync_mechanism.h"
 #include "mhwimm_database.h"
 
-#include <assert.h>
+using mhwimm_sync_mechanism_ns::db_request;
+using mhwimm_sync_mechanism_ns::INTEREST_FIELD;
 
-static mhwimm_db_ns::mhwimm_db *db_impl(nullptr);
-
-void init_regDB_routines(mhwimm_db_ns::mhwimm_db *db)
+/* queue_request - queue @req to DB thread and return its future */
+static std::future<bool> queue_request(db_request &&req)
 {
-  db_impl = db;
+  std::future<bool> f(req.result.get_future());
+  exedb_queue.push(std::move(req));
+  return f;
 }
 
 /* request DB returns all mods' names in @mfl */
-void regDBop_getAllInstalled_Modsname(mhwimm_sync_mechanism_ns::mod_files_list *mfl)
+std::future<bool> regDBop_getAllInstalled_Modsname(mhwimm_sync_mechanism_ns::mod_files_list *mfl)
 {
-  assert(db_impl != nullptr);
-  mfl_for_db = mfl;
-  interest_field = mhwimm_sync_mechanism_ns::INTEREST_FIELD::INTEREST_NAME;
-  mhwimm_db_ns::db_table_record dtr = _ZERO_dtr;
-  db_impl->registerDBOperation(mhwimm_db_ns::SQL_OP::SQL_ASK, dtr);
-
+  return queue_request(db_request {
+      .op = mhwimm_db_ns::SQL_OP::SQL_ASK_MODS,
+      .interest = INTEREST_FIELD::INTEREST_NAME,
+      .mfl = mfl,
+    });
 }
 
 /* request DB returns the detail info about a specified mod in @mfl */
-void regDBop_getInstalled_Modinfo(const std::string &modname,
-                                  mhwimm_sync_mechanism_ns::mod_files_list *mfl)
+std::future<bool> regDBop_getInstalled_Modinfo(std::string_view modname,
+                                               mhwimm_sync_mechanism_ns::mod_files_list *mfl)
+{
+  return queue_request(db_request {
+      .op = mhwimm_db_ns::SQL_OP::SQL_ASK,
+      .interest = INTEREST_FIELD::INTEREST_PATH,
+      .mod_name = std::string(modname), // as filter
+      .mfl = mfl,
+    });
+}
+
+/* request DB stream the records of a specified mod to @stream */
+/* chunk by chunk while the cursor is stepping */
+std::future<bool> regDBop_streamInstalled_Modinfo(std::string_view modname,
+                                                  mhwimm_sync_mechanism_ns::path_stream *stream)
 {
-  assert(db_impl != nullptr);
-  mfl_for_db = mfl;
-  interest_field = mhwimm_sync_mechanism_ns::INTEREST_FIELD::INTEREST_PATH;
-  mhwimm_db_ns::db_table_record dtr = {
-    .mod_name = modname, // as filter
-    .is_mod_name_set = 1,
-  };
-  db_impl->registerDBOperation(mhwimm_db_ns::SQL_OP::SQL_ASK, dtr);
+  return queue_request(db_request {
+      .op = mhwimm_db_ns::SQL_OP::SQL_ASK,
+      .interest = INTEREST_FIELD::INTEREST_PATH,
+      .mod_name = std::string(modname), // as filter
+      .mfl = nullptr,
+      .stream = stream,
+    });
 }
 
 /* request DB add new mod infos into database */
-/* the @interest_field is set to 6,and DB op set to SQL_ADD */
-/* db thread worker must checks these,and read infos from @mfl */
-void regDBop_add_mod_info(const std::string &modname,
-                          mhwimm_sync_mechanism_ns::mod_files_list *mfl)
+/* db thread worker reads infos from @mfl,the records are */
+/* committed after @gate becomes true if it is valid */
+std::future<bool> regDBop_add_mod_info(std::string_view modname,
+                                       mhwimm_sync_mechanism_ns::mod_files_list *mfl,
+                                       std::shared_future<bool> gate)
 {
-  assert(db_impl != nullptr);
-  mfl_for_db = mfl;
-  mhwimm_db_ns::db_table_record dtr = {
-    .mod_name = modname,
-    .is_mod_name_set = 1,
-  };
-  db_impl->registerDBOperation(mhwimm_db_ns::SQL_OP::SQL_ADD, dtr);
+  return queue_request(db_request {
+      .op = mhwimm_db_ns::SQL_OP::SQL_ADD,
+      .interest = INTEREST_FIELD::NO_INTEREST,
+      .mod_name = std::string(modname),
+      .mfl = mfl,
+      .gate = std::move(gate),
+    });
 }
 
 /* request DB remove records about a specified mod */
-/* @interest_field is set to _zero_,means we do not needs any */
-/* result set */
-void regDBop_remove_mod_info(const std::string &modname)
+/* we do not needs any result set */
+std::future<bool> regDBop_remove_mod_info(std::string_view modname)
 {
-  mhwimm_db_ns::db_table_record dtr = {
-    .mod_name = modname, // as filter
-    .is_mod_name_set = 1,
-  };
-  db_impl->registerDBOperation(mhwimm_db_ns::SQL_OP::SQL_DEL, dtr);
+  return queue_request(db_request {
+      .op = mhwimm_db_ns::SQL_OP::SQL_DEL,
+      .interest = INTEREST_FIELD::NO_INTEREST,
+      .mod_name = std::string(modname), // as filter
+      .mfl = nullptr,
+    });
 }
 
+/* request DB apply the delta of a mod in @mfl */
+/* @mfl->removed_list are removed,and then the other lists are added */
+std::future<bool> regDBop_update_mod_info(std::string_view modname,
+                                          mhwimm_sync_mechanism_ns::mod_files_list *mfl)
+{
+  return queue_request(db_request {
+      .op = mhwimm_db_ns::SQL_OP::SQL_UPDATE,
+      .interest = INTEREST_FIELD::NO_INTEREST,
+      .mod_name = std::string(modname),
+      .mfl = mfl,
+    });
+}
 
+/* request DB record the hashes of the deployed files of a mod */
+/* @mfl->deployed_hash_list of @mfl->regular_file_list */
+std::future<bool> regDBop_set_deployed_hashes(std::string_view modname,
+                                              mhwimm_sync_mechanism_ns::mod_files_list *mfl)
+{
+  return queue_request(db_request {
+      .op = mhwimm_db_ns::SQL_OP::SQL_UPDATE,
+      .interest = INTEREST_FIELD::INTEREST_HASH,
+      .mod_name = std::string(modname),
+      .mfl = mfl,
+    });
+}
+
+/* request DB find out the owners of the regular files in @mfl */
+/* the result is stored in @mfl->conflict_list */
+std::future<bool> regDBop_find_conflicts(mhwimm_sync_mechanism_ns::mod_files_list *mfl)
+{
+  return queue_request(db_request {
+      .op = mhwimm_db_ns::SQL_OP::SQL_ASK,
+      .interest = INTEREST_FIELD::INTEREST_CONFLICT,
+      .mfl = mfl,
+    });
+}
+
+/* request DB returns the content hashes referenced by installed mods */
+/* the result is stored in @mfl->content_hash_list */
+std::future<bool> regDBop_get_content_hashes(mhwimm_sync_mechanism_ns::mod_files_list *mfl)
+{
+  return queue_request(db_request {
+      .op = mhwimm_db_ns::SQL_OP::SQL_ASK,
+      .interest = INTEREST_FIELD::INTEREST_HASH,
+      .mfl = mfl,
+    });
+}
+
+/* request DB returns the regular files with their metadata,of the */
+/* mod @modname or all mods if it is empty,the result is stored in */
+/* @mfl->regular_file_list,@mfl->file_meta_list,the owners in */
+/* @mfl->mod_name_list,the recorded hashes in @mfl->content_hash_list */
+/* and the sources of the owners in @mfl->source_list */
+std::future<bool> regDBop_get_file_meta(std::string_view modname,
+                                        mhwimm_sync_mechanism_ns::mod_files_list *mfl)
+{
+  return queue_request(db_request {
+      .op = mhwimm_db_ns::SQL_OP::SQL_ASK,
+      .interest = INTEREST_FIELD::INTEREST_META,
+      .mod_name = std::string(modname),
+      .mfl = mfl,
+    });
+}
+
+/* request DB thread stop,no result */
+void regDBop_stop(void)
+{
+  exedb_queue.push(db_request {
+      .op = mhwimm_db_ns::SQL_OP::SQL_NOP,
+      .interest = INTEREST_FIELD::NO_INTEREST,
+      .mfl = nullptr,
+    });
+}
@@ -0,0 +1,240 @@
+/**
+ * Deploy Strategies
+ * Files are cloned by FICLONE if the filesystem supports it,
+ * otherwise they are copied by copy_file_range(),which lets the
+ * kernel copy data without bouncing it through user space.
+ */
+#include "mhwimm_deploy.h"
+
+#include <atomic>
+#include <memory>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+
+namespace mhwimm_deploy_ns {
+
+  /* files not smaller than it are copied by chunks in parallel */
+  static constexpr off_t large_file_size = 64 << 20;
+  static constexpr off_t chunk_size = 16 << 20;
+  /* jobs started before waiting for them,bounds the opened fds */
+  static constexpr std::size_t copy_window = 256;
+
+  int parse_deploy_strategy(std::string_view name, deploy_strategy &strategy)
+  {
+    if (name == "link")
+      strategy = deploy_strategy::DEPLOY_LINK;
+    else if (name == "reflink")
+      strategy = deploy_strategy::DEPLOY_REFLINK;
+    else if (name == "copy")
+      strategy = deploy_strategy::DEPLOY_COPY;
+    else if (name == "store")
+      strategy = deploy_strategy::DEPLOY_STORE;
+    else
+      return -1;
+    return 0;
+  }
+
+  bool should_fallback(int err)
+  {
+    // EXDEV : different filesystems
+    // EPERM, EOPNOTSUPP : filesystem does not support hard link
+    // EMLINK : too many links to the source
+    return err == EXDEV || err == EPERM || err == EOPNOTSUPP || err == EMLINK;
+  }
+
+  /**
+   * copy_range - copy [@off, @off + @len) from @src_fd to @dst_fd
+   * return:      0 OR -errno
+   * # falls back to pread()/pwrite() if copy_file_range() is not
+   *   supported between the two files.
+   */
+  static int copy_range(int src_fd, int dst_fd, off_t off, off_t len)
+  {
+    loff_t in_off(off), out_off(off);
+
+    while (len > 0) {
+      ssize_t ncopied(copy_file_range(src_fd, &in_off, dst_fd, &out_off, len, 0));
+      if (ncopied < 0) {
+        if (errno == EINTR)
+          continue;
+        if (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP)
+          goto fallback_rw;
+        return -errno;
+      } else if (ncopied == 0)
+        return -EIO;    // source truncated
+      len -= ncopied;
+    }
+    return 0;
+
+  fallback_rw:
+    {
+      constexpr std::size_t buf_size = 256 * 1024;
+      std::unique_ptr<char[]> buf(new char[buf_size]);
+      while (len > 0) {
+        ssize_t nread(pread(src_fd, buf.get(),
+                            len < static_cast<off_t>(buf_size) ? len : buf_size, in_off));
+        if (nread < 0 && errno == EINTR)
+          continue;
+        if (nread <= 0)
+          return nread < 0 ? -errno : -EIO;
+
+        for (ssize_t nwritten(0); nwritten < nread; ) {
+          ssize_t ret(pwrite(dst_fd, buf.get() + nwritten, nread - nwritten, in_off + nwritten));
+          if (ret < 0) {
+            if (errno == EINTR)
+              continue;
+            return -errno;
+          }
+          nwritten += ret;
+        }
+        in_off += nread;
+        len -= nread;
+      }
+    }
+    return 0;
+  }
+
+  /**
+   * copy_job - state of copying one file
+   * @large:    the data is copied by chunks after the file created
+   * @err:      0 OR -errno,written by chunk tasks concurrently
+   */
+  struct copy_job {
+    mhwimm_fsbatch_ns::fs_op *op;
+    int src_fd;
+    int dst_fd;
+    off_t size;
+    bool large;
+    std::atomic<int> err;
+  };
+
+  /* finish_copy - close the fds of @job,remove the destination if failed */
+  static void finish_copy(int dirfd, copy_job *job)
+  {
+    int err(job->err.load(std::memory_order_relaxed));
+
+    if (job->src_fd >= 0)
+      (void)close(job->src_fd);
+    if (job->dst_fd >= 0) {
+      (void)close(job->dst_fd);
+      // the destination is created by us
+      if (err)
+        (void)unlinkat(dirfd, job->op->path, 0);
+    }
+    job->src_fd = job->dst_fd = -1;
+    job->op->result = err;
+  }
+
+  /* start_copy - create destination,and clone or copy small file */
+  /* the fds are kept only if the file is large and to be copied by chunks */
+  static void start_copy(int dirfd, copy_job *job, deploy_strategy strategy)
+  {
+    struct stat src_stat = {0};
+
+    job->src_fd = open(job->op->src, O_RDONLY | O_CLOEXEC);
+    if (job->src_fd < 0 || fstat(job->src_fd, &src_stat) < 0) {
+      job->err.store(-errno, std::memory_order_relaxed);
+      goto out;
+    }
+    job->size = src_stat.st_size;
+
+    job->dst_fd = openat(dirfd, job->op->path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                         src_stat.st_mode & 07777);
+    if (job->dst_fd < 0) {
+      job->err.store(-errno, std::memory_order_relaxed);
+      goto out;
+    }
+    (void)fchmod(job->dst_fd, src_stat.st_mode & 07777);
+
+#ifdef FICLONE
+    // share extents with the source,nothing to be copied
+    if (strategy != deploy_strategy::DEPLOY_COPY &&
+        ioctl(job->dst_fd, FICLONE, job->src_fd) == 0)
+      goto out;
+#else
+    (void)strategy;
+#endif
+
+    if (job->size >= large_file_size) {
+      job->large = true;
+      return;
+    }
+    job->err.store(copy_range(job->src_fd, job->dst_fd, 0, job->size),
+                   std::memory_order_relaxed);
+
+  out:
+    finish_copy(dirfd, job);
+  }
+
+  std::size_t copy_files(int dirfd, mhwimm_fsbatch_ns::fs_op *ops, std::size_t nops,
+                         deploy_strategy strategy,
+                         mhwimm_thread_pool_ns::work_stealing_pool &pool)
+  {
+    if (!nops)
+      return 0;
+
+    std::size_t nwindow(nops < copy_window ? nops : copy_window);
+    std::unique_ptr<copy_job[]> jobs(new copy_job[nwindow]);
+    std::size_t nfailed(0);
+
+    // a window of jobs at a time,thus at most two fds of each job
+    // in the window are opened,no matter how many files the mod has.
+    for (std::size_t base(0); base < nops; base += nwindow) {
+      std::size_t njobs(nops - base < nwindow ? nops - base : nwindow);
+
+      for (std::size_t i(0); i < njobs; ++i) {
+        copy_job *job(&jobs[i]);
+        job->op = &ops[base + i];
+        job->src_fd = job->dst_fd = -1;
+        job->size = 0;
+        job->large = false;
+        job->err.store(0, std::memory_order_relaxed);
+        pool.submit([dirfd, job, strategy](void) -> void {
+                      start_copy(dirfd, job, strategy);
+                    });
+      }
+      pool.wait();
+
+      // large files are split into chunks,thus one large file
+      // does not occupy only one worker.
+      bool has_large(false);
+      for (std::size_t i(0); i < njobs; ++i) {
+        copy_job *job(&jobs[i]);
+        if (!job->large)
+          continue;
+        if (ftruncate(job->dst_fd, job->size) < 0) {
+          job->err.store(-errno, std::memory_order_relaxed);
+          continue;
+        }
+        has_large = true;
+        for (off_t off(0); off < job->size; off += chunk_size) {
+          off_t len(job->size - off < chunk_size ? job->size - off : chunk_size);
+          pool.submit([job, off, len](void) -> void {
+                        int ret(copy_range(job->src_fd, job->dst_fd, off, len));
+                        int expected(0);
+                        if (ret)
+                          (void)job->err.compare_exchange_strong(expected, ret,
+                                                                 std::memory_order_relaxed);
+                      });
+        }
+      }
+      if (has_large)
+        pool.wait();
+
+      for (std::size_t i(0); i < njobs; ++i) {
+        copy_job *job(&jobs[i]);
+        if (job->large)
+          finish_copy(dirfd, job);
+        if (job->op->result)
+          ++nfailed;
+      }
+    }
+    return nfailed;
+  }
+
+}
@@ -0,0 +1,106 @@
+/**
+ * Member Method Definitions of dir_scanner
+ */
+#include "mhwimm_dirscan.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <string.h>
+
+namespace mhwimm_dirscan_ns {
+
+  /**
+   * linux_dirent64 - the record returned by getdents64
+   * # glibc does not export this structure before 2.30,
+   *   thus we define it by ourselves.
+   */
+  struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+  };
+
+  int dir_scanner::open(int dirfd, const char *path, bool skip_dots)
+  {
+    close();
+    fd_ = openat(dirfd, path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd_ < 0)
+      return -1;
+    skip_dots_ = skip_dots;
+    return 0;
+  }
+
+  void dir_scanner::close(void)
+  {
+    if (fd_ >= 0)
+      (void)::close(fd_);
+    fd_ = -1;
+    buf_pos_ = buf_end_ = 0;
+  }
+
+  int dir_scanner::next(const char *&name, dentry_type &type)
+  {
+    if (fd_ < 0)
+      return -1;
+
+    for (; ;) {
+      if (buf_pos_ >= buf_end_) {
+        long nread(syscall(SYS_getdents64, fd_, buf_.get(), buf_size_));
+        if (nread < 0)
+          return -1;
+        else if (nread == 0)
+          return 0;
+        buf_pos_ = 0;
+        buf_end_ = static_cast<std::size_t>(nread);
+      }
+
+      auto *dentry(reinterpret_cast<linux_dirent64 *>(buf_.get() + buf_pos_));
+      buf_pos_ += dentry->d_reclen;
+
+      if (skip_dots_ && dentry->d_name[0] == '.' &&
+          (!dentry->d_name[1] || (dentry->d_name[1] == '.' && !dentry->d_name[2])))
+        continue;
+
+      name = dentry->d_name;
+      switch (dentry->d_type) {
+      case DT_REG:
+        type = dentry_type::ENT_REGULAR;
+        return 1;
+      case DT_DIR:
+        type = dentry_type::ENT_DIRECTORY;
+        return 1;
+      case DT_LNK:
+        type = dentry_type::ENT_SYMLINK;
+        return 1;
+      case DT_UNKNOWN:
+        break;
+      default:
+        type = dentry_type::ENT_OTHER;
+        return 1;
+      }
+
+      // filesystem does not fill d_type,have to stat it
+      struct stat dentry_stat = {0};
+      if (fstatat(fd_, dentry->d_name, &dentry_stat, AT_SYMLINK_NOFOLLOW) < 0)
+        return -1;
+
+      if (S_ISREG(dentry_stat.st_mode))
+        type = dentry_type::ENT_REGULAR;
+      else if (S_ISDIR(dentry_stat.st_mode))
+        type = dentry_type::ENT_DIRECTORY;
+      else if (S_ISLNK(dentry_stat.st_mode))
+        type = dentry_type::ENT_SYMLINK;
+      else
+        type = dentry_type::ENT_OTHER;
+      return 1;
+    }
+  }
+
+}
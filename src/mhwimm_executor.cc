@@ -2,12 +2,26 @@
  * Member Method Definitions of mhwimm_executor
  */
 #include "mhwimm_executor.h"
+#include "mhwimm_traverse.h"
+#include "mhwimm_dirscan.h"
+#include "mhwimm_deploy.h"
+#include "mhwimm_dispatch.h"
+#include "mhwimm_path_list.h"
+#include "mhwimm_hash.h"
 
 #include <cstring>
 #include <cstdbool>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
 #include <exception>
-#include <functional>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <numeric>
+#include <unordered_set>
+#include <string_view>
 
 #ifdef DEBUG
 // for debug
@@ -18,12 +32,20 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
-#include <dirent.h>
+#include <sys/sysmacros.h>
+#include <fcntl.h>
+#include <fnmatch.h>
 
 #include <string.h>
 
 namespace mhwimm_executor_ns {
 
+  /* journal_filename - intent journal under mhwimm root */
+  constexpr const char *journal_filename("mhwimm_journal");
+
+  /* update_staged_suffix - changed files are staged with it until UPDATE recorded */
+  constexpr std::string_view update_staged_suffix(".mhwimm-update");
+
 #define ERROR_MSG_MEM "error: Failed to allocate memory."
 #define ERROR_MSG_CHDIR "error: Failed enter the directory."
 #define ERROR_MSG_OPENDIR "error: Failed to open directory."
@@ -37,115 +59,127 @@ namespace mhwimm_executor_ns {
 #define ERROR_MSG_LINK "error: Failed to install mod."
 #define ERROR_MSG_UNINSNMOD "error: Attempt to uninstall an not exist mod."
 #define ERROR_MSG_UNINSTALL "error: Failed to uninstall mod."
+#define ERROR_MSG_UNINSDB "error: Failed to retrieve the records of the mod."
 #define ERROR_MSG_NOMODINS "error: No mod been installed."
 #define ERROR_MSG_MODCONFLICT "error: Mod conflict detected."
+#define ERROR_MSG_ASKCONFLICT "error: Failed to ask DB for conflicts."
+#define ERROR_MSG_JOURNAL "error: Failed to write intent journal."
+#define ERROR_MSG_ARCHIVE "error: Failed to read mod archive."
+#define ERROR_MSG_STORE "error: Failed to ingest mod files into content store."
+#define ERROR_MSG_STOREGC "error: Failed to collect garbage of content store."
+#define ERROR_MSG_UPDNMOD "error: Attempt to update an not installed mod."
+#define ERROR_MSG_UPDATEDIR "error: Mod directory is required by update."
+#define ERROR_MSG_UPDATE "error: Failed to update mod."
+#define ERROR_MSG_RECNMOD "error: Attempt to reconcile an not installed mod."
+#define ERROR_MSG_VERNMOD "error: Attempt to verify an not installed mod."
 
-  /* calculate_key - do sum of characters in a string */
-  static int32_t calculate_key(const char *cmd_str)
-  {
-    if (!cmd_str)
-      return 0;
-    int32_t result(0);
-    while (*cmd_str) {
-      result += *cmd_str++;
-    }
-    return result;
-  }
+  /**
+   * cmd_descriptor - descriptor of a command
+   * @name:           the first word of command line
+   * @cmd:            command registered by parseCMD
+   * @description:    help message
+   */
+  struct cmd_descriptor {
+    std::string_view name;
+    mhwimm_executor_cmd cmd;
+    const char *description;
+  };
+
+  /* cmd_descriptors - all commands,COMMANDS lists them in this order */
+  constexpr cmd_descriptor cmd_descriptors[] = {
+    { "cd", mhwimm_executor_cmd::CD, "cd <path> - change current work directory" },
+    { "pwd", mhwimm_executor_cmd::PWD, "pwd - get current work directory" },
+    { "ls", mhwimm_executor_cmd::LS,
+      "ls [-l] [-s] [--sort=name|size|time] [--filter=<pattern>] - list files under current work direcotry,"
+      "-l long format,-s size in KiB,--filter matches name with shell wildcard" },
+    { "install", mhwimm_executor_cmd::INSTALL,
+      "install <mod name> <mod directory | mod archive - relative path> [link|reflink|copy|store]"
+      " - install mod @mode_name,its files are existed in @mod_direcotry,"
+      "or in .zip/.tar/.tar.gz/.tar.zst archive" },
+    { "uninstall", mhwimm_executor_cmd::UNINSTALL, "unintall <mod name> - unintall mod @mod_name" },
+    { "installed", mhwimm_executor_cmd::INSTALLED, "installed - list the names of installed mods" },
+    { "update", mhwimm_executor_cmd::UPDATE,
+      "update <mod name> <mod directory - relative path> [link|reflink|copy|store]"
+      " - update installed mod @mod_name,only the files added,removed,or changed"
+      " are touched" },
+    { "get_config", mhwimm_executor_cmd::GET_CONFIG, "get_config <config name> - get the value of config" },
+    { "config", mhwimm_executor_cmd::CONFIG,
+      "config <key>=<value> - set config,implemented @userhome @mhwiroot, @mhwimmroot, @nworkers, @deploy" },
+    { "store", mhwimm_executor_cmd::STORE, "store gc - remove the blobs in content store no installed mod refers to" },
+    { "reconcile", mhwimm_executor_cmd::RECONCILE,
+      "reconcile [mod name] - compare the deployed files with the metadata recorded at installing,"
+      "report the files modified,missing,or no longer linked" },
+    { "verify", mhwimm_executor_cmd::VERIFY,
+      "verify [mod name] - hash the deployed files and their sources,compare them with the content"
+      " hashes recorded at installing" },
+    { "exit", mhwimm_executor_cmd::EXIT, "exit - exit application" },
+    { "commands", mhwimm_executor_cmd::COMMANDS, "commands - list commands and print description" },
+    { "help", mhwimm_executor_cmd::HELP, "help - help message,implemented as cmd commands" },
+  };
+
+  constexpr mhwimm_dispatch_ns::perfect_hash_table cmd_table(cmd_descriptors);
+
+  /* config_key - config options can be accessed by get_config/config */
+  enum class config_key : uint8_t {
+    USERHOME,
+    MHWIROOT,
+    MHWIMMROOT,
+    NWORKERS,
+    DEPLOY
+  };
+
+  /* config_descriptor - descriptor of a config option */
+  struct config_descriptor {
+    std::string_view name;
+    config_key key;
+  };
+
+  constexpr config_descriptor config_descriptors[] = {
+    { "userhome", config_key::USERHOME },
+    { "mhwiroot", config_key::MHWIROOT },
+    { "mhwimmroot", config_key::MHWIMMROOT },
+    { "nworkers", config_key::NWORKERS },
+    { "deploy", config_key::DEPLOY },
+  };
+
+  constexpr mhwimm_dispatch_ns::perfect_hash_table config_table(config_descriptors);
 
   /**
    * parseCMD - method to parse command from user input,and registers the
    *            command,stores command parameters in internal data members
    */
-  int mhwimm_executor::parseCMD(const std::string &cmd_string) noexcept
+  int mhwimm_executor::parseCMD(std::string_view cmd_line) noexcept
   {
-
-#define CD_CMD_KEY 199
-#define PWD_CMD_KEY 331
-#define LS_CMD_KEY 223
-#define INSTALL_CMD_KEY 759
-#define UNINSTALL_CMD_KEY 986
-#define INSTALLED_CMD_KEY 960
-#define GET_CONFIG_CMD_KEY 1045
-#define CONFIG_CMD_KEY 630
-#define EXIT_CMD_KEY 442
-#define COMMANDS_CMD_KEY 850
-#define HELP_CMD_KEY 425
-
     current_status_ = mhwimm_executor_status::WORKING;
-    
-    char *cmd_tmp_buf(nullptr);
-    std::size_t buf_length(cmd_string.length() + 1);
 
-    try {
-      cmd_tmp_buf = new char[buf_length];
-    } catch (std::bad_alloc &) {
-      generic_err_msg_output(ERROR_MSG_MEM);
-      current_status_ = mhwimm_executor_status::ERROR;
-      return -1;
+    // words are separated by one or more spaces,the first one is the
+    // command and the others are parameters.
+    nparams_ = 0;
+    bool first(true);
+    for (std::size_t b(0), e(0); b < cmd_line.length(); b = e) {
+      b = cmd_line.find_first_not_of(' ', b);
+      if (b == std::string_view::npos)
+        break;
+      e = cmd_line.find(' ', b);
+      if (e == std::string_view::npos)
+        e = cmd_line.length();
+
+      std::string_view word(cmd_line.substr(b, e - b));
+      if (first) {
+        const cmd_descriptor *d(cmd_table.find(word));
+        setCMD(d ? d->cmd : mhwimm_executor_cmd::NOP);
+        first = false;
+      } else {
+        if (nparams_ < parameters_.size())
+          parameters_[nparams_] = word;
+        ++nparams_;
+      }
     }
 
-    memset(cmd_tmp_buf, 0, buf_length);
-    memcpy(cmd_tmp_buf, cmd_string.c_str(), buf_length - 1);
-
-    // first strtok()
-    const char *arg(strtok(cmd_tmp_buf, " "));
-
-    switch (calculate_key(arg)) {
-    case EXIT_CMD_KEY:
-      setCMD(mhwimm_executor_cmd::EXIT);
-      break;
-    case LS_CMD_KEY:
-      setCMD(mhwimm_executor_cmd::LS);
-      break;
-    case INSTALLED_CMD_KEY:
-      setCMD(mhwimm_executor_cmd::INSTALLED);
-      break;
-    case CD_CMD_KEY:
-      setCMD(mhwimm_executor_cmd::CD);
-      break;
-    case PWD_CMD_KEY:
-      setCMD(mhwimm_executor_cmd::PWD);
-      break;
-    case INSTALL_CMD_KEY:
-      setCMD(mhwimm_executor_cmd::INSTALL);
-      break;
-    case UNINSTALL_CMD_KEY:
-      setCMD(mhwimm_executor_cmd::UNINSTALL);
-      break;
-    case GET_CONFIG_CMD_KEY:
-      setCMD(mhwimm_executor_cmd::GET_CONFIG);
-      break;
-    case CONFIG_CMD_KEY:
-      setCMD(mhwimm_executor_cmd::CONFIG);
-      break;
-    case COMMANDS_CMD_KEY:
-    case HELP_CMD_KEY:
-      setCMD(mhwimm_executor_cmd::COMMANDS);
-      break;
-    default:
+    if (first)
       setCMD(mhwimm_executor_cmd::NOP);
-    }
-
-    nparams_ = 0;
-    // parse the same string via strtok
-    while ((arg = strtok(NULL, " "))) {
-      parameters_[nparams_++] = arg;
-    }
-
-#undef CD_CMD_KEY
-#undef PWD_CMD_KEY
-#undef LS_CMD_KEY
-#undef INSTALL_CMD_KEY
-#undef UNINSTALL_CMD_KEY
-#undef INSTALLED_CMD_KEY
-#undef GET_CONFIG_CMD_KEY
-#undef CONFIG_CMD_KEY
-#undef EXIT_CMD_KEY
-#undef COMMANDS_CMD_KEY
-#undef HELP_CMD_KEY
 
     current_status_ = mhwimm_executor_status::IDLE;
-    delete[] cmd_tmp_buf;
     return 0;
   }
 
@@ -156,12 +190,12 @@ namespace mhwimm_executor_ns {
   int mhwimm_executor::executeCurrentCMD(void) noexcept
   {
 #ifdef DEBUG
-    std::cerr << "last noutput_msgs_ = " << noutput_msgs_ << std::endl;
+    std::cerr << "last output lines = " << output_.lines() << std::endl;
     std::cerr << "last nparams_ = " << nparams_ << std::endl;
 #endif
 
     current_status_ = mhwimm_executor_status::WORKING;
-    noutput_msgs_ = 0;
+    output_.clear();
 
     // call the right command routine with syntax checking
     switch (current_cmd_) {
@@ -185,6 +219,10 @@ namespace mhwimm_executor_ns {
       if (cmd_uninstall_syntaxChecking())
         return uninstall();
       break;
+    case mhwimm_executor_cmd::UPDATE:
+      if (cmd_update_syntaxChecking())
+        return update();
+      break;
     case mhwimm_executor_cmd::INSTALLED:
       if (cmd_installed_syntaxChecking())
         return installed();
@@ -197,6 +235,18 @@ namespace mhwimm_executor_ns {
       if (cmd_config_syntaxChecking())
         return config();
       break;
+    case mhwimm_executor_cmd::STORE:
+      if (cmd_store_syntaxChecking())
+        return store();
+      break;
+    case mhwimm_executor_cmd::RECONCILE:
+      if (cmd_reconcile_syntaxChecking())
+        return reconcile();
+      break;
+    case mhwimm_executor_cmd::VERIFY:
+      if (cmd_verify_syntaxChecking())
+        return verify();
+      break;
     case mhwimm_executor_cmd::EXIT:
       if (cmd_exit_syntaxChecking())
         return exit();
@@ -224,7 +274,7 @@ namespace mhwimm_executor_ns {
   int mhwimm_executor::cd(void) noexcept
   {
     current_status_ = mhwimm_executor_status::WORKING;
-    if (chdir(parameters_[0].c_str()) < 0) {
+    if (chdir(std::string(parameters_[0]).c_str()) < 0) {
       generic_err_msg_output(ERROR_MSG_CHDIR);
       current_status_ = mhwimm_executor_status::ERROR;
       return -1;
@@ -257,51 +307,314 @@ namespace mhwimm_executor_ns {
       generic_err_msg_output(ERROR_MSG_PWD);
       current_status_ = mhwimm_executor_status::ERROR;
     } else {
-      cmd_output_msgs_[0] = cwd;
-      noutput_msgs_ = 1;
-      is_cmd_has_output_ = true;
+      output_.append(cwd);
     }
 
     delete[] cwd;
     return ret;
   }
 
-  /* ls - list files under current work directory */
+  /**
+   * cmd_ls_syntaxChecking - do syntax checking for command "ls",and
+   *                         then store the options in @ls_opts_
+   * # short options can be combined,e.g. "-ls".
+   */
+  bool mhwimm_executor::cmd_ls_syntaxChecking(void)
+  {
+    ls_opts_ = ls_options {
+      .long_format = false,
+      .show_blocks = false,
+      .sort_key = ls_sort_key::LS_SORT_NONE,
+    };
+
+    if (nparams_ > parameters_.size())
+      return false;
+
+    for (std::size_t i(0); i < nparams_; ++i) {
+      std::string_view opt(parameters_[i]);
+      if (opt.starts_with("--sort=")) {
+        opt.remove_prefix(7);
+        if (opt == "name")
+          ls_opts_.sort_key = ls_sort_key::LS_SORT_NAME;
+        else if (opt == "size")
+          ls_opts_.sort_key = ls_sort_key::LS_SORT_SIZE;
+        else if (opt == "time")
+          ls_opts_.sort_key = ls_sort_key::LS_SORT_TIME;
+        else
+          return false;
+      } else if (opt.starts_with("--filter=")) {
+        opt.remove_prefix(9);
+        if (opt.empty())
+          return false;
+        ls_opts_.filter = opt;
+      } else if (opt.length() > 1 && opt[0] == '-') {
+        for (char c : opt.substr(1)) {
+          if (c == 'l')
+            ls_opts_.long_format = true;
+          else if (c == 's')
+            ls_opts_.show_blocks = true;
+          else
+            return false;
+        }
+      } else
+        return false;
+    }
+    return true;
+  }
+
+  /* flushCMDOutput - hand over the lines been stored to @output_sink_ */
+  void mhwimm_executor::flushCMDOutput(void)
+  {
+    if (!output_sink_)
+      return;
+    std::string chunk;
+    while (output_.nextChunk(chunk) == 0)
+      output_sink_(chunk);
+    output_.clear();
+  }
+
+  /**
+   * ls_entry - a directory entry listed by "ls"
+   * @name_off:    offset of the name in the name arena
+   * @name_len:    length of the name
+   * @stated:      whether @stx is valid
+   * @stx:         the metadata needed by the options
+   */
+  struct ls_entry {
+    std::size_t name_off;
+    std::size_t name_len;
+    bool stated;
+    struct {
+      uint16_t mode;
+      uint64_t size;
+      uint64_t blocks;
+      int64_t mtime_sec;
+      uint32_t mtime_nsec;
+    } stx;
+  };
+
+  /**
+   * ls_stat_entries - retrieve the metadata of @entries relative to @dirfd
+   * # the entries are divided into chunks and stated on the workers if
+   *   there are many of them.
+   */
+  static void ls_stat_entries(int dirfd, const std::string &names, std::vector<ls_entry> &entries,
+                              mhwimm_thread_pool_ns::work_stealing_pool *pool)
+  {
+    constexpr std::size_t chunk_size(256);
+
+    auto stat_range = [dirfd, &names, &entries](std::size_t begin, std::size_t end) {
+                        for (std::size_t i(begin); i < end; ++i) {
+                          auto &e(entries[i]);
+                          struct statx stx;
+                          // names are separated by '\0' in the arena.
+                          e.stated = statx(dirfd, names.c_str() + e.name_off,
+                                           AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC,
+                                           STATX_TYPE | STATX_MODE | STATX_SIZE |
+                                           STATX_BLOCKS | STATX_MTIME, &stx) == 0;
+                          if (!e.stated)
+                            continue;
+                          e.stx.mode = stx.stx_mode;
+                          e.stx.size = stx.stx_size;
+                          e.stx.blocks = stx.stx_blocks;
+                          e.stx.mtime_sec = stx.stx_mtime.tv_sec;
+                          e.stx.mtime_nsec = stx.stx_mtime.tv_nsec;
+                        }
+                      };
+
+    if (!pool || entries.size() <= chunk_size) {
+      stat_range(0, entries.size());
+      return;
+    }
+
+    for (std::size_t begin(0); begin < entries.size(); begin += chunk_size) {
+      std::size_t end(std::min(begin + chunk_size, entries.size()));
+      pool->submit([&stat_range, begin, end](void) -> void { stat_range(begin, end); });
+    }
+    pool->wait();
+  }
+
+  /* ls_format_entry - place the line of @e in @line as @opts requires */
+  static void ls_format_entry(const ls_entry &e, std::string_view name,
+                              const ls_options &opts, std::string &line)
+  {
+    char field[64] = {0};
+
+    line.clear();
+    if (opts.show_blocks) {
+      if (e.stated)
+        snprintf(field, sizeof(field), "%8llu ",
+                 static_cast<unsigned long long>(e.stx.blocks / 2));
+      else
+        snprintf(field, sizeof(field), "%8s ", "?");
+      line.append(field);
+    }
+
+    if (opts.long_format) {
+      if (e.stated) {
+        mode_t m(e.stx.mode);
+        char type('?');
+        if (S_ISREG(m)) type = '-';
+        else if (S_ISDIR(m)) type = 'd';
+        else if (S_ISLNK(m)) type = 'l';
+        else if (S_ISFIFO(m)) type = 'p';
+        else if (S_ISSOCK(m)) type = 's';
+        else if (S_ISCHR(m)) type = 'c';
+        else if (S_ISBLK(m)) type = 'b';
+
+        const char perm[] = "rwxrwxrwx";
+        line.push_back(type);
+        for (int i(0); i < 9; ++i)
+          line.push_back(m & (0400 >> i) ? perm[i] : '-');
+
+        snprintf(field, sizeof(field), " %12llu ", static_cast<unsigned long long>(e.stx.size));
+        line.append(field);
+
+        struct tm tm_mtime = {0};
+        time_t mtime(static_cast<time_t>(e.stx.mtime_sec));
+        if (localtime_r(&mtime, &tm_mtime) &&
+            strftime(field, sizeof(field), "%Y-%m-%d %H:%M ", &tm_mtime) > 0)
+          line.append(field);
+        else
+          line.append("?                ");
+      } else
+        line.append("?????????? ");
+    }
+
+    line.append(name);
+  }
+
+  /**
+   * ls - list the entries of current work directory
+   * # the entries are read in batches,without sorting,each batch is
+   *   stated,formatted and flushed to UI before reading the next,thus
+   *   memory is bounded by the batch.
+   * # with sorting,all entries are kept and then flushed in order.
+   */
   int mhwimm_executor::ls(void) noexcept
   {
+    constexpr std::size_t batch_size(4096);
+
     current_status_ = mhwimm_executor_status::WORKING;
 
-    // open current work directory
-    DIR *this_dir(NULL);
-    if (!(this_dir = opendir("."))) {
+    const ls_options &opts(ls_opts_);
+    bool sorting(opts.sort_key != ls_sort_key::LS_SORT_NONE);
+    bool need_stat(opts.long_format || opts.show_blocks ||
+                   opts.sort_key == ls_sort_key::LS_SORT_SIZE ||
+                   opts.sort_key == ls_sort_key::LS_SORT_TIME);
+    std::string filter(opts.filter);
+
+    // open current work directory,"." and ".." are listed as well.
+    mhwimm_dirscan_ns::dir_scanner scanner;
+    if (scanner.open(AT_FDCWD, ".", false) < 0) {
       generic_err_msg_output(ERROR_MSG_OPENDIR);
       current_status_ = mhwimm_executor_status::ERROR;
       return -1;
     }
 
-    struct dirent *dentry(NULL);
+    // names are stored back to back,each ends with '\0'.
+    std::string names;
+    std::vector<ls_entry> entries;
+    std::vector<std::size_t> order;
+    std::string line;
+    int ret(0);
+    bool nomem(false);
 
-#ifdef DEBUG
-    int ndentries(0);
-#endif
-
-    while ((dentry = readdir(this_dir))) {
+    try {
+      auto flush_entries = [&](void) {
+                             if (need_stat)
+                               ls_stat_entries(scanner.fd(), names, entries,
+                                               entries.size() > 1 ? &workerPool() : nullptr);
+
+                             order.resize(entries.size());
+                             for (std::size_t i(0); i < order.size(); ++i)
+                               order[i] = i;
+                             auto name_of = [&names, &entries](std::size_t i) {
+                                              return std::string_view(names.data() + entries[i].name_off,
+                                                                      entries[i].name_len);
+                                            };
+
+                             switch (opts.sort_key) {
+                             case ls_sort_key::LS_SORT_NAME:
+                               std::sort(order.begin(), order.end(),
+                                         [&name_of](std::size_t a, std::size_t b) {
+                                           return name_of(a) < name_of(b);
+                                         });
+                               break;
+                             case ls_sort_key::LS_SORT_SIZE:
+                               std::sort(order.begin(), order.end(),
+                                         [&name_of, &entries](std::size_t a, std::size_t b) {
+                                           uint64_t sa(entries[a].stated ? entries[a].stx.size : 0);
+                                           uint64_t sb(entries[b].stated ? entries[b].stx.size : 0);
+                                           return sa != sb ? sa > sb : name_of(a) < name_of(b);
+                                         });
+                               break;
+                             case ls_sort_key::LS_SORT_TIME:
+                               std::sort(order.begin(), order.end(),
+                                         [&name_of, &entries](std::size_t a, std::size_t b) {
+                                           const auto &x(entries[a].stx), &y(entries[b].stx);
+                                           int64_t ta(entries[a].stated ? x.mtime_sec : 0);
+                                           int64_t tb(entries[b].stated ? y.mtime_sec : 0);
+                                           uint32_t na(entries[a].stated ? x.mtime_nsec : 0);
+                                           uint32_t nb(entries[b].stated ? y.mtime_nsec : 0);
+                                           if (ta != tb)
+                                             return ta > tb;
+                                           if (na != nb)
+                                             return na > nb;
+                                           return name_of(a) < name_of(b);
+                                         });
+                               break;
+                             case ls_sort_key::LS_SORT_NONE:
+                               // directory order
+                               break;
+                             }
+
+                             for (std::size_t i : order) {
+                               if (need_stat)
+                                 ls_format_entry(entries[i], name_of(i), opts, line);
+                               output_.append(need_stat ? std::string_view(line) : name_of(i));
+                               if (output_.bytes() >= mhwimm_output_ns::OUTPUT_CHUNK_SIZE)
+                                 flushCMDOutput();
+                             }
+                             names.clear();
+                             entries.clear();
+                           };
+
+      const char *dentry_name(nullptr);
+      mhwimm_dirscan_ns::dentry_type dentry_type;
+
+      while ((ret = scanner.next(dentry_name, dentry_type)) > 0) {
+        if (!filter.empty() && fnmatch(filter.c_str(), dentry_name, 0) != 0)
+          continue;
 
-#ifdef DEBUG
-      ++ndentries;
-#endif
+        std::size_t len(strlen(dentry_name));
+        entries.push_back(ls_entry {
+            .name_off = names.length(),
+            .name_len = len,
+            .stated = false,
+          });
+        names.append(dentry_name, len + 1);
 
-      rs_vec_if_necessary(cmd_output_msgs_, noutput_msgs_);
-      cmd_output_msgs_[noutput_msgs_++] = std::string{dentry->d_name};
+        if (!sorting && entries.size() == batch_size)
+          flush_entries();
+      }
+      flush_entries();
+    } catch (std::bad_alloc &) {
+      nomem = true;
     }
-    (void)closedir(this_dir);
+    scanner.close();
 
 #ifdef DEBUG
-    std::cerr << "number of dentries : " << ndentries << std::endl;
+    std::cerr << "ls : listed " << output_.lines() << " lines at last" << std::endl;
 #endif
 
+    if (nomem || ret < 0) {
+      generic_err_msg_output(nomem ? ERROR_MSG_MEM : ERROR_MSG_OPENDIR);
+      current_status_ = mhwimm_executor_status::ERROR;
+      return -1;
+    }
+
     current_status_ = mhwimm_executor_status::IDLE;
-    is_cmd_has_output_ = true;
     return 0;
   }
 
@@ -320,33 +633,36 @@ namespace mhwimm_executor_ns {
   /* get_config - get the value of a config option */
   int mhwimm_executor::get_config(void) noexcept
   {
-#define CONFIG_USERHOME 616
-#define CONFIG_MHWIROOT 633
-#define CONFIG_MHWIMMROOT 787
-
     current_status_ = mhwimm_executor_status::WORKING;
-    const auto &key(parameters_[0]);
+    std::string_view key(parameters_[0]);
     typename mhwimm_config_ns::get_config_traits<mhwimm_config_ns::config_t>::skey_t s;
 
-    switch (calculate_key(key.c_str())) {
-    case CONFIG_USERHOME:
+    const config_descriptor *d(config_table.find(key));
+    if (!d) {
+      generic_err_msg_output(ERROR_MSG_UNKNOWNCONF);
+      current_status_ = mhwimm_executor_status::ERROR;
+      return -1;
+    }
+
+    switch (d->key) {
+    case config_key::USERHOME:
       s = conf_->userhome;
       break;
-    case CONFIG_MHWIROOT:
+    case config_key::MHWIROOT:
       s = conf_->mhwiroot;
       break;
-    case CONFIG_MHWIMMROOT:
+    case config_key::MHWIMMROOT:
       s = conf_->mhwimmroot;
       break;
-    default:
-      generic_err_msg_output(ERROR_MSG_UNKNOWNCONF);
-      current_status_ = mhwimm_executor_status::ERROR;
-      return -1;
+    case config_key::NWORKERS:
+      s = std::to_string(conf_->nworkers);
+      break;
+    case config_key::DEPLOY:
+      s = conf_->deploy;
+      break;
     }
     
-    cmd_output_msgs_[0] = s;
-    noutput_msgs_ = 1;
-    is_cmd_has_output_ = true;
+    output_.append(s);
     current_status_ = mhwimm_executor_status::IDLE;
     return 0;
   }
@@ -357,37 +673,236 @@ namespace mhwimm_executor_ns {
 
     current_status_ = mhwimm_executor_status::WORKING;
 
-    const auto &key(parameters_[0]);
-    const auto &val(parameters_[1]);
+    std::string_view key(parameters_[0]);
+    std::string val(parameters_[1]);
+
+    const config_descriptor *d(config_table.find(key));
+    if (!d) {
+      generic_err_msg_output(ERROR_MSG_UNKNOWNCONF);
+      current_status_ = mhwimm_executor_status::ERROR;
+      return -1;
+    }
 
-    switch (calculate_key(key.c_str())) {
-    case CONFIG_USERHOME:
+    switch (d->key) {
+    case config_key::USERHOME:
       conf_->userhome = static_cast<typename
                                     mhwimm_config_ns::get_config_traits<
                                       mhwimm_config_ns::config_t>::skey_t>(val);
       break;
-    case CONFIG_MHWIROOT:
+    case config_key::MHWIROOT:
       conf_->mhwiroot = static_cast<typename
                                     mhwimm_config_ns::get_config_traits<
                                       mhwimm_config_ns::config_t>::skey_t>(val);
       break;
-    case CONFIG_MHWIMMROOT:
+    case config_key::MHWIMMROOT:
       conf_->mhwimmroot = static_cast<typename
                                        mhwimm_config_ns::get_config_traits<
                                          mhwimm_config_ns::config_t>::skey_t>(val);
       break;
-    default:
-      generic_err_msg_output(ERROR_MSG_UNKNOWNCONF);
-      current_status_ = mhwimm_executor_status::ERROR;
-      return -1;
+    case config_key::NWORKERS:
+      {
+        char *endp(nullptr);
+        long n(strtol(val.c_str(), &endp, 10));
+        if (val.empty() || *endp || n < 0 || n > 1024) {
+          generic_err_msg_output(ERROR_MSG_ERRFORM);
+          current_status_ = mhwimm_executor_status::ERROR;
+          return -1;
+        }
+        conf_->nworkers = static_cast<typename
+                                      mhwimm_config_ns::get_config_traits<
+                                        mhwimm_config_ns::config_t>::nkey_t>(n);
+      }
+      break;
+    case config_key::DEPLOY:
+      {
+        mhwimm_deploy_ns::deploy_strategy strategy;
+        if (mhwimm_deploy_ns::parse_deploy_strategy(val, strategy) < 0) {
+          generic_err_msg_output(ERROR_MSG_ERRFORM);
+          current_status_ = mhwimm_executor_status::ERROR;
+          return -1;
+        }
+        conf_->deploy = static_cast<typename
+                                    mhwimm_config_ns::get_config_traits<
+                                      mhwimm_config_ns::config_t>::skey_t>(val);
+      }
+      break;
     }
 
     current_status_ = mhwimm_executor_status::IDLE;
     return 0;
 
-#undef CONFIG_USERHOME
-#undef CONFIG_MHWIROOT
-#undef CONFIG_MHWIMMROOT
+  }
+
+  /**
+   * current_dir - the current work directory,no matter how long it is
+   * return:       0 OR -1,errno is set
+   */
+  static int current_dir(std::string &cwd)
+  {
+    char *path(getcwd(nullptr, 0));
+    if (!path)
+      return -1;
+    cwd.assign(path);
+    free(path);
+    return 0;
+  }
+
+  /**
+   * stat_file_metas - retrieve the metadata of @paths relative to @dirfd
+   * @paths:           paths start with "/"
+   * @metas:           where to store the metadata in the same order,inode
+   *                   is 0 if the path could not be stated
+   * @errs:            where to store errno of each path,0 if succeed,
+   *                   nullptr if it is not cared
+   * @pool:            the paths are stated in chunks by the workers
+   */
+  static void stat_file_metas(int dirfd, const mhwimm_path_list_ns::path_list &paths,
+                              std::vector<mhwimm_db_ns::db_file_meta> &metas,
+                              std::vector<int> *errs,
+                              mhwimm_thread_pool_ns::work_stealing_pool *pool)
+  {
+    constexpr std::size_t chunk_size(256);
+
+    metas.assign(paths.size(), mhwimm_db_ns::db_file_meta {});
+    if (errs)
+      errs->assign(paths.size(), 0);
+
+    auto stat_range = [dirfd, &paths, &metas, errs](std::size_t begin, std::size_t end) {
+                        for (std::size_t i(begin); i < end; ++i) {
+                          struct statx stx;
+                          if (statx(dirfd, paths.c_str(i) + 1,
+                                    AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC,
+                                    STATX_INO | STATX_SIZE | STATX_MTIME | STATX_NLINK,
+                                    &stx) < 0) {
+                            if (errs)
+                              (*errs)[i] = errno;
+                            continue;
+                          }
+                          metas[i].inode = stx.stx_ino;
+                          metas[i].size = stx.stx_size;
+                          metas[i].mtime_ns = static_cast<int64_t>(stx.stx_mtime.tv_sec) * 1000000000 +
+                            stx.stx_mtime.tv_nsec;
+                          metas[i].nlink = stx.stx_nlink;
+                        }
+                      };
+
+    if (!pool || paths.size() <= chunk_size) {
+      stat_range(0, paths.size());
+      return;
+    }
+
+    for (std::size_t begin(0); begin < paths.size(); begin += chunk_size) {
+      std::size_t end(std::min(begin + chunk_size, paths.size()));
+      pool->submit([&stat_range, begin, end](void) -> void { stat_range(begin, end); });
+    }
+    pool->wait();
+  }
+
+  /**
+   * hash_file_at - content key of the file @path relative to @dirfd
+   * @key:          where to store the key
+   * @st:           where to store the status of the opened file,nullptr
+   *                if not cared
+   * @nbytes:       where to add the number of bytes read,nullptr if not
+   *                cared
+   * return:        0 OR errno
+   */
+  static int hash_file_at(int dirfd, const char *path, std::string &key, struct stat *st,
+                          std::atomic<uint64_t> *nbytes)
+  {
+    int fd(openat(dirfd, path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW));
+    if (fd < 0)
+      return errno;
+    int ret(0);
+    uint64_t digest(0), size(0);
+    if (st && fstat(fd, st) < 0)
+      ret = errno;
+    else if ((ret = -mhwimm_hash_ns::hash_fd(fd, digest, size)) == 0)
+      key = mhwimm_hash_ns::content_key(digest, size);
+    (void)close(fd);
+    if (nbytes)
+      nbytes->fetch_add(size, std::memory_order_relaxed);
+    return ret;
+  }
+
+  /**
+   * hash_file_keys - content keys of @paths relative to @dirfd
+   * @paths:          paths start with "/"
+   * @keys:           where to store the keys in the same order,the key
+   *                  is empty if the file could not be read
+   * @pool:           the files are hashed by the workers in parallel
+   */
+  static void hash_file_keys(int dirfd, const mhwimm_path_list_ns::path_list &paths,
+                             mhwimm_path_list_ns::path_list &keys,
+                             mhwimm_thread_pool_ns::work_stealing_pool &pool)
+  {
+    std::vector<std::string> tmp(paths.size());
+    for (std::size_t i(0); i < paths.size(); ++i)
+      pool.submit([dirfd, &paths, &tmp, i](void) -> void {
+                    (void)hash_file_at(dirfd, paths.c_str(i) + 1, tmp[i], nullptr, nullptr);
+                  });
+    pool.wait();
+
+    keys.clear();
+    keys.reserve(tmp.size(), tmp.size() * 32);
+    for (const auto &k : tmp)
+      keys.push_back(k);
+  }
+
+  /**
+   * makeup_depth_batches - group @paths by depth,one batch for each depth
+   * @paths:                paths start with "/",e.g. "/nativePC/a.tex"
+   * @type:                 operation type
+   * return:                batches ordered by depth ascending
+   * # operations in one batch never depend on each other,
+   *   they refer to the strings in @paths.
+   */
+  static std::vector<std::vector<mhwimm_fsbatch_ns::fs_op>>
+  makeup_depth_batches(const mhwimm_path_list_ns::path_list &paths,
+                       mhwimm_fsbatch_ns::fs_op_type type)
+  {
+    std::vector<std::vector<mhwimm_fsbatch_ns::fs_op>> batches;
+    for (std::string_view path : paths) {
+      std::size_t depth(std::count(path.cbegin(), path.cend(), '/'));
+      if (batches.size() < depth)
+        batches.resize(depth);
+      batches[depth - 1].push_back(mhwimm_fsbatch_ns::fs_op {
+          .type = type,
+          .path = path.data() + 1,
+          .src = nullptr,
+          .result = mhwimm_fsbatch_ns::fs_op_pending,
+        });
+    }
+    return batches;
+  }
+
+  /**
+   * diff_sorted_paths - walk sorted @from and @to together
+   * @only_from:         called with the paths only in @from
+   * @only_to:           called with the paths only in @to
+   * @both:              called with the paths in both
+   */
+  template<typename _OnlyFrom, typename _OnlyTo, typename _Both>
+  static void diff_sorted_paths(const mhwimm_path_list_ns::path_list &from,
+                                const mhwimm_path_list_ns::path_list &to,
+                                _OnlyFrom &&only_from, _OnlyTo &&only_to, _Both &&both)
+  {
+    auto f(from.cbegin()), t(to.cbegin());
+    while (f != from.cend() && t != to.cend()) {
+      int cmp((*f).compare(*t));
+      if (cmp < 0)
+        only_from(*f++);
+      else if (cmp > 0)
+        only_to(*t++);
+      else {
+        both(*t++);
+        ++f;
+      }
+    }
+    for (; f != from.cend(); ++f)
+      only_from(*f);
+    for (; t != to.cend(); ++t)
+      only_to(*t);
   }
 
   /**
@@ -402,69 +917,31 @@ namespace mhwimm_executor_ns {
     std::string modname(parameters_[0]);
     std::string moddir(parameters_[1]);
 
-    /**
-     * lf_traverse_dir - local function used to traverse the directory and makeup mod file list
-     * @moddir:          name of the mod directory,relative path to current work directory
-     * @subpath:         path for next sub directory the mod to recursive traversing
-     * return:           0 OR -1
-     * # front-inserting
-     */
-    std::function<int(const std::string &, const std::string &)> lf_traverse_dir =
-      [&, this](const std::string &moddir, const std::string &subpath) -> int {
-      std::string opendir_path(moddir + "/" + subpath);
-
-      DIR *this_dir = opendir(opendir_path.c_str());
-      if (!this_dir) {
-        generic_err_msg_output(ERROR_MSG_OPENDIR);
-        return -1;
-      }
-
-      int ret(0);
-
-      while (struct dirent *dentry = readdir(this_dir)) {
-        // skip this dir and parent dir
-        switch (strlen(dentry->d_name)) {
-        case 1:
-          if (!strncmp(".", dentry->d_name, 1))
-            continue;
-        case 2:
-          if (!strncmp("..", dentry->d_name, 2))
-            continue;
-        }
-        
-        /**
-         * append dentry->d_name to @parent_dir.
-         */
-
-        std::string dentry_path(opendir_path + "/" + dentry->d_name);
-        std::string dentry_subpath(subpath + "/" + dentry->d_name);
-        struct stat dentry_stat = {0};
-
-        if (stat(dentry_path.c_str(), &dentry_stat) < 0) {
-          ret = -1;
-          break;
-        } else if (dentry_stat.st_mode & S_IFDIR) {
-          mfiles_list_->directory_list.insert(mfiles_list_->directory_list.end(), dentry_subpath);
-          ret = lf_traverse_dir(moddir, dentry_subpath);
-          if (ret) // returned -1
-            return ret;
-        } else if (dentry_stat.st_mode & S_IFREG) {
-          mfiles_list_->regular_file_list.insert(mfiles_list_->regular_file_list.end(),
-                                                 dentry_subpath);
-        } else if (dentry_stat.st_mode & S_IFLNK) // skip symlink
-          continue;
-      }
+    // mod archive is decoded straight into mhwi root,no extracted
+    // tree is needed.
+    mhwimm_archive_ns::archive_reader archive;
+    struct stat moddir_stat = {0};
+    bool from_archive(stat(moddir.c_str(), &moddir_stat) == 0 && S_ISREG(moddir_stat.st_mode));
 
-      (void)closedir(this_dir);
-      return ret;
-    };
-
-    // now we have to traverse the mod directory to makeup file list
+    // now we have to traverse the mod directory to makeup file list,
+    // subdirectories are scanned by the workers in parallel.
     std::unique_lock<decltype(mfiles_list_->lock)> mfl_lock(mfiles_list_->lock);
     mfiles_list_->regular_file_list.clear();
     mfiles_list_->directory_list.clear();
-
-    if (lf_traverse_dir(moddir, std::string{"\0"}) < 0) {
+    mfiles_list_->content_hash_list.clear();
+    mfiles_list_->file_meta_list.clear();
+    mfiles_list_->deployed_hash_list.clear();
+
+    if (from_archive) {
+      if (archive.open(moddir) < 0 ||
+          archive.list(mfiles_list_->directory_list, mfiles_list_->regular_file_list) < 0) {
+        generic_err_msg_output(ERROR_MSG_ARCHIVE);
+        current_status_ = mhwimm_executor_status::ERROR;
+        return -1;
+      }
+    } else if (mhwimm_traverse_ns::parallel_traverse(moddir, workerPool(),
+                                                     mfiles_list_->directory_list,
+                                                     mfiles_list_->regular_file_list) < 0) {
       generic_err_msg_output(ERROR_MSG_TRAVERSE_DIR);
       current_status_ = mhwimm_executor_status::ERROR;
       return -1;
@@ -474,103 +951,309 @@ namespace mhwimm_executor_ns {
 
 #ifdef DEBUG
     std::cerr << "Debug : " << std::endl;
-    for (auto i : mfiles_list_->directory_list)
+    for (std::string_view i : mfiles_list_->directory_list)
       std::cerr << " dentry: " << i << std::endl;
-    for (auto i : mfiles_list_->regular_file_list)
+    for (std::string_view i : mfiles_list_->regular_file_list)
       std::cerr << " dentry: " << i << std::endl;
 #endif
 
-    char path_tmp[256] = {0};
-    std::string cwd(getcwd(path_tmp, 256));
+    std::string cwd;
+    if (current_dir(cwd) < 0) {
+      generic_err_msg_output(ERROR_MSG_PWD);
+      current_status_ = mhwimm_executor_status::ERROR;
+      return -1;
+    }
     struct stat mhwiroot_stat = {0};
-
-    if (stat(mhwiroot.c_str(), &mhwiroot_stat) < 0) {
+    std::vector<std::vector<mhwimm_fsbatch_ns::fs_op>> dir_batches;
+    std::vector<std::string> link_srcs;
+    std::vector<std::string> blob_paths;
+    std::vector<mhwimm_fsbatch_ns::fs_op> link_ops;
+    std::vector<mhwimm_fsbatch_ns::fs_op> copy_ops;
+    // opens the gate of the records queued before deploying,
+    // the records are discarded if it is destroyed without a value.
+    std::promise<bool> deployed;
+
+    // the strategy of the mod overrides the default one in config
+    mhwimm_deploy_ns::deploy_strategy strategy(mhwimm_deploy_ns::deploy_strategy::DEPLOY_LINK);
+    if (mhwimm_deploy_ns::parse_deploy_strategy(nparams_ == 3 ? parameters_[2] :
+                                                std::string_view(conf_->deploy),
+                                                strategy) < 0)
+      strategy = mhwimm_deploy_ns::deploy_strategy::DEPLOY_LINK;
+
+    int mhwiroot_fd(open(mhwiroot.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (mhwiroot_fd < 0 || fstat(mhwiroot_fd, &mhwiroot_stat) < 0) {
       generic_err_msg_output(ERROR_MSG_STATPATH);
       goto err_exit;
     }
 
     // conflicting checking
-    for (auto i : mfiles_list_->regular_file_list) {
-      std::string newpath(mhwiroot + i);
-      struct stat s = {0};
-      if (stat(newpath.c_str(), &s) == 0) {
-        generic_err_msg_output(ERROR_MSG_MODCONFLICT);
+    // database joins the file list against the files of installed mods,
+    // the files existed but not recorded will be detected by link().
+    if (conflict_query_) {
+      mfiles_list_->conflict_list.clear();
+      mfl_lock.unlock();
+      int ret(conflict_query_());
+      mfl_lock.lock();
+      if (ret < 0) {
+        generic_err_msg_output(ERROR_MSG_ASKCONFLICT);
+        goto err_exit;
+      }
+      if (!mfiles_list_->conflict_list.empty()) {
+        conflicts_err_msg_output();
         goto err_exit;
       }
     }
 
-    // mkdirs
-    for (auto i : mfiles_list_->directory_list) {
-      std::string newpath(mhwiroot + i);
+    // every batch is recorded in journal before it is executed,
+    // the journal is committed by thread worker after DB recorded
+    // the mod.
+    if (journal_.begin(journalPath(), mhwimm_journal_ns::journal_cmd::JOURNAL_INSTALL,
+                       modname, mhwiroot, cwd + "/" + moddir) < 0) {
+      generic_err_msg_output(ERROR_MSG_JOURNAL);
+      goto err_exit;
+    }
 
+    // mkdirs
+    // directories are made level by level,parents always before children.
+    dir_batches = makeup_depth_batches(mfiles_list_->directory_list,
+                                       mhwimm_fsbatch_ns::fs_op_type::FS_MKDIR);
+    for (auto &batch : dir_batches) {
+      std::size_t nfailed(0);
+      if (journaledExecute(mhwiroot_fd, batch, mhwiroot_stat.st_mode, nfailed) < 0) {
+        generic_err_msg_output(ERROR_MSG_JOURNAL);
+        goto err_exit_remove_dir;
+      }
+      if (!nfailed)
+        continue;
+      for (const auto &op : batch)
+        if (op.result && op.result != -EEXIST) {
 #ifdef DEBUG
-      errno = 0;
-#endif
-      if (mkdir(newpath.c_str(), mhwiroot_stat.st_mode) < 0) {
-        if (errno != EEXIST) {
-#ifdef DEBUG
-          std::cerr << strerror(errno) << std::endl;
+          std::cerr << strerror(-op.result) << std::endl;
 #endif
           generic_err_msg_output(ERROR_MSG_MKDIR);
           goto err_exit_remove_dir;
         }
+    }
+
+    // the files are linked from their blobs if the strategy is STORE,
+    // mod archive is extracted into staging of the store at first.
+    if (strategy == mhwimm_deploy_ns::deploy_strategy::DEPLOY_STORE) {
+      if (ingestModFiles(moddir, from_archive ? &archive : nullptr, blob_paths) < 0) {
+        generic_err_msg_output(ERROR_MSG_STORE);
+        goto err_exit_remove_dir;
       }
     }
 
-    // link regular files
-    for (auto i : mfiles_list_->regular_file_list) {
-      std::string oldpath(cwd + "/" + moddir + i);
-      std::string newpath(mhwiroot + i);
+    // the lists are complete,DB records them while we deploy the files.
+    // "verify" compares the files with the source recorded.
+    mfiles_list_->mod_source = cwd + "/" + moddir;
+    if (record_submit_)
+      pending_record_ = record_submit_(deployed.get_future().share());
+
+    if (strategy != mhwimm_deploy_ns::deploy_strategy::DEPLOY_STORE && from_archive) {
+      // deploy regular files
+      // entries of mod archive are written by the reader,the strategy
+      // is meaningless for them.
+      for (std::string_view i : mfiles_list_->regular_file_list)
+        copy_ops.push_back(mhwimm_fsbatch_ns::fs_op {
+            .type = mhwimm_fsbatch_ns::fs_op_type::FS_EXTRACT,
+            .path = i.data() + 1,
+            .src = nullptr,
+            .result = mhwimm_fsbatch_ns::fs_op_pending,
+          });
+
+      std::size_t nfailed(0);
+      if (journaledExecute(copy_ops, nfailed,
+                           [this, &archive, mhwiroot_fd](mhwimm_fsbatch_ns::fs_op *ops,
+                                                         std::size_t nops) -> std::size_t {
+                             return archive.extract(mhwiroot_fd, ops, nops, workerPool());
+                           }) < 0) {
+        generic_err_msg_output(ERROR_MSG_JOURNAL);
+        goto err_exit_remove_dir;
+      }
+      goto check_deployed;
+    }
 
+    // @link_srcs never reallocate,the operations refer to its elements.
+    // files can not be linked are handed over to the copier,their link
+    // operations are reset to pending.
+    if (strategy == mhwimm_deploy_ns::deploy_strategy::DEPLOY_STORE) {
+      link_srcs.swap(blob_paths);
+    } else {
+      link_srcs.reserve(mfiles_list_->regular_file_list.size());
+      std::string src_root(cwd + "/" + moddir);
+      for (std::string_view i : mfiles_list_->regular_file_list)
+        link_srcs.push_back(std::string(src_root).append(i));
+    }
+
+    {
+      bool link_first(strategy == mhwimm_deploy_ns::deploy_strategy::DEPLOY_LINK ||
+                      strategy == mhwimm_deploy_ns::deploy_strategy::DEPLOY_STORE);
+      auto src(link_srcs.cbegin());
+      for (std::string_view i : mfiles_list_->regular_file_list)
+        (link_first ? link_ops : copy_ops).push_back(mhwimm_fsbatch_ns::fs_op {
+            .type = link_first ?
+              mhwimm_fsbatch_ns::fs_op_type::FS_LINK : mhwimm_fsbatch_ns::fs_op_type::FS_COPY,
+            .path = i.data() + 1,
+            .src = (src++)->c_str(),
+            .result = mhwimm_fsbatch_ns::fs_op_pending,
+          });
+    }
+
+    {
+      std::size_t nfailed(0);
+      if (journaledExecute(mhwiroot_fd, link_ops, 0, nfailed) < 0) {
+        generic_err_msg_output(ERROR_MSG_JOURNAL);
+        goto err_exit_remove_dir;
+      }
+      for (auto &op : link_ops)
+        if (op.result < 0 && mhwimm_deploy_ns::should_fallback(-op.result)) {
+          copy_ops.push_back(mhwimm_fsbatch_ns::fs_op {
+              .type = mhwimm_fsbatch_ns::fs_op_type::FS_COPY,
+              .path = op.path,
+              .src = op.src,
+              .result = mhwimm_fsbatch_ns::fs_op_pending,
+            });
+          op.result = mhwimm_fsbatch_ns::fs_op_pending;
+        }
+
+      if (journaledExecute(mhwiroot_fd, copy_ops, 0, nfailed, strategy) < 0) {
+        generic_err_msg_output(ERROR_MSG_JOURNAL);
+        goto err_exit_unlink_file;
+      }
+    }
+
+  check_deployed:
+    {
+      // the deployment is failed if any file neither linked nor copied
+      bool deploy_err(false);
+      auto check_result = [this, &deploy_err](const mhwimm_fsbatch_ns::fs_op &op) -> void {
+        if (op.result == -EEXIST) {
+          // the file is not managed by us
+          mfiles_list_->conflict_list.push_back(mhwimm_db_ns::db_conflict {
+              .file_path = std::string{"/"} + op.path,
+            });
+        } else if (op.result) {
 #ifdef DEBUG
-      errno = 0;
-#endif
-      if (link(oldpath.c_str(), newpath.c_str()) < 0) {
-#ifdef DEBUG
-        std::cerr << strerror(errno) << std::endl;
+          std::cerr << strerror(-op.result) << std::endl;
 #endif
-        generic_err_msg_output(ERROR_MSG_LINK);
+          deploy_err = true;
+        }
+      };
+
+      for (const auto &op : link_ops)
+        if (op.result != mhwimm_fsbatch_ns::fs_op_pending)
+          check_result(op);
+      for (const auto &op : copy_ops)
+        check_result(op);
+
+      if (deploy_err || !mfiles_list_->conflict_list.empty()) {
+        if (deploy_err)
+          generic_err_msg_output(ERROR_MSG_LINK);
+        else
+          conflicts_err_msg_output();
         goto err_exit_unlink_file;
       }
     }
 
+    // the metadata is recorded with the files,"reconcile" compares
+    // the files against it later.
+    stat_file_metas(mhwiroot_fd, mfiles_list_->regular_file_list,
+                    mfiles_list_->file_meta_list, nullptr, &workerPool());
+    deployed.set_value(true);
+
+    // and "verify" compares the content,the blobs were hashed by ingesting.
+    // the files are read while DB commits the records,the hashes are
+    // handed to DB after that,and recorded by thread worker on their own.
+    if (strategy != mhwimm_deploy_ns::deploy_strategy::DEPLOY_STORE) {
+      mhwimm_path_list_ns::path_list hashes;
+      hash_file_keys(mhwiroot_fd, mfiles_list_->regular_file_list, hashes, workerPool());
+      if (pending_record_.valid())
+        pending_record_.wait();
+      mfiles_list_->deployed_hash_list.swap(hashes);
+    }
+
+    (void)close(mhwiroot_fd);
     current_status_ = mhwimm_executor_status::IDLE;
     return 0;
 
   err_exit_unlink_file:
-    for (auto i : mfiles_list_->regular_file_list)
-      unlink((mhwiroot + i).c_str());
+    // only the files linked or copied by us can be removed,
+    // the others might belong to the game.
+    {
+      std::vector<mhwimm_fsbatch_ns::fs_op> unlink_ops;
+      for (const auto *ops : { &link_ops, &copy_ops })
+        for (const auto &op : *ops)
+          if (!op.result)
+            unlink_ops.push_back(mhwimm_fsbatch_ns::fs_op {
+                .type = mhwimm_fsbatch_ns::fs_op_type::FS_UNLINK,
+                .path = op.path,
+              });
+      (void)fsBatch().execute(mhwiroot_fd, unlink_ops.data(), unlink_ops.size(), 0);
+    }
 
   err_exit_remove_dir:
-    // we need to reverse elements that is because we
-    // insert them at end of container,and the last
-    // element must bethe last directory,because we
-    // traverse directory followed the rule -
-    // always start a new recursion for traverse the
-    // new directory whenever we encountered it.
-    mfiles_list_->directory_list.reverse();
-    for (auto i : mfiles_list_->directory_list)
-      rmdir((mhwiroot + i).c_str());
+    // only the directories made by us can be removed,
+    // the deepest level at first.
+    for (auto batch(dir_batches.rbegin()); batch != dir_batches.rend(); ++batch) {
+      std::vector<mhwimm_fsbatch_ns::fs_op> rmdir_ops;
+      for (const auto &op : *batch)
+        if (!op.result)
+          rmdir_ops.push_back(mhwimm_fsbatch_ns::fs_op {
+              .type = mhwimm_fsbatch_ns::fs_op_type::FS_RMDIR,
+              .path = op.path,
+            });
+      (void)fsBatch().execute(mhwiroot_fd, rmdir_ops.data(), rmdir_ops.size(), 0);
+    }
 
   err_exit:
+    if (mhwiroot_fd >= 0)
+      (void)close(mhwiroot_fd);
+    // rolled back,nothing to be recovered
+    (void)journal_.commit();
     current_status_ = mhwimm_executor_status::ERROR;
     return - 1;
   }
 
+  /**
+   * conflicts_err_msg_output - output the conflicts grouped by owner,
+   *                            the conflict without owner means the
+   *                            file is not installed by mhwimm
+   */
+  void mhwimm_executor::conflicts_err_msg_output(void) noexcept
+  {
+    const std::string *last_owner(nullptr);
+
+    generic_err_msg_output(ERROR_MSG_MODCONFLICT);
+    for (const auto &c : mfiles_list_->conflict_list) {
+      if (!last_owner || *last_owner != c.owner) {
+        last_owner = &c.owner;
+        output_.append(c.owner.empty() ?
+                       std::string{"  not installed by mhwimm :"} :
+                       std::string{"  owned by mod "} + c.owner + " :");
+      }
+      output_.append(std::string{"    "} + c.file_path);
+    }
+  }
+
   /**
    * uninstall - uninstall a mod,database should removes
    *             the records of this mod if uninstalling
    *             succeed
    * return:     0 OR -1
+   * # the regular files are unlinked chunk by chunk as the records
+   *   arrive,and then the directories are removed level by level,
+   *   the deepest at first.
+   * # the entries could not be removed are listed with the reason.
    */
   int mhwimm_executor::uninstall(void) noexcept
   {
     // uninstall [ mod name ]
-    // but Executor does not ask DB to returns records of
-    // mod files.
-    // this work will hand over to worker thread.
+    // the records are streamed from DB if the stream been set,
+    // otherwise the worker thread loaded them before.
     current_status_ = mhwimm_executor_status::WORKING;
-    if (!mfiles_list_->directory_list.size() &&
+    if (!record_stream_ &&
+        !mfiles_list_->directory_list.size() &&
         !mfiles_list_->regular_file_list.size()) {
       generic_err_msg_output(ERROR_MSG_UNINSNMOD);
       current_status_ = mhwimm_executor_status::ERROR;
@@ -589,55 +1272,521 @@ namespace mhwimm_executor_ns {
 
     auto mhwiroot(conf_->mhwiroot);
 
-#ifdef DEBUG
-    noutput_msgs_++;
-#endif
+    int mhwiroot_fd(open(mhwiroot.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (mhwiroot_fd < 0) {
+      generic_err_msg_output(ERROR_MSG_UNINSTALL);
+      current_status_ = mhwimm_executor_status::ERROR;
+      return -1;
+    }
+
+    if (journal_.begin(journalPath(), mhwimm_journal_ns::journal_cmd::JOURNAL_UNINSTALL,
+                       std::string(parameters_[0]), mhwiroot, "") < 0) {
+      (void)close(mhwiroot_fd);
+      generic_err_msg_output(ERROR_MSG_JOURNAL);
+      current_status_ = mhwimm_executor_status::ERROR;
+      return -1;
+    }
+
+    std::size_t nfailed(0), nrecords(0);
+    uint8_t journal_err(0), db_err(0);
+    std::vector<std::pair<std::string, int>> failures; // path,-errno
+    std::vector<mhwimm_fsbatch_ns::fs_op> unlink_ops;
+
+    // collect the operations failed with the errors not in @ignored
+    auto collect_failures = [&failures](const std::vector<mhwimm_fsbatch_ns::fs_op> &ops,
+                                        std::initializer_list<int> ignored) {
+                              for (const auto &op : ops)
+                                if (op.result && std::find(ignored.begin(), ignored.end(),
+                                                           op.result) == ignored.end())
+                                  failures.emplace_back(std::string{"/"} + op.path, op.result);
+                            };
+
+    // unlink the regular files in @paths,the file is missing already
+    // is fine,e.g. removed by an UPDATE been rolled back.
+    auto unlink_files = [&](const mhwimm_path_list_ns::path_list &paths) {
+                          unlink_ops.clear();
+                          for (std::size_t i(0); i < paths.size(); ++i)
+                            if (paths.type(i) == mhwimm_path_list_ns::path_type::PATH_REGULAR)
+                              unlink_ops.push_back(mhwimm_fsbatch_ns::fs_op {
+                                  .type = mhwimm_fsbatch_ns::fs_op_type::FS_UNLINK,
+                                  .path = paths.c_str(i) + 1,
+                                });
+                          if (journal_err)
+                            return;
+                          if (journaledExecute(mhwiroot_fd, unlink_ops, 0, nfailed) < 0)
+                            journal_err = 1;
+                          else if (nfailed)
+                            collect_failures(unlink_ops, { -ENOENT });
+                        };
+
+    if (record_stream_) {
+      // the chunks must be drained even if we stopped removing,DB
+      // thread waits for us when the stream is full.
+      mhwimm_sync_mechanism_ns::path_stream stream;
+      std::future<bool> asked(record_stream_(&stream));
+      for (mhwimm_sync_mechanism_ns::path_chunk chunk; ;) {
+        stream.pop(chunk);
+        nrecords += chunk.paths.size();
+        for (std::size_t i(0); i < chunk.paths.size(); ++i)
+          if (chunk.paths.type(i) == mhwimm_path_list_ns::path_type::PATH_DIRECTORY)
+            mfiles_list_->directory_list.push_back(chunk.paths[i],
+                                                   mhwimm_path_list_ns::path_type::PATH_DIRECTORY);
+        unlink_files(chunk.paths);
+        if (chunk.last)
+          break;
+      }
+      // DB thread leaves the stream after the request accomplished
+      if (!asked.get())
+        db_err = 1;
+
+      if (!nrecords && !db_err) {
+        (void)close(mhwiroot_fd);
+        (void)journal_.commit();
+        generic_err_msg_output(ERROR_MSG_UNINSNMOD);
+        current_status_ = mhwimm_executor_status::ERROR;
+        return -1;
+      }
+    } else
+      unlink_files(mfiles_list_->regular_file_list);
+
+    // directories are removed level by level,the deepest at first,
+    // the directories shared with the others are not empty.
+    // they are kept if DB failed in the middle,the files of the
+    // records not arrived are still in there.
+    if (!db_err) {
+      auto dir_batches(makeup_depth_batches(mfiles_list_->directory_list,
+                                            mhwimm_fsbatch_ns::fs_op_type::FS_RMDIR));
+      for (auto batch(dir_batches.rbegin());
+           !journal_err && batch != dir_batches.rend(); ++batch) {
+        if (journaledExecute(mhwiroot_fd, *batch, 0, nfailed) < 0) {
+          journal_err = 1;
+          break;
+        }
+        if (nfailed)
+          collect_failures(*batch, { -ENOTEMPTY, -ENOENT });
+      }
+    }
+    (void)close(mhwiroot_fd);
+
+    if (failures.size() || journal_err || db_err) {
+      // the records are kept in DB,thus the journal is useless
+      (void)journal_.commit();
+      generic_err_msg_output(journal_err ? ERROR_MSG_JOURNAL :
+                             db_err ? ERROR_MSG_UNINSDB : ERROR_MSG_UNINSTALL);
+      for (const auto &f : failures)
+        output_.append(std::string{"  "} + mhwiroot + f.first + " : " + strerror(-f.second));
+      current_status_ = mhwimm_executor_status::ERROR;
+      return -1;
+    }
+
+    current_status_ = mhwimm_executor_status::IDLE;
+    return 0;
+  }
+
+  /**
+   * update - update an installed mod from a new version of the mod
+   *          directory,only the files been added,removed or changed
+   *          are touched
+   * return:  0 OR -1
+   * # the records of the mod were asked by thread worker,they are
+   *   replaced by the delta in mod_files_list for DB.
+   * # a recorded file is changed if the deployed one is missing,or it
+   *   is not the same inode as the source and the source has another
+   *   size or is newer than it.
+   * # the changed files are deployed under staged names,nothing of the
+   *   old version is touched before DB recorded the delta,thus a failure
+   *   rolls back to the old version.finishUpdate() replaces and removes
+   *   the old files after that.
+   * # a path changes between file and directory has to be removed at
+   *   first,such an update can not be rolled back completely.
+   */
+  int mhwimm_executor::update(void) noexcept
+  {
+    current_status_ = mhwimm_executor_status::WORKING;
 
-    uint8_t rf_err(0);
-    for (auto i : mfiles_list_->regular_file_list) {
-      std::string filepath(mhwiroot + i);
-      if (unlink(filepath.c_str()) < 0) {
-        rf_err = 1;
+    std::string modname(parameters_[0]);
+    std::string moddir(parameters_[1]);
+
+    std::unique_lock<decltype(mfiles_list_->lock)> mfl_lock(mfiles_list_->lock);
+    if (mfiles_list_->regular_file_list.empty() && mfiles_list_->directory_list.empty()) {
+      generic_err_msg_output(ERROR_MSG_UPDNMOD);
+      current_status_ = mhwimm_executor_status::ERROR;
+      return -1;
+    }
+
+    struct stat moddir_stat = {0};
+    if (stat(moddir.c_str(), &moddir_stat) < 0 || !S_ISDIR(moddir_stat.st_mode)) {
+      generic_err_msg_output(ERROR_MSG_UPDATEDIR);
+      current_status_ = mhwimm_executor_status::ERROR;
+      return -1;
+    }
+
+    // the lists of mod_files_list become the delta
+    mhwimm_path_list_ns::path_list recorded_files, recorded_dirs, new_files, new_dirs;
+    recorded_files.swap(mfiles_list_->regular_file_list);
+    recorded_dirs.swap(mfiles_list_->directory_list);
+    mfiles_list_->content_hash_list.clear();
+    mfiles_list_->deployed_hash_list.clear();
+    mfiles_list_->removed_list.clear();
+    mfiles_list_->conflict_list.clear();
+    auto &added_dirs(mfiles_list_->directory_list);
+    auto &deploy_files(mfiles_list_->regular_file_list);
+    auto &removed(mfiles_list_->removed_list);
+
+    if (mhwimm_traverse_ns::parallel_traverse(moddir, workerPool(), new_dirs, new_files) < 0) {
+      generic_err_msg_output(ERROR_MSG_TRAVERSE_DIR);
+      current_status_ = mhwimm_executor_status::ERROR;
+      return -1;
+    }
+
+    std::string cwd;
+    if (current_dir(cwd) < 0) {
+      generic_err_msg_output(ERROR_MSG_PWD);
+      current_status_ = mhwimm_executor_status::ERROR;
+      return -1;
+    }
+    std::string src_root(cwd + "/" + moddir);
+    struct stat mhwiroot_stat = {0};
+    std::size_t nadded(0), nchanged(0), nremoved(0);
+    auto &removed_files(update_removed_files_);
+    auto &removed_dirs(update_removed_dirs_);
+    auto &staged(update_staged_);
+    auto &replaced(update_replaced_);
+    mhwimm_path_list_ns::path_list deployed_at;
+    std::vector<std::vector<mhwimm_fsbatch_ns::fs_op>> dir_batches;
+    std::vector<std::string> link_srcs;
+    std::vector<mhwimm_fsbatch_ns::fs_op> link_ops;
+    std::vector<mhwimm_fsbatch_ns::fs_op> copy_ops;
+    bool deploy_err(false);
+
+    mhwimm_deploy_ns::deploy_strategy strategy(mhwimm_deploy_ns::deploy_strategy::DEPLOY_LINK);
+    if (mhwimm_deploy_ns::parse_deploy_strategy(nparams_ == 3 ? parameters_[2] :
+                                                std::string_view(conf_->deploy),
+                                                strategy) < 0)
+      strategy = mhwimm_deploy_ns::deploy_strategy::DEPLOY_LINK;
+
+    int mhwiroot_fd(open(conf_->mhwiroot.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (mhwiroot_fd < 0 || fstat(mhwiroot_fd, &mhwiroot_stat) < 0) {
+      generic_err_msg_output(ERROR_MSG_STATPATH);
+      goto err_exit;
+    }
+
+    // step1 : makeup delta
+    // the lists are sorted and walked together,the views of the files
+    // in both refer to @new_files which is complete.
+    {
+      using mhwimm_path_list_ns::path_type;
+      std::vector<std::string_view> common_files;
+
+      recorded_dirs.sort();
+      new_dirs.sort();
+      diff_sorted_paths(recorded_dirs, new_dirs,
+                        [&](std::string_view d) {
+                          removed_dirs.push_back(d, path_type::PATH_DIRECTORY);
+                          removed.push_back(d, path_type::PATH_DIRECTORY);
+                        },
+                        [&](std::string_view d) {
+                          added_dirs.push_back(d, path_type::PATH_DIRECTORY);
+                        },
+                        [](std::string_view) {});
+
+      recorded_files.sort();
+      new_files.sort();
+      diff_sorted_paths(recorded_files, new_files,
+                        [&](std::string_view f) {
+                          removed_files.push_back(f, path_type::PATH_REGULAR);
+                          removed.push_back(f, path_type::PATH_REGULAR);
+                        },
+                        [&](std::string_view f) {
+                          deploy_files.push_back(f, path_type::PATH_REGULAR);
+                        },
+                        [&](std::string_view f) {
+                          common_files.push_back(f);
+                        });
+      nadded = deploy_files.size();
+      nremoved = removed.size();
+
+      // the files in both are compared by metadata on the workers,
+      // each task takes a chunk of files.
+      constexpr std::size_t chunk_size(64);
+      std::vector<uint8_t> changed(common_files.size(), 0);
+      for (std::size_t begin(0); begin < common_files.size(); begin += chunk_size) {
+        std::size_t end(std::min(begin + chunk_size, common_files.size()));
+        workerPool().submit([&common_files, &changed, &src_root, mhwiroot_fd, begin, end](void) -> void {
+                              for (std::size_t i(begin); i < end; ++i) {
+                                std::string_view f(common_files[i]);
+                                struct stat dst_stat = {0}, src_stat = {0};
+                                if (fstatat(mhwiroot_fd, f.data() + 1, &dst_stat,
+                                            AT_SYMLINK_NOFOLLOW) < 0 ||
+                                    stat(std::string(src_root).append(f).c_str(), &src_stat) < 0)
+                                  changed[i] = 1;
+                                else if (dst_stat.st_dev == src_stat.st_dev &&
+                                         dst_stat.st_ino == src_stat.st_ino)
+                                  changed[i] = 0;
+                                else
+                                  changed[i] = dst_stat.st_size != src_stat.st_size ||
+                                    src_stat.st_mtim.tv_sec > dst_stat.st_mtim.tv_sec ||
+                                    (src_stat.st_mtim.tv_sec == dst_stat.st_mtim.tv_sec &&
+                                     src_stat.st_mtim.tv_nsec > dst_stat.st_mtim.tv_nsec);
+                              }
+                            });
+      }
+      workerPool().wait();
+
+      for (std::size_t i(0); i < common_files.size(); ++i)
+        if (changed[i]) {
+          deploy_files.push_back(common_files[i], path_type::PATH_REGULAR);
+          replaced.push_back(common_files[i], path_type::PATH_REGULAR);
+          staged.push_back(std::string(common_files[i]).append(update_staged_suffix),
+                           path_type::PATH_REGULAR);
+          removed.push_back(common_files[i], path_type::PATH_REGULAR);
+          ++nchanged;
+        }
+    }
 
 #ifdef DEBUG
-        rs_vec_if_necessary(cmd_output_msgs_, noutput_msgs_);
-        // record the file's path which unlink failed on
-        cmd_output_msgs_[noutput_msgs_++] = filepath;
+    std::cerr << "update: " << nadded << " added," << nremoved << " removed,"
+              << nchanged << " changed" << std::endl;
 #endif
+
+    // step2 : conflicting checking for the files new to this mod
+    // the changed files are owned by this mod itself.
+    if (nadded && conflict_query_) {
+      mfl_lock.unlock();
+      int ret(conflict_query_());
+      mfl_lock.lock();
+      if (ret < 0) {
+        generic_err_msg_output(ERROR_MSG_ASKCONFLICT);
+        goto err_exit;
+      }
+      mfiles_list_->conflict_list.remove_if([&modname](const mhwimm_db_ns::db_conflict &c) -> bool {
+                                              return c.owner == modname;
+                                            });
+    }
+    {
+      // the files owned by other mods are reported already,the others
+      // existed are not managed by mhwimm.
+      std::unordered_set<std::string_view> owned;
+      for (const auto &c : mfiles_list_->conflict_list)
+        owned.insert(c.file_path);
+      for (std::size_t i(0); i < nadded; ++i) {
+        struct stat dst_stat = {0};
+        if (owned.count(deploy_files[i]))
+          continue;
+        if (fstatat(mhwiroot_fd, deploy_files.c_str(i) + 1, &dst_stat, AT_SYMLINK_NOFOLLOW) == 0 &&
+            !S_ISDIR(dst_stat.st_mode))
+          mfiles_list_->conflict_list.push_back(mhwimm_db_ns::db_conflict {
+              .file_path = std::string(deploy_files[i]),
+            });
+      }
+    }
+    if (!mfiles_list_->conflict_list.empty()) {
+      conflicts_err_msg_output();
+      goto err_exit;
+    }
+
+    // the content of deployed files come from their blobs
+    if (strategy == mhwimm_deploy_ns::deploy_strategy::DEPLOY_STORE &&
+        ingestModFiles(moddir, nullptr, link_srcs) < 0) {
+      generic_err_msg_output(ERROR_MSG_STORE);
+      goto err_exit;
+    }
+
+    if (journal_.begin(journalPath(), mhwimm_journal_ns::journal_cmd::JOURNAL_UPDATE,
+                       modname, conf_->mhwiroot, src_root) < 0) {
+      generic_err_msg_output(ERROR_MSG_JOURNAL);
+      goto err_exit;
+    }
+
+    // step3 : a path changes between file and directory can not be
+    // deployed beside the old one,the old version is removed at first.
+    {
+      std::unordered_set<std::string_view> removed_paths;
+      for (std::string_view f : removed_files)
+        removed_paths.insert(f);
+      for (std::string_view d : removed_dirs)
+        removed_paths.insert(d);
+      bool type_changed(false);
+      for (std::size_t i(0); i < nadded && !type_changed; ++i)
+        type_changed = removed_paths.count(deploy_files[i]);
+      for (std::string_view d : added_dirs) {
+        if (type_changed)
+          break;
+        type_changed = removed_paths.count(d);
+      }
+      if (type_changed && removeUpdatedPaths(mhwiroot_fd) < 0)
+        goto err_rollback;
+    }
+
+    // step4 : make the new directories parents at first
+    dir_batches = makeup_depth_batches(added_dirs, mhwimm_fsbatch_ns::fs_op_type::FS_MKDIR);
+    for (auto &batch : dir_batches) {
+      std::size_t nfailed(0);
+      if (journaledExecute(mhwiroot_fd, batch, mhwiroot_stat.st_mode, nfailed) < 0) {
+        generic_err_msg_output(ERROR_MSG_JOURNAL);
+        goto err_rollback;
       }
+      for (const auto &op : batch)
+        if (op.result && op.result != -EEXIST) {
+          generic_err_msg_output(ERROR_MSG_MKDIR);
+          goto err_rollback;
+        }
     }
 
-    uint8_t d_err(0);
-    for (auto i : mfiles_list_->directory_list) {
-      std::string dirpath(mhwiroot + i);
-      errno = 0;
-      if (rmdir(dirpath.c_str()) < 0)
-        if (errno != ENOTEMPTY) {
-          d_err = 1;
+    // step5 : deploy the files been added as install does,and the
+    // changed ones beside the old version under staged names
+    if (strategy != mhwimm_deploy_ns::deploy_strategy::DEPLOY_STORE) {
+      link_srcs.reserve(deploy_files.size());
+      for (std::string_view f : deploy_files)
+        link_srcs.push_back(std::string(src_root).append(f));
+    }
+    for (std::size_t i(0); i < deploy_files.size(); ++i)
+      deployed_at.push_back(i < nadded ? deploy_files[i] : staged[i - nadded],
+                            mhwimm_path_list_ns::path_type::PATH_REGULAR);
+    // left by an interrupted update
+    for (std::size_t i(0); i < staged.size(); ++i)
+      (void)unlinkat(mhwiroot_fd, staged.c_str(i) + 1, 0);
+    {
+      bool link_first(strategy == mhwimm_deploy_ns::deploy_strategy::DEPLOY_LINK ||
+                      strategy == mhwimm_deploy_ns::deploy_strategy::DEPLOY_STORE);
+      auto src(link_srcs.cbegin());
+      for (std::size_t i(0); i < deployed_at.size(); ++i)
+        (link_first ? link_ops : copy_ops).push_back(mhwimm_fsbatch_ns::fs_op {
+            .type = link_first ?
+              mhwimm_fsbatch_ns::fs_op_type::FS_LINK : mhwimm_fsbatch_ns::fs_op_type::FS_COPY,
+            .path = deployed_at.c_str(i) + 1,
+            .src = (src++)->c_str(),
+            .result = mhwimm_fsbatch_ns::fs_op_pending,
+          });
+
+      std::size_t nfailed(0);
+      if (journaledExecute(mhwiroot_fd, link_ops, 0, nfailed) < 0) {
+        generic_err_msg_output(ERROR_MSG_JOURNAL);
+        goto err_rollback;
+      }
+      for (auto &op : link_ops)
+        if (op.result < 0 && mhwimm_deploy_ns::should_fallback(-op.result)) {
+          copy_ops.push_back(mhwimm_fsbatch_ns::fs_op {
+              .type = mhwimm_fsbatch_ns::fs_op_type::FS_COPY,
+              .path = op.path,
+              .src = op.src,
+              .result = mhwimm_fsbatch_ns::fs_op_pending,
+            });
+          op.result = mhwimm_fsbatch_ns::fs_op_pending;
+        }
+      if (journaledExecute(mhwiroot_fd, copy_ops, 0, nfailed, strategy) < 0) {
+        generic_err_msg_output(ERROR_MSG_JOURNAL);
+        goto err_rollback;
+      }
+    }
+    for (const auto *ops : { &link_ops, &copy_ops })
+      for (const auto &op : *ops)
+        if (op.result && op.result != mhwimm_fsbatch_ns::fs_op_pending) {
 #ifdef DEBUG
-          rs_vec_if_necessary(cmd_output_msgs_, noutput_msgs_);
-          cmd_output_msgs_[noutput_msgs_++] = dirpath;
+          std::cerr << op.path << " : " << strerror(-op.result) << std::endl;
 #endif
+          deploy_err = true;
         }
+    if (deploy_err) {
+      generic_err_msg_output(ERROR_MSG_UPDATE);
+      goto err_rollback;
     }
 
-    if (rf_err || d_err) {
-      generic_err_msg_output(ERROR_MSG_UNINSTALL);
-      current_status_ = mhwimm_executor_status::ERROR;
+    // the files kept have the metadata and hashes recorded before,
+    // renaming keeps the inode of the staged files.
+    stat_file_metas(mhwiroot_fd, deployed_at,
+                    mfiles_list_->file_meta_list, nullptr, &workerPool());
+    if (strategy != mhwimm_deploy_ns::deploy_strategy::DEPLOY_STORE)
+      hash_file_keys(mhwiroot_fd, deployed_at,
+                     mfiles_list_->deployed_hash_list, workerPool());
+    mfiles_list_->mod_source = src_root;
+
+    (void)close(mhwiroot_fd);
+    output_.append(std::string{"update: "} +
+                   std::to_string(nadded + added_dirs.size()) + " added," +
+                   std::to_string(nremoved) + " removed," + std::to_string(nchanged) + " changed.");
+    current_status_ = mhwimm_executor_status::IDLE;
+    return 0;
+
+  err_rollback:
+    // the journal is closed by rollback
+    (void)rollbackJournal();
+
+  err_exit:
+    if (mhwiroot_fd >= 0)
+      (void)close(mhwiroot_fd);
+    if (journal_.isOpened())
+      (void)journal_.commit();
+    current_status_ = mhwimm_executor_status::ERROR;
+    return -1;
+  }
+
+  /**
+   * removeUpdatedPaths - remove the files and directories no longer in
+   *                      the mod,the deepest directories at first
+   * return:              0 OR -1
+   * # the file is missing already is not an error,and the shared
+   *   directories are not empty.
+   */
+  int mhwimm_executor::removeUpdatedPaths(int mhwiroot_fd)
+  {
+    std::vector<mhwimm_fsbatch_ns::fs_op> unlink_ops;
+    for (std::string_view f : update_removed_files_)
+      unlink_ops.push_back(mhwimm_fsbatch_ns::fs_op {
+          .type = mhwimm_fsbatch_ns::fs_op_type::FS_UNLINK,
+          .path = f.data() + 1,
+        });
+    if (!unlink_ops.empty() &&
+        fsBatch().execute(mhwiroot_fd, unlink_ops.data(), unlink_ops.size(), 0))
+      for (const auto &op : unlink_ops)
+        if (op.result && op.result != -ENOENT) {
 #ifdef DEBUG
-      std::cerr << "DEBUG printing for UNINSTALL - failed on files :\n";
-      for (auto e : cmd_output_msgs_) {
-        std::cerr << e << std::endl;
-      }
+          std::cerr << op.path << " : " << strerror(-op.result) << std::endl;
 #endif
+          generic_err_msg_output(ERROR_MSG_UPDATE);
+          return -1;
+        }
+
+    auto dir_batches(makeup_depth_batches(update_removed_dirs_,
+                                          mhwimm_fsbatch_ns::fs_op_type::FS_RMDIR));
+    for (auto batch(dir_batches.rbegin()); batch != dir_batches.rend(); ++batch)
+      (void)fsBatch().execute(mhwiroot_fd, batch->data(), batch->size(), 0);
+
+    update_removed_files_.clear();
+    update_removed_dirs_.clear();
+    return 0;
+  }
+
+  int mhwimm_executor::finishUpdate(void)
+  {
+    int mhwiroot_fd(open(conf_->mhwiroot.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (mhwiroot_fd < 0) {
+      generic_err_msg_output(ERROR_MSG_STATPATH);
+      current_status_ = mhwimm_executor_status::ERROR;
       return -1;
     }
 
+    // the staged files replace the old version at once
+    int ret(0);
+    for (std::size_t i(0); i < update_staged_.size(); ++i)
+      if (renameat(mhwiroot_fd, update_staged_.c_str(i) + 1,
+                   mhwiroot_fd, update_replaced_.c_str(i) + 1) < 0) {
 #ifdef DEBUG
-    noutput_msgs_ = 0;
+        std::cerr << update_staged_[i] << " : " << strerror(errno) << std::endl;
 #endif
-    current_status_ = mhwimm_executor_status::IDLE;
-    return 0;
+        ret = -1;
+      }
+    if (ret < 0)
+      generic_err_msg_output(ERROR_MSG_UPDATE);
+    else
+      ret = removeUpdatedPaths(mhwiroot_fd);
+
+    (void)close(mhwiroot_fd);
+    update_staged_.clear();
+    update_replaced_.clear();
+    if (ret < 0)
+      current_status_ = mhwimm_executor_status::ERROR;
+    return ret;
   }
 
   int mhwimm_executor::installed(void) noexcept
@@ -661,12 +1810,9 @@ namespace mhwimm_executor_ns {
               << std::endl;
 #endif
 
-    for (auto e : mfiles_list_->mod_name_list) {
-      rs_vec_if_necessary(cmd_output_msgs_, noutput_msgs_);
-      cmd_output_msgs_[noutput_msgs_++] = e;
-    }
+    for (std::string_view e : mfiles_list_->mod_name_list)
+      output_.append(e);
 
-    is_cmd_has_output_ = true;
     current_status_ = mhwimm_executor_status::IDLE;
     return 0;
   }
@@ -677,35 +1823,679 @@ namespace mhwimm_executor_ns {
    */
   int mhwimm_executor::commands(void) noexcept
   {
-    constexpr const char *cd_description = "cd <path> - change current work directory";
-    constexpr const char *pwd_description = "pwd - get current work directory";
-    constexpr const char *ls_description = "ls - list files under current work direcotry";
-    constexpr const char *install_description = "install <mod name> <mod directory - relative path>"
-                                                " - install mod @mode_name,its files are existed in @mod_direcotry";
-    constexpr const char *unintall_description = "unintall <mod name> - unintall mod @mod_name";
-    constexpr const char *get_config_description = "get_config <config name> - get the value of config";
-    constexpr const char *config_description = "config <key>=<value> - set config,implemented @userhome @mhwiroot, @mhwimmroot";
-    constexpr const char *exit_description = "exit - exit application";
-    constexpr const char *commands_description = "commands - list commands and print description";
-    constexpr const char *help_description = "help - help message,implemented as cmd commands";
-
-    constexpr uint8_t ndescriptions = 10;
-
-    constexpr const char *descriptions[ndescriptions] = {
-      cd_description, pwd_description, ls_description, install_description, unintall_description,
-      get_config_description, config_description, exit_description, commands_description, help_description
-    };
+    current_status_ = mhwimm_executor_status::WORKING;
+
+    for (const auto &d : cmd_table.descriptors())
+      output_.append(d.description);
+
+    current_status_ = mhwimm_executor_status::IDLE;
+    return 0;
+  }
+
+  /**
+   * workerPool - get the thread pool for filesystem works,the pool
+   *              is created at the first time to use,and rebuilt if
+   *              config NWORKERS been modified
+   */
+  mhwimm_thread_pool_ns::work_stealing_pool &mhwimm_executor::workerPool(void)
+  {
+    unsigned int nworkers(conf_->nworkers > 0 ? conf_->nworkers : 0);
+    if (!worker_pool_ || worker_pool_->requested_size() != nworkers)
+      worker_pool_ = std::make_unique<mhwimm_thread_pool_ns::work_stealing_pool>(nworkers);
+    return *worker_pool_;
+  }
+
+  /* journalPath - path of intent journal */
+  std::string mhwimm_executor::journalPath(void) const
+  {
+    return conf_->mhwimmroot + "/" + journal_filename;
+  }
+
+  /**
+   * journaledExecute - record @ops in journal,and then execute them
+   * @nfailed:          where to store the number of failed operations
+   * @strategy:         deploy strategy for FS_COPY
+   * return:            0 OR -1 if failed to record,nothing been executed
+   */
+  int mhwimm_executor::journaledExecute(int dirfd, std::vector<mhwimm_fsbatch_ns::fs_op> &ops,
+                                        mode_t mode, std::size_t &nfailed,
+                                        mhwimm_deploy_ns::deploy_strategy strategy)
+  {
+    return journaledExecute(ops, nfailed,
+                            [this, dirfd, mode, strategy](mhwimm_fsbatch_ns::fs_op *ops,
+                                                          std::size_t nops) -> std::size_t {
+                              if (ops->type == mhwimm_fsbatch_ns::fs_op_type::FS_COPY)
+                                return mhwimm_deploy_ns::copy_files(dirfd, ops, nops,
+                                                                    strategy, workerPool());
+                              return fsBatch().execute(dirfd, ops, nops, mode);
+                            });
+  }
+
+  /**
+   * journaledExecute - record @ops in journal,and then execute them
+   *                    by @executor,which returns number of failed
+   *                    operations
+   */
+  int mhwimm_executor::journaledExecute(std::vector<mhwimm_fsbatch_ns::fs_op> &ops,
+                                        std::size_t &nfailed,
+                                        const std::function<std::size_t(mhwimm_fsbatch_ns::fs_op *,
+                                                                        std::size_t)> &executor)
+  {
+    nfailed = 0;
+    if (ops.empty())
+      return 0;
+    if (journal_.plan(ops.front().type, ops.data(), ops.size()) < 0)
+      return -1;
+    nfailed = executor(ops.data(), ops.size());
+    // lost completion only makes recovery check the operations
+    (void)journal_.done(ops.data(), ops.size());
+    return 0;
+  }
+
+  int mhwimm_executor::loadJournal(mhwimm_journal_ns::journal_cmd &cmd, std::string &mod_name)
+  {
+    mhwimm_journal_ns::journal_content content;
+    int ret(mhwimm_journal_ns::intent_journal::load(journalPath(), content));
+    if (ret == 0) {
+      // the header is incomplete,nothing been done
+      (void)unlink(journalPath().c_str());
+      return 0;
+    } else if (ret < 0)
+      return -1;
+
+    cmd = content.cmd;
+    mod_name = content.mod_name;
+    journal_recovering_ = true;
+    return 1;
+  }
+
+  /**
+   * commitJournal - remove the journal written by current command,or
+   *                 the one left by last run which is being recovered
+   * return:         0 OR -1
+   */
+  int mhwimm_executor::commitJournal(void)
+  {
+    if (journal_.isOpened())
+      return journal_.commit();
+    if (!journal_recovering_)
+      return 0;
+    journal_recovering_ = false;
+    return unlink(journalPath().c_str());
+  }
+
+  /**
+   * rollbackJournal - undo the operations of INSTALL / UPDATE recorded in
+   *                   journal
+   * return:           0 OR -1
+   * # the operations without completion are undone only if they are
+   *   sure been done by us,e.g. the link is the same inode as the one
+   *   in mod directory or the blob in content store,the copy or the
+   *   file extracted from mod archive is born after the journal.the
+   *   directories of this kind are left,because they might be existed
+   *   before.
+   * # journal is removed if succeed.
+   */
+  int mhwimm_executor::rollbackJournal(void)
+  {
+    journal_.close();
+
+    mhwimm_journal_ns::journal_content content;
+    int ret(mhwimm_journal_ns::intent_journal::load(journalPath(), content));
+    if (ret == 0) {
+      // nothing been done
+      (void)unlink(journalPath().c_str());
+      journal_recovering_ = false;
+      return 0;
+    } else if (ret < 0)
+      return -1;
+    if (content.cmd != mhwimm_journal_ns::journal_cmd::JOURNAL_INSTALL &&
+        content.cmd != mhwimm_journal_ns::journal_cmd::JOURNAL_UPDATE)
+      return -1;
+
+    int root_fd(open(content.root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (root_fd < 0)
+      return -1;
+
+    // copies created after the journal are ours
+    struct statx journal_statx = {0};
+    bool has_journal_btime(statx(AT_FDCWD, journalPath().c_str(), 0, STATX_BTIME,
+                                 &journal_statx) == 0 &&
+                           (journal_statx.stx_mask & STATX_BTIME));
 
+    uint8_t undo_err(0);
+    for (auto batch(content.batches.rbegin()); batch != content.batches.rend(); ++batch) {
+      bool is_dir(batch->type == mhwimm_fsbatch_ns::fs_op_type::FS_MKDIR);
+      std::vector<mhwimm_fsbatch_ns::fs_op> undo_ops;
+
+      // removals of UPDATE can not be undone
+      if (batch->type == mhwimm_fsbatch_ns::fs_op_type::FS_UNLINK ||
+          batch->type == mhwimm_fsbatch_ns::fs_op_type::FS_RMDIR)
+        continue;
+
+      for (std::size_t i(0); i < batch->paths.size(); ++i) {
+        if (batch->states[i] == mhwimm_journal_ns::journal_op_state::OP_FAILED)
+          continue;
+        if (batch->states[i] == mhwimm_journal_ns::journal_op_state::OP_UNKNOWN) {
+          struct statx dst_statx = {0};
+          struct stat src_stat = {0};
+          if (is_dir ||
+              statx(root_fd, batch->paths[i].c_str(), AT_SYMLINK_NOFOLLOW,
+                    STATX_INO | STATX_SIZE | STATX_BTIME, &dst_statx) < 0)
+            continue;
+
+          bool born_after_journal(has_journal_btime && (dst_statx.stx_mask & STATX_BTIME) &&
+                                  (dst_statx.stx_btime.tv_sec > journal_statx.stx_btime.tv_sec ||
+                                   (dst_statx.stx_btime.tv_sec == journal_statx.stx_btime.tv_sec &&
+                                    dst_statx.stx_btime.tv_nsec >= journal_statx.stx_btime.tv_nsec)));
+
+          if (batch->type == mhwimm_fsbatch_ns::fs_op_type::FS_EXTRACT) {
+            // the source is in mod archive,only the birth time tells
+            if (!born_after_journal)
+              continue;
+          } else if (batch->type == mhwimm_fsbatch_ns::fs_op_type::FS_LINK &&
+                     contentStore().isBlobLink(root_fd, batch->paths[i].c_str())) {
+            // deployed from content store,the blob is the source
+          } else if (stat((content.src_root + "/" + batch->paths[i]).c_str(), &src_stat) < 0) {
+            continue;
+          } else if (batch->type == mhwimm_fsbatch_ns::fs_op_type::FS_LINK) {
+            // hard link shares the inode with the source
+            if (makedev(dst_statx.stx_dev_major, dst_statx.stx_dev_minor) != src_stat.st_dev ||
+                dst_statx.stx_ino != src_stat.st_ino)
+              continue;
+          } else {
+            // copy has the size of the source,and born after the journal
+            if (!born_after_journal ||
+                dst_statx.stx_size != static_cast<uint64_t>(src_stat.st_size))
+              continue;
+          }
+        }
+        undo_ops.push_back(mhwimm_fsbatch_ns::fs_op {
+            .type = is_dir ? mhwimm_fsbatch_ns::fs_op_type::FS_RMDIR :
+                             mhwimm_fsbatch_ns::fs_op_type::FS_UNLINK,
+            .path = batch->paths[i].c_str(),
+          });
+      }
+
+      if (!fsBatch().execute(root_fd, undo_ops.data(), undo_ops.size(), 0))
+        continue;
+      for (const auto &op : undo_ops)
+        if (op.result && op.result != -ENOENT && op.result != -ENOTEMPTY)
+          undo_err = 1;
+    }
+    (void)close(root_fd);
+
+    if (undo_err)
+      return -1;
+    // the journal been closed above,it might be written by current
+    // command rather than the one being recovered.
+    journal_recovering_ = false;
+    return unlink(journalPath().c_str());
+  }
+
+  /**
+   * resumeJournal - complete the UNINSTALL recorded in journal
+   * return:         0 OR -1
+   * # the files and directories come from the records in mod_files_list,
+   *   which are kept by DB until the UNINSTALL finished,the operations
+   *   completed in journal are skipped.
+   * # journal is kept,it should be committed after DB removed the mod.
+   */
+  int mhwimm_executor::resumeJournal(void)
+  {
+    mhwimm_journal_ns::journal_content content;
+    if (mhwimm_journal_ns::intent_journal::load(journalPath(), content) <= 0 ||
+        content.cmd != mhwimm_journal_ns::journal_cmd::JOURNAL_UNINSTALL)
+      return -1;
+
+    std::unordered_set<std::string> done_paths;
+    for (const auto &batch : content.batches)
+      for (std::size_t i(0); i < batch.paths.size(); ++i)
+        if (batch.states[i] == mhwimm_journal_ns::journal_op_state::OP_DONE)
+          done_paths.insert(batch.paths[i]);
+
+    int root_fd(open(content.root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (root_fd < 0)
+      return -1;
+
+    std::unique_lock<decltype(mfiles_list_->lock)> mfl_lock(mfiles_list_->lock);
+    std::vector<mhwimm_fsbatch_ns::fs_op> unlink_ops;
+    for (std::string_view i : mfiles_list_->regular_file_list)
+      if (!done_paths.count(i.data() + 1))
+        unlink_ops.push_back(mhwimm_fsbatch_ns::fs_op {
+            .type = mhwimm_fsbatch_ns::fs_op_type::FS_UNLINK,
+            .path = i.data() + 1,
+          });
+
+    uint8_t redo_err(0);
+    if (fsBatch().execute(root_fd, unlink_ops.data(), unlink_ops.size(), 0))
+      for (const auto &op : unlink_ops)
+        if (op.result && op.result != -ENOENT)
+          redo_err = 1;
+
+    auto dir_batches(makeup_depth_batches(mfiles_list_->directory_list,
+                                          mhwimm_fsbatch_ns::fs_op_type::FS_RMDIR));
+    for (auto batch(dir_batches.rbegin()); batch != dir_batches.rend(); ++batch) {
+      if (!fsBatch().execute(root_fd, batch->data(), batch->size(), 0))
+        continue;
+      for (const auto &op : *batch)
+        if (op.result && op.result != -ENOENT && op.result != -ENOTEMPTY)
+          redo_err = 1;
+    }
+    (void)close(root_fd);
+    return redo_err ? -1 : 0;
+  }
+
+  /**
+   * contentStore - get the content store under mhwimm root,it is opened
+   *                at the first time to use,and reopened if config
+   *                MHWIMMROOT been modified
+   */
+  mhwimm_store_ns::content_store &mhwimm_executor::contentStore(void)
+  {
+    std::string root(conf_->mhwimmroot + "/store");
+    if (!content_store_.isOpened() || content_store_.root() != root)
+      (void)content_store_.open(root);
+    return content_store_;
+  }
+
+  /**
+   * ingestModFiles - ingest the regular files of the mod into content
+   *                  store,and fill content_hash_list in mod_files_list
+   * @archive:        mod archive,nullptr if the mod is a directory
+   * @blob_paths:     where to store the blob path of each regular file,
+   *                  in the order of regular_file_list
+   * return:          0 OR -1
+   * # mod archive is extracted into staging at first,the files become
+   *   the blobs by rename,staging is always removed.
+   * # caller must hold the lock of mod_files_list.
+   */
+  int mhwimm_executor::ingestModFiles(const std::string &moddir,
+                                      mhwimm_archive_ns::archive_reader *archive,
+                                      std::vector<std::string> &blob_paths)
+  {
+    auto &store(contentStore());
+    if (!store.isOpened())
+      return -1;
+
+    int ret(-1);
+    std::string src_root;
+    std::string staging;
+    std::vector<std::string> srcs;
+    std::vector<mhwimm_store_ns::ingest_op> ingest_ops;
+
+    if (archive) {
+      if (store.makeStaging(staging) < 0)
+        return -1;
+      int staging_fd(open(staging.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+      if (staging_fd < 0)
+        goto out;
+
+      uint8_t extract_err(0);
+      for (auto &batch : makeup_depth_batches(mfiles_list_->directory_list,
+                                              mhwimm_fsbatch_ns::fs_op_type::FS_MKDIR))
+        if (fsBatch().execute(staging_fd, batch.data(), batch.size(), 0755)) {
+          extract_err = 1;
+          break;
+        }
+
+      std::vector<mhwimm_fsbatch_ns::fs_op> extract_ops;
+      for (std::string_view i : mfiles_list_->regular_file_list)
+        extract_ops.push_back(mhwimm_fsbatch_ns::fs_op {
+            .type = mhwimm_fsbatch_ns::fs_op_type::FS_EXTRACT,
+            .path = i.data() + 1,
+            .src = nullptr,
+            .result = mhwimm_fsbatch_ns::fs_op_pending,
+          });
+      if (!extract_err &&
+          archive->extract(staging_fd, extract_ops.data(), extract_ops.size(), workerPool()))
+        extract_err = 1;
+      (void)close(staging_fd);
+      if (extract_err)
+        goto out;
+      src_root = staging;
+    } else {
+      if (current_dir(src_root) < 0)
+        return -1;
+      src_root.append("/").append(moddir);
+    }
+
+    // @srcs never reallocate,the operations refer to its elements
+    srcs.reserve(mfiles_list_->regular_file_list.size());
+    for (std::string_view i : mfiles_list_->regular_file_list) {
+      srcs.push_back(std::string(src_root).append(i));
+      ingest_ops.push_back(mhwimm_store_ns::ingest_op {
+          .src = srcs.back().c_str(),
+          .move = archive != nullptr,
+          .key = std::string{},
+          .result = 0,
+        });
+    }
+
+    if (store.ingest(ingest_ops.data(), ingest_ops.size(), workerPool())) {
+#ifdef DEBUG
+      for (const auto &op : ingest_ops)
+        if (op.result)
+          std::cerr << op.src << " : " << strerror(-op.result) << std::endl;
+#endif
+      goto out;
+    }
+
+    blob_paths.clear();
+    blob_paths.reserve(ingest_ops.size());
+    for (const auto &op : ingest_ops) {
+      mfiles_list_->content_hash_list.push_back(op.key);
+      blob_paths.push_back(store.blobPath(op.key));
+    }
+    ret = 0;
+
+  out:
+    if (!staging.empty())
+      store.removeStaging(staging);
+    return ret;
+  }
+
+  /**
+   * store - maintain content store
+   *         store gc : remove the blobs no installed mod refers to
+   * return: 0 OR -1
+   */
+  int mhwimm_executor::store(void) noexcept
+  {
     current_status_ = mhwimm_executor_status::WORKING;
 
-    for (uint8_t i(0); i < ndescriptions; ++i) {
-      rs_vec_if_necessary(cmd_output_msgs_, i);
-      cmd_output_msgs_[i] = descriptions[i];
+    std::unique_lock<decltype(mfiles_list_->lock)> mfl_lock(mfiles_list_->lock);
+    std::unordered_set<std::string> referenced;
+    referenced.reserve(mfiles_list_->content_hash_list.size());
+    for (std::string_view h : mfiles_list_->content_hash_list)
+      referenced.emplace(h);
+    mfl_lock.unlock();
+
+    std::size_t nremoved(0);
+    uint64_t nbytes(0);
+    if (contentStore().gc(referenced, nremoved, nbytes) < 0) {
+      generic_err_msg_output(ERROR_MSG_STOREGC);
+      current_status_ = mhwimm_executor_status::ERROR;
+      return -1;
     }
 
-    is_cmd_has_output_ = true;
-    noutput_msgs_ = ndescriptions;
+    output_.append(std::string{"store gc: removed "} +
+                   std::to_string(nremoved) + " blobs,reclaimed " + std::to_string(nbytes) + " bytes.");
     current_status_ = mhwimm_executor_status::IDLE;
     return 0;
   }
+
+  /**
+   * reconcile - compare the regular files of installed mods with the
+   *             metadata recorded at installing,the worker thread
+   *             loaded the records before
+   * return:     0 OR -1
+   * # modified:  size or mtime changed,e.g. overwritten by game patch
+   *   missing:   the file is gone
+   *   unlinked:  the content is the same,but it is no longer the file
+   *              been deployed,or the link to the mod or the blob is
+   *              broken
+   * # no content is read,the files are stated by the workers.
+   */
+  int mhwimm_executor::reconcile(void) noexcept
+  {
+    current_status_ = mhwimm_executor_status::WORKING;
+
+    std::unique_lock<decltype(mfiles_list_->lock)> mfl_lock(mfiles_list_->lock);
+    const auto &files(mfiles_list_->regular_file_list);
+    const auto &owners(mfiles_list_->mod_name_list);
+    const auto &recorded(mfiles_list_->file_meta_list);
+    if (files.empty()) {
+      generic_err_msg_output(nparams_ ? ERROR_MSG_RECNMOD : ERROR_MSG_NOMODINS);
+      current_status_ = mhwimm_executor_status::ERROR;
+      return -1;
+    }
+
+    int mhwiroot_fd(open(conf_->mhwiroot.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (mhwiroot_fd < 0) {
+      generic_err_msg_output(ERROR_MSG_STATPATH);
+      current_status_ = mhwimm_executor_status::ERROR;
+      return -1;
+    }
+
+    std::vector<mhwimm_db_ns::db_file_meta> current;
+    std::vector<int> errs;
+    stat_file_metas(mhwiroot_fd, files, current, &errs, &workerPool());
+    (void)close(mhwiroot_fd);
+
+    std::size_t nmodified(0), nmissing(0), nunlinked(0), nunrecorded(0), nfailed(0);
+    auto report = [this, &files, &owners](const char *what, std::size_t i) {
+                    output_.append(std::string{"  "} + what + " " + std::string(owners[i]) +
+                                   " " + std::string(files[i]));
+                  };
+    for (std::size_t i(0); i < files.size(); ++i) {
+      const auto &r(recorded[i]), &c(current[i]);
+      if (!r.inode) {
+        // installed by older version
+        ++nunrecorded;
+      } else if (errs[i] == ENOENT || errs[i] == ENOTDIR) {
+        ++nmissing;
+        report("missing ", i);
+      } else if (errs[i]) {
+        ++nfailed;
+        output_.append(std::string{"  failed   "} + std::string(owners[i]) + " " +
+                       std::string(files[i]) + " : " + strerror(errs[i]));
+      } else if (c.size != r.size || c.mtime_ns != r.mtime_ns) {
+        ++nmodified;
+        report("modified", i);
+      } else if (c.inode != r.inode || (r.nlink > 1 && c.nlink == 1)) {
+        ++nunlinked;
+        report("unlinked", i);
+      }
+    }
+
+    std::string summary(std::string{"reconcile: "} + std::to_string(files.size()) + " checked," +
+                        std::to_string(nmodified) + " modified," +
+                        std::to_string(nmissing) + " missing," +
+                        std::to_string(nunlinked) + " unlinked");
+    if (nunrecorded)
+      summary += "," + std::to_string(nunrecorded) + " without metadata";
+    if (nfailed)
+      summary += "," + std::to_string(nfailed) + " failed to stat";
+    output_.append(summary + ".");
+
+    current_status_ = mhwimm_executor_status::IDLE;
+    return 0;
+  }
+
+  /**
+   * verify - hash the regular files of installed mods and their sources,
+   *          compare them with the content hashes recorded at installing,
+   *          the worker thread loaded the records before
+   * return:  0 OR -1
+   * # modified:         the deployed file is not the one been installed
+   *   missing:          the deployed file is gone
+   *   source modified:  the file in mod directory changed since installing
+   *   source missing:   the file in mod directory is gone
+   * # mod archive is not expanded,only the deployed files are verified.
+   * # the files are hashed by the workers,the largest at first,thus no
+   *   big file is left to the last.the small files are grouped into one
+   *   task.a deployed file linked to its source is read once.
+   */
+  int mhwimm_executor::verify(void) noexcept
+  {
+    current_status_ = mhwimm_executor_status::WORKING;
+
+    std::unique_lock<decltype(mfiles_list_->lock)> mfl_lock(mfiles_list_->lock);
+    const auto &files(mfiles_list_->regular_file_list);
+    const auto &owners(mfiles_list_->mod_name_list);
+    const auto &recorded(mfiles_list_->content_hash_list);
+    const auto &sources(mfiles_list_->source_list);
+    const auto &metas(mfiles_list_->file_meta_list);
+    if (files.empty()) {
+      generic_err_msg_output(nparams_ ? ERROR_MSG_VERNMOD : ERROR_MSG_NOMODINS);
+      current_status_ = mhwimm_executor_status::ERROR;
+      return -1;
+    }
+
+    int mhwiroot_fd(open(conf_->mhwiroot.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (mhwiroot_fd < 0) {
+      generic_err_msg_output(ERROR_MSG_STATPATH);
+      current_status_ = mhwimm_executor_status::ERROR;
+      return -1;
+    }
+
+    // the files of a mod are adjacent,its source is stated once
+    std::vector<char> with_source(files.size(), 0);
+    for (std::size_t i(0), first(0); i < files.size(); ++i) {
+      if (i && owners[i] == owners[first]) {
+        with_source[i] = with_source[first];
+        continue;
+      }
+      first = i;
+      struct stat src_stat = {0};
+      if (sources[i].empty())
+        continue;
+      if (stat(sources.c_str(i), &src_stat) < 0)
+        output_.append(std::string{"  note: source of "} + std::string(owners[i]) + " " +
+                       std::string(sources[i]) + " : " + strerror(errno));
+      else if (!S_ISDIR(src_stat.st_mode))
+        output_.append(std::string{"  note: source of "} + std::string(owners[i]) +
+                       " is an archive,only the deployed files are verified");
+      else
+        with_source[i] = 1;
+    }
+
+    /**
+     * verify_result - result of hashing a file
+     * @dst_err:       0 OR errno of the deployed file
+     * @src_err:       0 OR errno of the source file
+     */
+    struct verify_result {
+      std::string dst_key;
+      std::string src_key;
+      int dst_err;
+      int src_err;
+    };
+    std::vector<verify_result> results(files.size(), verify_result { .dst_err = 0, .src_err = 0 });
+    std::atomic<uint64_t> nbytes(0);
+
+    auto verify_one = [&, mhwiroot_fd](std::size_t i) -> void {
+                        auto &r(results[i]);
+                        if (recorded[i].empty())
+                          return;
+                        struct stat dst_stat = {0}, src_stat = {0};
+                        r.dst_err = hash_file_at(mhwiroot_fd, files.c_str(i) + 1, r.dst_key,
+                                                 &dst_stat, &nbytes);
+                        if (!with_source[i])
+                          return;
+                        std::string src(std::string(sources[i]).append(files[i]));
+                        if (stat(src.c_str(), &src_stat) < 0) {
+                          r.src_err = errno;
+                          return;
+                        }
+                        if (!r.dst_err && src_stat.st_dev == dst_stat.st_dev &&
+                            src_stat.st_ino == dst_stat.st_ino) {
+                          // the deployed file is the source itself
+                          r.src_key = r.dst_key;
+                          return;
+                        }
+                        r.src_err = hash_file_at(AT_FDCWD, src.c_str(), r.src_key, nullptr, &nbytes);
+                      };
+
+    // schedule the largest files at first by the sizes recorded
+    constexpr uint64_t task_bytes(8 << 20);
+    constexpr std::size_t task_files(64);
+    std::vector<std::size_t> order(files.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&metas](std::size_t a, std::size_t b) -> bool {
+                       return metas[a].size > metas[b].size;
+                     });
+
+    auto started(std::chrono::steady_clock::now());
+    for (std::size_t begin(0); begin < order.size(); ) {
+      std::size_t end(begin);
+      uint64_t bytes(0);
+      while (end < order.size() && end - begin < task_files && bytes < task_bytes)
+        bytes += metas[order[end++]].size;
+      workerPool().submit([&verify_one, &order, begin, end](void) -> void {
+                            for (std::size_t k(begin); k < end; ++k)
+                              verify_one(order[k]);
+                          });
+      begin = end;
+    }
+    workerPool().wait();
+    auto elapsed(std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::steady_clock::now() - started).count());
+    (void)close(mhwiroot_fd);
+
+    std::size_t nmodified(0), nmissing(0), nsrc_modified(0), nsrc_missing(0);
+    std::size_t nunhashed(0), nfailed(0);
+    auto report = [this, &files, &owners](const char *what, std::size_t i) {
+                    output_.append(std::string{"  "} + what + " " + std::string(owners[i]) +
+                                   " " + std::string(files[i]));
+                  };
+    auto report_failed = [this, &files, &owners, &nfailed](const char *what, std::size_t i, int err) {
+                           ++nfailed;
+                           output_.append(std::string{"  failed   "} + what + std::string(owners[i]) +
+                                          " " + std::string(files[i]) + " : " + strerror(err));
+                         };
+    for (std::size_t i(0); i < files.size(); ++i) {
+      const auto &r(results[i]);
+      if (recorded[i].empty()) {
+        // installed by older version
+        ++nunhashed;
+        continue;
+      }
+      if (r.dst_err == ENOENT || r.dst_err == ENOTDIR) {
+        ++nmissing;
+        report("missing ", i);
+      } else if (r.dst_err) {
+        report_failed("", i, r.dst_err);
+      } else if (r.dst_key != recorded[i]) {
+        ++nmodified;
+        report("modified", i);
+      }
+
+      if (!with_source[i])
+        continue;
+      if (r.src_err == ENOENT || r.src_err == ENOTDIR) {
+        ++nsrc_missing;
+        report("source missing ", i);
+      } else if (r.src_err) {
+        report_failed("source ", i, r.src_err);
+      } else if (r.src_key != recorded[i]) {
+        ++nsrc_modified;
+        report("source modified", i);
+      }
+    }
+
+    std::string summary(std::string{"verify: "} + std::to_string(files.size()) + " checked," +
+                        std::to_string(nmodified) + " modified," +
+                        std::to_string(nmissing) + " missing," +
+                        std::to_string(nsrc_modified) + " source modified," +
+                        std::to_string(nsrc_missing) + " source missing");
+    if (nunhashed)
+      summary += "," + std::to_string(nunhashed) + " without hash";
+    if (nfailed)
+      summary += "," + std::to_string(nfailed) + " failed to read";
+    output_.append(summary + ",hashed " + std::to_string(nbytes.load()) + " bytes in " +
+                   std::to_string(elapsed) + " ms.");
+
+    current_status_ = mhwimm_executor_status::IDLE;
+    return 0;
+  }
+
+  /**
+   * fsBatch - get the batch executor for filesystem metadata operations,
+   *           it is created at the first time to use
+   */
+  mhwimm_fsbatch_ns::fs_batch &mhwimm_executor::fsBatch(void)
+  {
+    if (!fs_batch_) {
+      fs_batch_ = std::make_unique<mhwimm_fsbatch_ns::fs_batch>();
+#ifdef DEBUG
+      std::cerr << "fs batch: io_uring "
+                << (fs_batch_->isUringEnabled() ? "enabled" : "unavailable,synchronous fallback")
+                << std::endl;
+#endif
+    }
+    return *fs_batch_;
+  }
 }
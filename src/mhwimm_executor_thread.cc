@@ -1,22 +1,26 @@
 /**
  * Executor Thread Worker
- * The synchronization between UI and Executor :
- *   UI wait until the value becomes even
- *   Executor wait until the value becomes odd
- *   - UI process at first,Executor at second
- * The synchronization between Executor and DB :
- *   Executor wait until the value becomes even
- *   DB wait until the value becomes odd
- *   - Executor process at first,Executor at second
- *     in one period.
+ * The communication between UI and Executor :
+ *   UI pushes command lines into the command ring
+ *   Executor pushes command output into the output ring
+ *   - both rings are lock-free SPSC,the consumer waits
+ *     only when its ring is empty.
+ * The communication between Executor and DB :
+ *   Executor queues typed requests to DB thread,each one
+ *   returns a future
+ *   - INSTALL queues its records before deploying the mod,
+ *     DB inserts them in the meantime,the hashes of the
+ *     deployed files follow in another request.
+ *   - UNINSTALL removes the files chunk by chunk while DB
+ *     streams the records.
  */
 #include "mhwimm_executor_thread.h"
+#include "mhwimm_database_thread.h"
 #include "mhwimm_sync_mechanism.h"
 
-#ifdef DEBUG
-// for debug
 #include <iostream>
-#endif
+#include <functional>
+#include <future>
 
 #include <cstddef>
 #include <cassert>
@@ -24,210 +28,445 @@
 using namespace mhwimm_executor_ns;
 
 /**
- * mhwimm_executor_thread_worker - thread worker for Executor
- * @exe:                           Executor handler
- * @ctrlmsg:                       communication between Executor and UI
- * @mfiles_list:                   structure holds some containers used
- *                                 to interactive with database
+ * recover_unfinished_journal - recover the INSTALL / UNINSTALL which
+ *                              been interrupted in last run
+ * @exe:                        Executor handler
+ * @db_round:                   one round with DB
+ * @mfiles_list:                used to ask DB for the mod records
+ * # INSTALL is rolled back if DB has no record of the mod,otherwise
+ *   it was completed,just the journal is left.
+ * # UNINSTALL is resumed with the records of the mod,and then DB
+ *   removes the records.
+ * # UPDATE is rolled back.
+ */
+static void recover_unfinished_journal(mhwimm_executor &exe,
+                                       const db_round_t &db_round,
+                                       mhwimm_sync_mechanism_ns::mod_files_list &mfiles_list)
+{
+  using mhwimm_journal_ns::journal_cmd;
+
+  journal_cmd cmd(journal_cmd::JOURNAL_INSTALL);
+  std::string mod_name;
+  int ret(exe.loadJournal(cmd, mod_name));
+  if (ret == 0)
+    return;
+  else if (ret < 0) {
+    std::cerr << "executor thread error: Failed to load intent journal." << std::endl;
+    return;
+  }
+
+  // is the mod recorded?
+  if (!db_round([&](void) { return regDBop_getInstalled_Modinfo(mod_name, &mfiles_list); })) {
+    std::cerr << "executor thread error: Failed to interactive with DB"
+              << " for recovering journal." << std::endl;
+    return;
+  }
+
+  mfiles_list.lock.lock();
+  bool is_recorded(mfiles_list.regular_file_list.size() != 0 ||
+                   mfiles_list.directory_list.size() != 0);
+  mfiles_list.lock.unlock();
+
+  // the records of UPDATE are either old or new,both converge
+  // by updating the mod again.
+  if (cmd == journal_cmd::JOURNAL_UPDATE) {
+    ret = exe.rollbackJournal();
+    std::cout << "executor thread: rolled back the interrupted update of mod " << mod_name
+              << (ret < 0 ? " with error." : ",update it again to complete.") << std::endl;
+    return;
+  }
+
+  if (cmd == journal_cmd::JOURNAL_INSTALL) {
+    if (is_recorded)
+      ret = exe.commitJournal();
+    else
+      ret = exe.rollbackJournal();
+    std::cout << "executor thread: " << (is_recorded ? "completed" : "rolled back")
+              << " the interrupted install of mod " << mod_name
+              << (ret < 0 ? " with error." : ".") << std::endl;
+    return;
+  }
+
+  // the records are removed after all files removed,thus nothing
+  // left if the mod is not recorded.
+  ret = is_recorded ? exe.resumeJournal() : 0;
+  if (ret == 0 && is_recorded)
+    ret = db_round([&](void) { return regDBop_remove_mod_info(mod_name); }) ? 0 : -1;
+  if (ret == 0)
+    ret = exe.commitJournal();
+  std::cout << "executor thread: resumed the interrupted uninstall of mod " << mod_name
+            << (ret < 0 ? " with error." : ".") << std::endl;
+}
+
+/**
+ * executor_setup - attach containers and DB round to Executor,and
+ *                  recover the journal left by last run
+ * @exe:            Executor handler
+ * @db_round:       one round with DB
+ * @mfiles_list:    containers used to interactive with database
+ */
+static void executor_setup(mhwimm_executor &exe, const db_round_t &db_round,
+                           mhwimm_sync_mechanism_ns::mod_files_list &mfiles_list)
+{
+  exe.setMFLImpl(&mfiles_list);
+
+  // INSTALL asks DB for conflicts in the middle of the command,
+  // the round with DB is the same as "Before" and "After".
+  exe.setConflictQuery([&db_round, &mfiles_list](void) -> int {
+                         return db_round([&](void) {
+                                           return regDBop_find_conflicts(&mfiles_list);
+                                         }) ? 0 : -1;
+                       });
+
+  recover_unfinished_journal(exe, db_round, mfiles_list);
+}
+
+/**
+ * execute_cmd_line - parse and execute one command line
+ * @exe:              Executor handler
+ * @mfiles_list:      containers used to interactive with database
+ * @cmd_line:         the command line
+ * @db_round:         one round with DB
+ * @output:           receives the command output chunk by chunk
+ * return:            0 => command succeed,-1 => command failed
  * # the works that this routine will processes :
- *     1> wait user input in @ctrlmsg
- *     2> parse command input
- *     3> if cmd is INSTALL,then send DB request attempt to retrieve the
+ *     1> parse command input
+ *     2> if cmd is INSTALL,then send DB request attempt to retrieve the
  *        mod info for check whether this mod been installed;otherwise,
  *        install the mode and send DB request to add new records after
  *        INSTALL accomplished
- *     4> if cmd is UNINSTALL / INSTALLED,then send DB request for retrieve
- *        mod records before process the real operation
- *     5> send command output msg to UI via @ctrlmsg
+ *     3> if cmd is UNINSTALL / UPDATE / INSTALLED / RECONCILE / VERIFY,then send DB request
+ *        for retrieve mod records before process the real operation
+ *     4> send command output to @output in chunks,a chunk has
+ *        the whole lines up to OUTPUT_CHUNK_SIZE bytes
  */
-void mhwimm_executor_thread_worker(mhwimm_executor_ns::mhwimm_executor &exe,
-                                   mhwimm_sync_mechanism_ns::uiexemsgexchg &ctrlmsg,
-                                   mhwimm_sync_mechanism_ns::mod_files_list &mfiles_list)
+static int execute_cmd_line(mhwimm_executor &exe,
+                            mhwimm_sync_mechanism_ns::mod_files_list &mfiles_list,
+                            std::string_view cmd_line, const db_round_t &db_round,
+                            const cmd_output_t &output)
 {
-  using mhwimm_sync_mechanism_ns::UIEXE_STATUS;
+  std::string msg;
+  bool succeed(true);
+
+#ifdef DEBUG
+  std::size_t sget(0);
+#endif
 
-  makeup_uniquelock_and_associate_condv(exeui_lock, ctrlmsg.condv_sync);
-  exeui_lock.unlock();
+  // clear containers and status.
+  mfiles_list.lock.lock();
+  mfiles_list.regular_file_list.clear();
+  mfiles_list.directory_list.clear();
+  mfiles_list.mod_name_list.clear();
+  mfiles_list.conflict_list.clear();
+  mfiles_list.content_hash_list.clear();
+  mfiles_list.removed_list.clear();
+  mfiles_list.file_meta_list.clear();
+  mfiles_list.deployed_hash_list.clear();
+  mfiles_list.source_list.clear();
+  mfiles_list.mod_source.clear();
+  mfiles_list.lock.unlock();
+  exe.resetStatus();
 
-  makeup_uniquelock_and_associate_condv(exedb_lock, exedb_condv_sync);
-  exedb_lock.unlock();
+  (void)exe.parseCMD(cmd_line);
+  if (exe.currentStatus() == mhwimm_executor_status::ERROR) {
+    // Failed to parse user input
+    (void)exe.getCMDOutput(msg);
+    output(msg);
+    return -1;
+  }
 
-  exe.setMFLImpl(&mfiles_list);
-  for (; !program_exit;) {
-    // clear containers and status.
-    mfiles_list.lock.lock();
-    mfiles_list.regular_file_list.clear();
-    mfiles_list.directory_list.clear();
-    mfiles_list.mod_name_list.clear();
-    mfiles_list.lock.unlock();
-    exe.resetStatus();
-
-    // It is my round now !
-    ctrlmsg.condv_sync.wait_cond_odd(exeui_lock);
-    assert(ctrlmsg.status == UIEXE_STATUS::UI_CMD);
-    int ret = exe.parseCMD(ctrlmsg.io_buf);
-    if (exe.currentStatus() == mhwimm_executor_status::ERROR) {
-      // Failed to parse user input
-      (void)exe.getCMDOutput(ctrlmsg.io_buf);
-      ctrlmsg.status = UIEXE_STATUS::EXE_ONEMSG;
-      ctrlmsg.condv_sync.update_and_notify(exeui_lock);
-      continue;
-    }
+  /**
+   * Commands INSTALL, INSTALLED, UNINSTALL all of them
+   * must interactive with DB.
+   * INSTALL interactive to DB twice,one before
+   * do INSTALL,another one after done INSTALL.
+   * - (1)> is the mod been installed?
+   *   (2)> add the mod's info to database table
+   * INSTALLED interactive to DB once,before do INSTALLED.
+   * - (1)> retrieve the mod info from database
+   * UNINSTALL interactive to DB twice,one before
+   * do UNINSTALL,another one after done UNINSTALL.
+   * - (1)> retrieve the mod info from database
+   *   (2)> request database remove these records
+   *
+   * Synchronization :
+   *   @db_round queues the DB request,and returns after
+   *   the request accomplished.
+   *
+   * Before :
+   *   For INSTALL and UNINSTALL,we can combine them
+   *   together.
+   *   For INSTALLED,we need all installed mods' name.
+   * After :
+   *   For INSTALL,request DB add
+   *   For UNINSTALL,request DB remove
+   */
 
-    /**
-     * Commands INSTALL, INSTALLED, UNINSTALL all of them
-     * must interactive with DB.
-     * INSTALL interactive to DB twice,one before
-     * do INSTALL,another one after done INSTALL.
-     * - (1)> is the mod been installed?
-     *   (2)> add the mod's info to database table
-     * INSTALLED interactive to DB once,before do INSTALLED.
-     * - (1)> retrieve the mod info from database
-     * UNINSTALL interactive to DB twice,one before
-     * do UNINSTALL,another one after done UNINSTALL.
-     * - (1)> retrieve the mod info from database
-     *   (2)> request database remove these records
-     *
-     * Synchronization :
-     *   we get the condition variable at first,then
-     *   request DB operation,and put the condition
-     *   variable let DB start its work.
-     *   after the operation accomplished,we get
-     *   the condition variable again,but do not
-     *   put it,just unlock as well.because we
-     *   do not want DB to start a new transaction,
-     *   we have not installed a new one.
-     *
-     * Before :
-     *   For INSTALL and UNINSTALL,we can combine them
-     *   together.
-     *   For INSTALLED,we need all installed mods' name.
-     * After :
-     *   For INSTALL,request DB add
-     *   For UNINSTALL,request DB remove
-     */
-
-    // Before
-    if (exe.currentCMD() == mhwimm_executor_cmd::INSTALL ||
-        exe.currentCMD() == mhwimm_executor_cmd::UNINSTALL ||
-        exe.currentCMD() == mhwimm_executor_cmd::INSTALLED) {
-      // It is my round now!
-      exedb_condv_sync.wait_cond_even(exedb_lock);
-
-      // register DB operation.
-      switch (exe.currentCMD()) {
-      case mhwimm_executor_cmd::INSTALL:
-      case mhwimm_executor_cmd::UNINSTALL:
-        regDBop_getInstalled_Modinfo(exe.getCurrentModName(), &mfiles_list);
-        break;
-      case mhwimm_executor_cmd::INSTALLED:
-        regDBop_getAllInstalled_Modsname(&mfiles_list);
+  // Before
+  // UNINSTALL streams the records by itself if it is able to.
+  if (exe.currentCMD() == mhwimm_executor_cmd::INSTALL ||
+      (exe.currentCMD() == mhwimm_executor_cmd::UNINSTALL && !exe.hasRecordStream()) ||
+      exe.currentCMD() == mhwimm_executor_cmd::UPDATE ||
+      exe.currentCMD() == mhwimm_executor_cmd::INSTALLED ||
+      exe.currentCMD() == mhwimm_executor_cmd::STORE ||
+      exe.currentCMD() == mhwimm_executor_cmd::RECONCILE ||
+      exe.currentCMD() == mhwimm_executor_cmd::VERIFY) {
+    // register DB operation.
+    succeed = db_round([&](void) {
+                         switch (exe.currentCMD()) {
+                         case mhwimm_executor_cmd::INSTALLED:
+                           return regDBop_getAllInstalled_Modsname(&mfiles_list);
+                         case mhwimm_executor_cmd::STORE:
+                           // the blobs referenced by installed mods
+                           return regDBop_get_content_hashes(&mfiles_list);
+                         case mhwimm_executor_cmd::RECONCILE:
+                         case mhwimm_executor_cmd::VERIFY:
+                           // all mods if the name is not given
+                           return regDBop_get_file_meta(exe.getCurrentModName(), &mfiles_list);
+                         default:
+                           // INSTALL,UNINSTALL,UPDATE
+                           return regDBop_getInstalled_Modinfo(exe.getCurrentModName(),
+                                                               &mfiles_list);
+                         }
+                       });
+
+    if (succeed) {
+      if (exe.currentCMD() == mhwimm_executor_cmd::INSTALL &&
+          (mfiles_list.regular_file_list.size() != 0 ||
+           mfiles_list.directory_list.size() != 0)) {
+        // this mod been installed.
+        output(std::string{"executor thread error: This mod been installed."});
+        return -1;
       }
+      // else UNINSTALL or no files or (UNINSTALL and no files)
+    } else
+      goto failed_db_interact_checking;
+  }
 
-      // Round finished.
-      exedb_condv_sync.update_and_notify(exedb_lock);
-
-      exedb_condv_sync.wait_cond_even(exedb_lock);
-      exedb_condv_sync.unlock(exedb_lock); // DB stopped.
-
-      if (is_db_op_succeed) {
-        if (exe.currentCMD() == mhwimm_executor_cmd::INSTALL &&
-            (mfiles_list.regular_file_list.size() != 0 ||
-             mfiles_list.directory_list.size() != 0)) {
-          // this mod been installed.
-          ctrlmsg.io_buf = std::string{"executor thread error: This mod been installed."};
-          ctrlmsg.status = UIEXE_STATUS::EXE_ONEMSG;
-          ctrlmsg.condv_sync.update_and_notify(exeui_lock);
-          continue;
-        }
-        // else UNINSTALL or no files or (UNINSTALL and no files)
-      } else
-        goto failed_db_interact_checking;
-    }
+  // Executor process the parsed command.
+  exe.executeCurrentCMD();
+  if (exe.currentStatus() == mhwimm_executor_status::ERROR) {
+    // encountered error,now have to send error msgs,
+    // e.g. conflicts reported by INSTALL have many lines.
+    // the records queued by INSTALL are aborted,but DB may be still
+    // reading the lists,they must be kept until DB gave up.
+    if (exe.hasPendingRecord())
+      (void)exe.waitPendingRecord();
+    goto send_cmd_output;
+  }
 
-    // Executor process the parsed command.
-    exe.executeCurrentCMD();
-    if (exe.currentStatus() == mhwimm_executor_status::ERROR) {
-      // encountered error,now have to send error msg to UI.
-      exe.getCMDOutput(ctrlmsg.io_buf);
-      ctrlmsg.status = UIEXE_STATUS::EXE_ONEMSG;
-      ctrlmsg.condv_sync.update_and_notify(exeui_lock);
-      continue;
-    }
+  // After
+  if (exe.currentCMD() == mhwimm_executor_cmd::INSTALL ||
+      exe.currentCMD() == mhwimm_executor_cmd::UNINSTALL ||
+      exe.currentCMD() == mhwimm_executor_cmd::UPDATE) {
+    // INSTALL queued the records before deploying the mod,the hashes
+    // of the deployed files are recorded after them in their own
+    // transaction,the mod is installed even if they are not recorded.
+    if (exe.hasPendingRecord()) {
+      succeed = exe.waitPendingRecord();
+      if (succeed && !mfiles_list.deployed_hash_list.empty() &&
+          !db_round([&](void) {
+                      return regDBop_set_deployed_hashes(exe.getCurrentModName(),
+                                                         &mfiles_list);
+                    }))
+        output(std::string{"executor thread error: Failed to record content hashes,"
+                           " verify reports the files as unhashed."});
+    } else
+      succeed = db_round([&](void) {
+                           switch (exe.currentCMD()) {
+                           case mhwimm_executor_cmd::INSTALL:
+                             return regDBop_add_mod_info(exe.getCurrentModName(), &mfiles_list);
+                           case mhwimm_executor_cmd::UNINSTALL:
+                             return regDBop_remove_mod_info(exe.getCurrentModName());
+                           default:
+                             // UPDATE
+                             return regDBop_update_mod_info(exe.getCurrentModName(),
+                                                            &mfiles_list);
+                           }
+                         });
 
-    // After
-    if (exe.currentCMD() == mhwimm_executor_cmd::INSTALL ||
-        exe.currentCMD() == mhwimm_executor_cmd::UNINSTALL) {
-      // It is my round now!
-      exedb_condv_sync.wait_cond_even(exedb_lock);
+    // DB is consistent with filesystem,the journal is finished.
+    // UPDATE replaces the old version after the delta recorded,the
+    // records are kept if it failed,updating again converges.
+    if (succeed) {
+      if (exe.currentCMD() == mhwimm_executor_cmd::UPDATE)
+        (void)exe.finishUpdate();
+      (void)exe.commitJournal();
+    }
 
-      switch (exe.currentCMD()) {
-      case mhwimm_executor_cmd::INSTALL:
-        regDBop_add_mod_info(exe.getCurrentModName(), &mfiles_list);
-        break;
-      case mhwimm_executor_cmd::UNINSTALL:
-        regDBop_remove_mod_info(exe.getCurrentModName());
-      }
-      // Round finished.
-      exedb_condv_sync.update_and_notify(exedb_lock);
-
-      exedb_condv_sync.wait_cond_even(exedb_lock);
-      exedb_condv_sync.unlock(exedb_lock);
-
-    failed_db_interact_checking:
-      if (!is_db_op_succeed) {
-        if (exe.currentCMD() == mhwimm_executor_cmd::INSTALL) {
-          // we failed on add record for INSTALL,thus have to undo INSTALL.
-          exe.setCMD(mhwimm_executor_cmd::UNINSTALL);
-          exe.bypassSyntaxChecking(1);
-          if (exe.executeCurrentCMD() < 0) {
-            // undo INSTALL failed,
-            // stop application.
-            exe.setCMD(mhwimm_executor_cmd::EXIT);
-            exe.bypassSyntaxChecking(0);
-            exe.executeCurrentCMD();
-            ctrlmsg.io_buf = std::string{"executor thread error: "
-                                         "Failed to interactive with DB for INSTALL,"
-                                         "and failure undo INSTALL,application stopping!"};
-            ctrlmsg.status = UIEXE_STATUS::EXE_ONEMSG;
-            ctrlmsg.condv_sync.update_and_notify(exeui_lock);
-            continue;
-          }
+  failed_db_interact_checking:
+    if (!succeed) {
+      if (exe.currentCMD() == mhwimm_executor_cmd::INSTALL ||
+          exe.currentCMD() == mhwimm_executor_cmd::UPDATE) {
+        // we failed on add record for INSTALL,thus have to undo INSTALL,
+        // only the operations recorded in journal are undone.
+        // UPDATE is undone in the same way,the records are kept.
+        if (exe.rollbackJournal() < 0) {
+          // undo INSTALL failed,
+          // stop application.
+          exe.setCMD(mhwimm_executor_cmd::EXIT);
+          exe.bypassSyntaxChecking(0);
+          exe.executeCurrentCMD();
+          output(std::string{"executor thread error: "
+                             "Failed to interactive with DB for INSTALL,"
+                             "and failure undo INSTALL,application stopping!"});
+          return -1;
         }
-        ctrlmsg.io_buf = std::string{"executor thread error: Failed to interactive"
-                                     " with DB."};
-        ctrlmsg.status = UIEXE_STATUS::EXE_ONEMSG;
-        ctrlmsg.condv_sync.update_and_notify(exeui_lock);
-        continue;
       }
+      // the files of UNINSTALL been removed,but the records are kept.
+      (void)exe.commitJournal();
+      output(std::string{"executor thread error: Failed to interactive"
+                         " with DB."});
+      return -1;
     }
+  }
 
+  // From there,we send cmd output.
+ send_cmd_output:
+  succeed = exe.currentStatus() != mhwimm_executor_status::ERROR;
+  while (!exe.getCMDOutput(msg)) {
 #ifdef DEBUG
-    std::size_t sget(0);
+    sget++;
 #endif
-
-    // From there,we send cmd output to UI.
-    // We still holding the condition variable,now.
-    for (; ;) {
-      ret = exe.getCMDOutput(ctrlmsg.io_buf);
-      if (ret) {
-        ctrlmsg.status = UIEXE_STATUS::EXE_NOMSG;
-        ctrlmsg.condv_sync.update_and_notify(exeui_lock);
-        break; // break with release condv
-      }
-
+    output(msg);
+  }
 #ifdef DEBUG
-      sget++;
+  std::cerr << "\n Count succeed get command output msg : " << sget << std::endl;
 #endif
-      ctrlmsg.status = UIEXE_STATUS::EXE_MOREMSG;
-      ctrlmsg.condv_sync.update_and_notify(exeui_lock);
-      ctrlmsg.condv_sync.wait_cond_odd(exeui_lock);
+  return succeed ? 0 : -1;
+}
+
+/**
+ * mhwimm_executor_thread_worker - thread worker for Executor
+ * @exe:                           Executor handler
+ * @ctrlmsg:                       communication between Executor and UI
+ * @mfiles_list:                   structure holds some containers used
+ *                                 to interactive with database
+ * # pop command from @ctrlmsg,execute it and then push the command
+ *   output to UI via @ctrlmsg chunk by chunk,Executor waits for UI
+ *   only when the output ring is full.
+ */
+void mhwimm_executor_thread_worker(mhwimm_executor_ns::mhwimm_executor &exe,
+                                   mhwimm_sync_mechanism_ns::uiexemsgexchg &ctrlmsg,
+                                   mhwimm_sync_mechanism_ns::mod_files_list &mfiles_list)
+{
+  using mhwimm_sync_mechanism_ns::UIEXE_STATUS;
+  using mhwimm_sync_mechanism_ns::uiexemsg;
+
+  // the requests are processed by DB thread in order.
+  db_round_t db_round([](const std::function<std::future<bool>(void)> &req) -> bool {
+                        return req().get();
+                      });
+
+  executor_setup(exe, db_round, mfiles_list);
+
+  // INSTALL overlaps the insertion of its records with the deployment.
+  exe.setRecordSubmit([&exe, &mfiles_list](std::shared_future<bool> gate) {
+                        return regDBop_add_mod_info(exe.getCurrentModName(), &mfiles_list,
+                                                    std::move(gate));
+                      });
+
+  // UNINSTALL removes the files while DB is stepping the cursor,the
+  // stream is never used by the batch worker,because DB works in
+  // the same thread.
+  exe.setRecordStream([&exe](mhwimm_sync_mechanism_ns::path_stream *stream) {
+                        return regDBop_streamInstalled_Modinfo(exe.getCurrentModName(), stream);
+                      });
+
+  // waits for UI if the ring is full.
+  cmd_output_t output([&ctrlmsg](const std::string &msg) {
+                        ctrlmsg.output_ring.push(uiexemsg{
+                            .status = UIEXE_STATUS::EXE_MOREMSG,
+                            .io_buf = msg,
+                          });
+                      });
+
+  // the output of "ls" is flushed while listing.
+  exe.setOutputSink(output);
+
+  for (uiexemsg msg; !program_exit;) {
+    ctrlmsg.cmd_ring.pop(msg);
+    assert(msg.status == UIEXE_STATUS::UI_CMD);
+
+    // the parameters refer to @msg.io_buf until the command accomplished.
+    (void)execute_cmd_line(exe, mfiles_list, msg.io_buf, db_round, output);
+
+    // end of the command output,the buffer goes back to UI for the next
+    // input line.
+    msg.io_buf.clear();
+    ctrlmsg.output_ring.push(uiexemsg{
+        .status = program_exit ? UIEXE_STATUS::EXE_STOPPED : UIEXE_STATUS::EXE_NOMSG,
+        .io_buf = std::move(msg.io_buf),
+      });
+  }
+
+  regDBop_stop();
+}
+
+/**
+ * mhwimm_executor_batch_worker - execute command lines without UI and
+ *                                DB threads
+ * @exe:                          Executor handler
+ * @mfiles_list:                  structure holds some containers used
+ *                                to interactive with database
+ * @db:                           database handler,been prepared
+ * @cmd_lines:                    command lines to be executed in order
+ * @keep_going:                   continue after a command failed
+ * return:                        the count of failed commands
+ * # DB operations are processed in the current thread,and the command
+ *   output is written to stdout,error of a command to stderr.
+ */
+int mhwimm_executor_batch_worker(mhwimm_executor_ns::mhwimm_executor &exe,
+                                 mhwimm_sync_mechanism_ns::mod_files_list &mfiles_list,
+                                 mhwimm_db_ns::mhwimm_db &db,
+                                 const std::vector<std::string> &cmd_lines,
+                                 bool keep_going)
+{
+  int nfailed(0);
+  std::vector<std::string> msgs;
+
+  // the records of INSTALL are queued after deploying,because
+  // the request is processed at once.
+  db_round_t db_round([&db](const std::function<std::future<bool>(void)> &req) -> bool {
+                        std::future<bool> f(req());
+                        mhwimm_db_process_queue(db);
+                        return f.get();
+                      });
+
+  // the output is held until the command finished,because where it
+  // goes depends on the result.
+  cmd_output_t output([&msgs](const std::string &msg) {
+                        msgs.push_back(msg);
+                      });
+
+  // but the chunks flushed while listing go to stdout at once,the
+  // memory is bounded for a huge directory.
+  exe.setOutputSink([](const std::string &msg) {
+                      std::cout << msg << '\n';
+                    });
+
+  executor_setup(exe, db_round, mfiles_list);
+
+  for (std::size_t i(0); i < cmd_lines.size() && !program_exit; ++i) {
+    msgs.clear();
+    int ret(execute_cmd_line(exe, mfiles_list, cmd_lines[i], db_round, output));
+    // UI sends "nop" to Executor when exiting,but nobody writes it in a script.
+    if (ret == 0 && exe.currentCMD() == mhwimm_executor_cmd::NOP) {
+      msgs.push_back(std::string{"error: Unknown cmd."});
+      ret = -1;
+    }
+    std::ostream &os(ret < 0 ? std::cerr : std::cout);
+    for (auto &msg : msgs)
+      os << msg << '\n';
+    os.flush();
+
+    if (ret < 0) {
+      std::cerr << "mhwimm: command " << i + 1 << " failed - " << cmd_lines[i] << std::endl;
+      ++nfailed;
+      if (!keep_going)
+        break;
     }
-#ifdef DEBUG
-    std::cerr << "\n Count succeed get command output msg : " << sget << std::endl;
-#endif
   }
 
-  exedb_condv_sync.wait_cond_even(exedb_lock);
-  exedb_condv_sync.update_and_notify(exedb_lock); // release to let DB executing.
+  return nfailed;
 }
@@ -0,0 +1,354 @@
+/**
+ * Member Method Definitions of fs_batch
+ * io_uring is used via raw system calls,no liburing is needed.
+ * the support of IORING_OP_MKDIRAT,IORING_OP_LINKAT and
+ * IORING_OP_UNLINKAT is probed when the ring is setup,if any
+ * of them is unsupported,operations are executed synchronously.
+ */
+#include "mhwimm_fsbatch.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>) && __has_include(<linux/version.h>)
+#include <linux/version.h>
+// the opcodes for metadata operations came with 5.15
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+#define MHWIMM_HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef MHWIMM_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace mhwimm_fsbatch_ns {
+
+#ifdef MHWIMM_HAVE_IO_URING
+
+  /**
+   * uring_impl - the mapped rings
+   * # @sq_tail and @cq_head are only written by us,@sq_head and
+   *   @cq_tail are written by kernel,they are accessed with
+   *   acquire / release semantic.
+   */
+  struct fs_batch::uring_impl {
+    int fd;
+    unsigned int sq_entries;
+
+    void *sq_ring;
+    std::size_t sq_ring_sz;
+    void *cq_ring;
+    std::size_t cq_ring_sz;
+    struct io_uring_sqe *sqes;
+    std::size_t sqes_sz;
+
+    unsigned int *sq_head;
+    unsigned int *sq_tail;
+    unsigned int *sq_mask;
+    unsigned int *sq_array;
+    unsigned int *cq_head;
+    unsigned int *cq_tail;
+    unsigned int *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    ~uring_impl()
+    {
+      if (sqes)
+        (void)munmap(sqes, sqes_sz);
+      if (cq_ring && cq_ring != sq_ring)
+        (void)munmap(cq_ring, cq_ring_sz);
+      if (sq_ring)
+        (void)munmap(sq_ring, sq_ring_sz);
+      if (fd >= 0)
+        (void)close(fd);
+    }
+  };
+
+  static int io_uring_setup(unsigned int entries, struct io_uring_params *p)
+  {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, p));
+  }
+
+  static int io_uring_enter(int fd, unsigned int to_submit,
+                            unsigned int min_complete, unsigned int flags)
+  {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit,
+                                    min_complete, flags, nullptr, 0));
+  }
+
+  static int io_uring_register(int fd, unsigned int opcode, void *arg,
+                               unsigned int nr_args)
+  {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+  }
+
+  /* probe_ops - check whether the kernel supports the opcodes we need */
+  static bool probe_ops(int fd)
+  {
+    constexpr unsigned int nprobe_ops = 256;
+    std::size_t probe_sz(sizeof(struct io_uring_probe) +
+                         nprobe_ops * sizeof(struct io_uring_probe_op));
+    std::unique_ptr<char[]> buf(new char[probe_sz]());
+    auto *probe(reinterpret_cast<struct io_uring_probe *>(buf.get()));
+
+    if (io_uring_register(fd, IORING_REGISTER_PROBE, probe, nprobe_ops) < 0)
+      return false;
+
+    for (unsigned int op : { IORING_OP_MKDIRAT, IORING_OP_LINKAT, IORING_OP_UNLINKAT })
+      if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+        return false;
+    return true;
+  }
+
+  fs_batch::fs_batch(unsigned int entries)
+  {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    std::unique_ptr<uring_impl> ring(new uring_impl {
+        .fd = io_uring_setup(entries, &params),
+      });
+    if (ring->fd < 0 || !probe_ops(ring->fd))
+      return;
+
+    ring->sq_entries = params.sq_entries;
+    ring->sq_ring_sz = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    ring->cq_ring_sz = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      if (ring->cq_ring_sz > ring->sq_ring_sz)
+        ring->sq_ring_sz = ring->cq_ring_sz;
+      ring->cq_ring_sz = ring->sq_ring_sz;
+    }
+
+    void *p(mmap(nullptr, ring->sq_ring_sz, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING));
+    if (p == MAP_FAILED)
+      return;
+    ring->sq_ring = p;
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+      ring->cq_ring = ring->sq_ring;
+    else {
+      p = mmap(nullptr, ring->cq_ring_sz, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+      if (p == MAP_FAILED)
+        return;
+      ring->cq_ring = p;
+    }
+
+    ring->sqes_sz = params.sq_entries * sizeof(struct io_uring_sqe);
+    p = mmap(nullptr, ring->sqes_sz, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (p == MAP_FAILED)
+      return;
+    ring->sqes = static_cast<struct io_uring_sqe *>(p);
+
+    auto *sq(static_cast<char *>(ring->sq_ring));
+    auto *cq(static_cast<char *>(ring->cq_ring));
+    ring->sq_head = reinterpret_cast<unsigned int *>(sq + params.sq_off.head);
+    ring->sq_tail = reinterpret_cast<unsigned int *>(sq + params.sq_off.tail);
+    ring->sq_mask = reinterpret_cast<unsigned int *>(sq + params.sq_off.ring_mask);
+    ring->sq_array = reinterpret_cast<unsigned int *>(sq + params.sq_off.array);
+    ring->cq_head = reinterpret_cast<unsigned int *>(cq + params.cq_off.head);
+    ring->cq_tail = reinterpret_cast<unsigned int *>(cq + params.cq_off.tail);
+    ring->cq_mask = reinterpret_cast<unsigned int *>(cq + params.cq_off.ring_mask);
+    ring->cqes = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    uring_ = std::move(ring);
+  }
+
+  /* prep_sqe - fill @sqe with @op,user_data is index of @op */
+  static void prep_sqe(struct io_uring_sqe *sqe, int dirfd, const fs_op &op,
+                       mode_t mode, std::size_t idx)
+  {
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = idx;
+    switch (op.type) {
+    case fs_op_type::FS_MKDIR:
+      sqe->opcode = IORING_OP_MKDIRAT;
+      sqe->fd = dirfd;
+      sqe->addr = reinterpret_cast<uintptr_t>(op.path);
+      sqe->len = mode;
+      break;
+    case fs_op_type::FS_LINK:
+      sqe->opcode = IORING_OP_LINKAT;
+      sqe->fd = AT_FDCWD;
+      sqe->addr = reinterpret_cast<uintptr_t>(op.src);
+      sqe->len = dirfd;
+      sqe->addr2 = reinterpret_cast<uintptr_t>(op.path);
+      sqe->hardlink_flags = 0;
+      break;
+    case fs_op_type::FS_UNLINK:
+      sqe->opcode = IORING_OP_UNLINKAT;
+      sqe->fd = dirfd;
+      sqe->addr = reinterpret_cast<uintptr_t>(op.path);
+      sqe->unlink_flags = 0;
+      break;
+    case fs_op_type::FS_RMDIR:
+      sqe->opcode = IORING_OP_UNLINKAT;
+      sqe->fd = dirfd;
+      sqe->addr = reinterpret_cast<uintptr_t>(op.path);
+      sqe->unlink_flags = AT_REMOVEDIR;
+      break;
+    case fs_op_type::FS_COPY:
+    case fs_op_type::FS_EXTRACT:
+      // never submitted,see execute()
+      break;
+    }
+  }
+
+  /**
+   * executeUring - submit @ops to io_uring
+   * # no more than @sq_entries operations are in flight,thus the
+   *   completion queue (twice as large as submission queue) never
+   *   overflows.
+   * # if io_uring_enter() failed,the ring is destroyed after all
+   *   operations in flight completed,and the remaining operations
+   *   are left to the caller.
+   */
+  std::size_t fs_batch::executeUring(int dirfd, fs_op *ops, std::size_t nops, mode_t mode)
+  {
+    uring_impl &ring(*uring_);
+    std::size_t next(0);          // next operation to be queued
+    unsigned int unconsumed(0);   // queued but not consumed by kernel
+    unsigned int inflight(0);     // consumed but not completed
+    bool broken(false);
+
+    while (next < nops || unconsumed || inflight) {
+      // queue operations
+      unsigned int tail(*ring.sq_tail);
+      unsigned int queued(0);
+      while (!broken && next < nops && unconsumed + inflight + queued < ring.sq_entries) {
+        unsigned int idx(tail & *ring.sq_mask);
+        prep_sqe(&ring.sqes[idx], dirfd, ops[next], mode, next);
+        ring.sq_array[idx] = idx;
+        ++tail;
+        ++next;
+        ++queued;
+      }
+      if (queued)
+        __atomic_store_n(ring.sq_tail, tail, __ATOMIC_RELEASE);
+      unconsumed += queued;
+
+      int ret(io_uring_enter(ring.fd, broken ? 0 : unconsumed, inflight || unconsumed ? 1 : 0,
+                             IORING_ENTER_GETEVENTS));
+      if (ret < 0) {
+        if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+          continue;
+        if (broken) {
+          // can not wait for the completions any more,the results
+          // of the operations in flight are unknown.
+          for (std::size_t i(0); i < next; ++i)
+            if (ops[i].result == fs_op_pending)
+              ops[i].result = -EIO;
+          inflight = 0;
+          break;
+        }
+        broken = true;
+        // unconsumed entries would never be executed
+        next -= unconsumed;
+        unconsumed = 0;
+        continue;
+      }
+      if (!broken) {
+        unconsumed -= ret;
+        inflight += ret;
+      }
+
+      // reap completions
+      unsigned int head(*ring.cq_head);
+      unsigned int cq_tail(__atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE));
+      for (; head != cq_tail; ++head) {
+        const struct io_uring_cqe &cqe(ring.cqes[head & *ring.cq_mask]);
+        ops[cqe.user_data].result = cqe.res;
+        --inflight;
+      }
+      __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+
+      if (broken && !inflight)
+        break;
+    }
+
+    if (broken)
+      uring_.reset();
+    return next;
+  }
+
+#else
+
+  struct fs_batch::uring_impl {};
+
+  fs_batch::fs_batch(unsigned int entries)
+  {
+    (void)entries;
+  }
+
+  std::size_t fs_batch::executeUring(int dirfd, fs_op *ops, std::size_t nops, mode_t mode)
+  {
+    (void)dirfd, (void)ops, (void)nops, (void)mode;
+    return 0;
+  }
+
+#endif
+
+  fs_batch::~fs_batch() =default;
+
+  void fs_batch::executeSync(int dirfd, fs_op *ops, std::size_t nops, mode_t mode)
+  {
+    for (std::size_t i(0); i < nops; ++i) {
+      int ret(0);
+      switch (ops[i].type) {
+      case fs_op_type::FS_MKDIR:
+        ret = mkdirat(dirfd, ops[i].path, mode);
+        break;
+      case fs_op_type::FS_LINK:
+        ret = linkat(AT_FDCWD, ops[i].src, dirfd, ops[i].path, 0);
+        break;
+      case fs_op_type::FS_UNLINK:
+        ret = unlinkat(dirfd, ops[i].path, 0);
+        break;
+      case fs_op_type::FS_RMDIR:
+        ret = unlinkat(dirfd, ops[i].path, AT_REMOVEDIR);
+        break;
+      case fs_op_type::FS_COPY:
+      case fs_op_type::FS_EXTRACT:
+        ret = -1;
+        errno = EINVAL;
+        break;
+      }
+      ops[i].result = ret < 0 ? -errno : 0;
+    }
+  }
+
+  std::size_t fs_batch::execute(int dirfd, fs_op *ops, std::size_t nops, mode_t mode)
+  {
+    for (std::size_t i(0); i < nops; ++i)
+      ops[i].result = fs_op_pending;
+
+    // copying and extraction are not metadata operations,never submit them
+    bool has_copy(false);
+    for (std::size_t i(0); i < nops; ++i)
+      if (ops[i].type == fs_op_type::FS_COPY || ops[i].type == fs_op_type::FS_EXTRACT)
+        has_copy = true;
+
+    std::size_t nsubmitted(0);
+    if (uring_ && !has_copy)
+      nsubmitted = executeUring(dirfd, ops, nops, mode);
+    if (nsubmitted < nops)
+      executeSync(dirfd, ops + nsubmitted, nops - nsubmitted, mode);
+
+    std::size_t nfailed(0);
+    for (std::size_t i(0); i < nops; ++i)
+      if (ops[i].result)
+        ++nfailed;
+    return nfailed;
+  }
+
+}
@@ -0,0 +1,185 @@
+/**
+ * XXH64
+ * Four lanes consume 32 bytes stripes independently,thus the
+ * compiler can keep them in registers and overlap multiplications.
+ */
+#include "mhwimm_hash.h"
+
+#include <cerrno>
+#include <cstring>
+#include <memory>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace mhwimm_hash_ns {
+
+  static constexpr uint64_t prime64_1 = 0x9E3779B185EBCA87ULL;
+  static constexpr uint64_t prime64_2 = 0xC2B2AE3D27D4EB4FULL;
+  static constexpr uint64_t prime64_3 = 0x165667B19E3779F9ULL;
+  static constexpr uint64_t prime64_4 = 0x85EBCA77C2B2AE63ULL;
+  static constexpr uint64_t prime64_5 = 0x27D4EB2F165667C5ULL;
+
+  /* hash_buf_size - size of read buffer of hash_fd() */
+  static constexpr std::size_t hash_buf_size = 1 << 20;
+
+  static inline uint64_t rotl64(uint64_t v, int r)
+  {
+    return (v << r) | (v >> (64 - r));
+  }
+
+  /**
+   * read_le64 - XXH64 is defined on little-endian words,it is one
+   *             unaligned load on little-endian host
+   */
+  static inline uint64_t read_le64(const unsigned char *p)
+  {
+    uint64_t v(0);
+    memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+  }
+
+  static inline uint32_t read_le32(const unsigned char *p)
+  {
+    uint32_t v(0);
+    memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+  }
+
+  static inline uint64_t xxh64_round(uint64_t acc, uint64_t input)
+  {
+    acc += input * prime64_2;
+    acc = rotl64(acc, 31);
+    return acc * prime64_1;
+  }
+
+  static inline uint64_t xxh64_merge_round(uint64_t acc, uint64_t val)
+  {
+    acc ^= xxh64_round(0, val);
+    return acc * prime64_1 + prime64_4;
+  }
+
+  void xxh64_state::reset(uint64_t seed) noexcept
+  {
+    seed_ = seed;
+    acc_[0] = seed + prime64_1 + prime64_2;
+    acc_[1] = seed + prime64_2;
+    acc_[2] = seed;
+    acc_[3] = seed - prime64_1;
+    total_len_ = 0;
+    buf_len_ = 0;
+  }
+
+  void xxh64_state::update(const void *data, std::size_t len) noexcept
+  {
+    const unsigned char *p(static_cast<const unsigned char *>(data));
+    const unsigned char *end(p + len);
+    total_len_ += len;
+
+    if (buf_len_ + len < sizeof(buf_)) {
+      memcpy(buf_ + buf_len_, p, len);
+      buf_len_ += len;
+      return;
+    }
+
+    if (buf_len_) {
+      std::size_t fill(sizeof(buf_) - buf_len_);
+      memcpy(buf_ + buf_len_, p, fill);
+      for (int i(0); i < 4; ++i)
+        acc_[i] = xxh64_round(acc_[i], read_le64(buf_ + 8 * i));
+      p += fill;
+      buf_len_ = 0;
+    }
+
+    uint64_t v1(acc_[0]), v2(acc_[1]), v3(acc_[2]), v4(acc_[3]);
+    for (; end - p >= 32; p += 32) {
+      v1 = xxh64_round(v1, read_le64(p));
+      v2 = xxh64_round(v2, read_le64(p + 8));
+      v3 = xxh64_round(v3, read_le64(p + 16));
+      v4 = xxh64_round(v4, read_le64(p + 24));
+    }
+    acc_[0] = v1, acc_[1] = v2, acc_[2] = v3, acc_[3] = v4;
+
+    buf_len_ = end - p;
+    memcpy(buf_, p, buf_len_);
+  }
+
+  uint64_t xxh64_state::digest(void) const noexcept
+  {
+    uint64_t h(0);
+    if (total_len_ >= 32) {
+      h = rotl64(acc_[0], 1) + rotl64(acc_[1], 7) + rotl64(acc_[2], 12) + rotl64(acc_[3], 18);
+      for (int i(0); i < 4; ++i)
+        h = xxh64_merge_round(h, acc_[i]);
+    } else
+      h = seed_ + prime64_5;
+    h += total_len_;
+
+    const unsigned char *p(buf_);
+    const unsigned char *end(buf_ + buf_len_);
+    for (; end - p >= 8; p += 8) {
+      h ^= xxh64_round(0, read_le64(p));
+      h = rotl64(h, 27) * prime64_1 + prime64_4;
+    }
+    if (end - p >= 4) {
+      h ^= static_cast<uint64_t>(read_le32(p)) * prime64_1;
+      h = rotl64(h, 23) * prime64_2 + prime64_3;
+      p += 4;
+    }
+    for (; p < end; ++p) {
+      h ^= *p * prime64_5;
+      h = rotl64(h, 11) * prime64_1;
+    }
+
+    // avalanche
+    h ^= h >> 33;
+    h *= prime64_2;
+    h ^= h >> 29;
+    h *= prime64_3;
+    h ^= h >> 32;
+    return h;
+  }
+
+  int hash_fd(int fd, uint64_t &digest, uint64_t &size)
+  {
+    // one buffer for each worker
+    static thread_local std::unique_ptr<unsigned char[]> buf;
+    if (!buf)
+      buf.reset(new unsigned char[hash_buf_size]);
+
+    (void)posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    xxh64_state state;
+    size = 0;
+    for (; ;) {
+      ssize_t nread(read(fd, buf.get(), hash_buf_size));
+      if (nread < 0) {
+        if (errno == EINTR)
+          continue;
+        return -errno;
+      }
+      if (!nread)
+        break;
+      state.update(buf.get(), nread);
+      size += nread;
+    }
+    digest = state.digest();
+    return 0;
+  }
+
+  std::string content_key(uint64_t digest, uint64_t size)
+  {
+    char key[40] = {0};
+    (void)snprintf(key, sizeof(key), "%016llx-%llx",
+                   static_cast<unsigned long long>(digest),
+                   static_cast<unsigned long long>(size));
+    return key;
+  }
+
+}
@@ -0,0 +1,245 @@
+/**
+ * Member Method Definitions of intent_journal
+ */
+#include "mhwimm_journal.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace mhwimm_journal_ns {
+
+  static constexpr char journal_magic[4] = { 'M', 'H', 'W', 'J' };
+  static constexpr uint8_t journal_version = 1;
+  static constexpr char record_plan = 'P';
+  static constexpr char record_done = 'D';
+
+  template<typename _IntType>
+  static void put_int(std::string &buf, _IntType v)
+  {
+    buf.append(reinterpret_cast<const char *>(&v), sizeof(v));
+  }
+
+  static void put_str(std::string &buf, const char *s, std::size_t len)
+  {
+    put_int(buf, static_cast<uint16_t>(len));
+    buf.append(s, len);
+  }
+
+  /**
+   * journal_reader - bounds checked reader of journal data
+   * # any get routine returns false if no enough data.
+   */
+  struct journal_reader {
+    const char *pos;
+    const char *end;
+
+    template<typename _IntType>
+    bool get_int(_IntType &v)
+    {
+      if (static_cast<std::size_t>(end - pos) < sizeof(v))
+        return false;
+      memcpy(&v, pos, sizeof(v));
+      pos += sizeof(v);
+      return true;
+    }
+
+    bool get_str(std::string &s)
+    {
+      uint16_t len(0);
+      if (!get_int(len) || static_cast<std::size_t>(end - pos) < len)
+        return false;
+      s.assign(pos, len);
+      pos += len;
+      return true;
+    }
+  };
+
+  int intent_journal::begin(const std::string &path, journal_cmd cmd, const std::string &mod_name,
+                            const std::string &root, const std::string &src_root)
+  {
+    close();
+    fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_APPEND | O_CLOEXEC, 0644);
+    if (fd_ < 0)
+      return -1;
+    path_ = path;
+
+    std::string header;
+    header.append(journal_magic, sizeof(journal_magic));
+    put_int(header, journal_version);
+    put_int(header, static_cast<uint8_t>(cmd));
+    put_str(header, mod_name.c_str(), mod_name.length());
+    put_str(header, root.c_str(), root.length());
+    put_str(header, src_root.c_str(), src_root.length());
+    if (append(header, true) < 0)
+      goto err_remove;
+
+    // make the new directory entry durable as well
+    {
+      std::string dir(path.substr(0, path.rfind('/') + 1));
+      int dirfd(open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+      if (dirfd >= 0) {
+        (void)fsync(dirfd);
+        (void)::close(dirfd);
+      }
+    }
+    return 0;
+
+  err_remove:
+    (void)unlink(path_.c_str());
+    close();
+    return -1;
+  }
+
+  int intent_journal::plan(mhwimm_fsbatch_ns::fs_op_type type,
+                           const mhwimm_fsbatch_ns::fs_op *ops, std::size_t nops)
+  {
+    std::string record;
+    record.push_back(record_plan);
+    put_int(record, static_cast<uint8_t>(type));
+    put_int(record, static_cast<uint32_t>(nops));
+    for (std::size_t i(0); i < nops; ++i)
+      put_str(record, ops[i].path, strlen(ops[i].path));
+    return append(record, true);
+  }
+
+  int intent_journal::done(const mhwimm_fsbatch_ns::fs_op *ops, std::size_t nops)
+  {
+    std::string record;
+    record.push_back(record_done);
+    put_int(record, static_cast<uint32_t>(nops));
+
+    std::size_t bitmap_pos(record.length());
+    record.append((nops + 7) / 8, '\0');
+    for (std::size_t i(0); i < nops; ++i)
+      if (!ops[i].result)
+        record[bitmap_pos + i / 8] |= static_cast<char>(1 << (i % 8));
+    return append(record, false);
+  }
+
+  int intent_journal::commit(void)
+  {
+    if (fd_ < 0)
+      return -1;
+    close();
+    return unlink(path_.c_str());
+  }
+
+  void intent_journal::close(void)
+  {
+    if (fd_ >= 0)
+      (void)::close(fd_);
+    fd_ = -1;
+  }
+
+  /* append - write @record at the end of journal,@sync for fdatasync */
+  int intent_journal::append(const std::string &record, bool sync)
+  {
+    if (fd_ < 0)
+      return -1;
+
+    const char *pos(record.data());
+    std::size_t left(record.length());
+    while (left) {
+      ssize_t nwritten(write(fd_, pos, left));
+      if (nwritten < 0) {
+        if (errno == EINTR)
+          continue;
+        return -1;
+      }
+      pos += nwritten;
+      left -= nwritten;
+    }
+    return sync ? fdatasync(fd_) : 0;
+  }
+
+  int intent_journal::load(const std::string &path, journal_content &content)
+  {
+    int fd(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd < 0)
+      return errno == ENOENT ? 0 : -1;
+
+    struct stat journal_stat = {0};
+    if (fstat(fd, &journal_stat) < 0) {
+      (void)::close(fd);
+      return -1;
+    }
+
+    std::string data(journal_stat.st_size, '\0');
+    std::size_t nread(0);
+    while (nread < data.length()) {
+      ssize_t ret(read(fd, &data[nread], data.length() - nread));
+      if (ret < 0 && errno == EINTR)
+        continue;
+      if (ret <= 0)
+        break;
+      nread += ret;
+    }
+    (void)::close(fd);
+    data.resize(nread);
+
+    journal_reader reader = {
+      .pos = data.data(),
+      .end = data.data() + data.length(),
+    };
+
+    // header
+    uint8_t version(0), cmd(0);
+    if (data.length() < sizeof(journal_magic) ||
+        memcmp(reader.pos, journal_magic, sizeof(journal_magic)))
+      return 0;
+    reader.pos += sizeof(journal_magic);
+    if (!reader.get_int(version) || !reader.get_int(cmd) ||
+        !reader.get_str(content.mod_name) || !reader.get_str(content.root) ||
+        !reader.get_str(content.src_root))
+      return 0;
+    if (version != journal_version)
+      return -1;
+    content.cmd = static_cast<journal_cmd>(cmd);
+    content.batches.clear();
+
+    // records
+    for (; ;) {
+      char type(0);
+      if (!reader.get_int(type))
+        break;
+
+      if (type == record_plan) {
+        journal_batch batch;
+        uint8_t op_type(0);
+        uint32_t nops(0);
+        // every path has its length at least,a larger count is corrupted
+        if (!reader.get_int(op_type) || !reader.get_int(nops) ||
+            nops > static_cast<std::size_t>(reader.end - reader.pos) / sizeof(uint16_t))
+          break;
+        batch.type = static_cast<mhwimm_fsbatch_ns::fs_op_type>(op_type);
+        batch.paths.resize(nops);
+        uint32_t i(0);
+        for (; i < nops; ++i)
+          if (!reader.get_str(batch.paths[i]))
+            break;
+        if (i < nops)
+          break;
+        batch.states.assign(nops, journal_op_state::OP_UNKNOWN);
+        content.batches.push_back(std::move(batch));
+      } else if (type == record_done) {
+        uint32_t nops(0);
+        if (!reader.get_int(nops) || content.batches.empty() ||
+            content.batches.back().paths.size() != nops ||
+            static_cast<std::size_t>(reader.end - reader.pos) < (nops + 7) / 8)
+          break;
+        auto &states(content.batches.back().states);
+        for (uint32_t i(0); i < nops; ++i)
+          states[i] = (reader.pos[i / 8] & (1 << (i % 8))) ?
+            journal_op_state::OP_DONE : journal_op_state::OP_FAILED;
+        reader.pos += (nops + 7) / 8;
+      } else
+        break;
+    }
+    return 1;
+  }
+
+}
@@ -0,0 +1,291 @@
+/**
+ * Content-addressed Store
+ * Files are hashed by the workers in parallel,the contents not
+ * stored yet are cloned or copied into tmp and then renamed to
+ * their blob,thus a blob never be partial.
+ */
+#include "mhwimm_store.h"
+#include "mhwimm_hash.h"
+#include "mhwimm_deploy.h"
+#include "mhwimm_dirscan.h"
+
+#include <atomic>
+#include <cerrno>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace mhwimm_store_ns {
+
+  static constexpr const char *objects_dir = "objects";
+  static constexpr const char *tmp_dir = "tmp";
+  static constexpr const char *staging_dir = "staging";
+
+  /* make_readonly - blob must not be modified through any link */
+  static void make_readonly(int dirfd, const char *path)
+  {
+    struct stat blob_stat = {0};
+    if (fstatat(dirfd, path, &blob_stat, AT_SYMLINK_NOFOLLOW) == 0)
+      (void)fchmodat(dirfd, path, blob_stat.st_mode & 0555, 0);
+  }
+
+  /**
+   * remove_contents - remove everything under @path relative to @dirfd
+   * return:           0 OR -1
+   */
+  static int remove_contents(int dirfd, const char *path)
+  {
+    mhwimm_dirscan_ns::dir_scanner scanner(8 * 1024);
+    if (scanner.open(dirfd, path) < 0)
+      return errno == ENOENT ? 0 : -1;
+
+    int ret(0);
+    const char *name(nullptr);
+    mhwimm_dirscan_ns::dentry_type type(mhwimm_dirscan_ns::dentry_type::ENT_OTHER);
+    while ((ret = scanner.next(name, type)) > 0) {
+      if (type == mhwimm_dirscan_ns::dentry_type::ENT_DIRECTORY) {
+        if (remove_contents(scanner.fd(), name) < 0 ||
+            unlinkat(scanner.fd(), name, AT_REMOVEDIR) < 0)
+          ret = -1;
+      } else if (unlinkat(scanner.fd(), name, 0) < 0)
+        ret = -1;
+      if (ret < 0)
+        break;
+    }
+    return ret;
+  }
+
+  int content_store::open(const std::string &root)
+  {
+    close();
+    if (mkdir(root.c_str(), 0755) < 0 && errno != EEXIST)
+      return -1;
+    root_fd_ = ::open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (root_fd_ < 0)
+      return -1;
+    root_ = root;
+
+    for (const char *dir : { objects_dir, tmp_dir, staging_dir })
+      if (mkdirat(root_fd_, dir, 0755) < 0 && errno != EEXIST) {
+        close();
+        return -1;
+      }
+    return 0;
+  }
+
+  void content_store::close(void)
+  {
+    if (root_fd_ >= 0)
+      (void)::close(root_fd_);
+    root_fd_ = -1;
+    root_.clear();
+  }
+
+  std::string content_store::blobSubpath(const std::string &key)
+  {
+    return std::string{objects_dir} + "/" + key.substr(0, 2) + "/" + key;
+  }
+
+  std::string content_store::blobPath(const std::string &key) const
+  {
+    return root_ + "/" + blobSubpath(key);
+  }
+
+  std::size_t content_store::ingest(ingest_op *ops, std::size_t nops,
+                                    mhwimm_thread_pool_ns::work_stealing_pool &pool)
+  {
+    if (!isOpened()) {
+      for (std::size_t i(0); i < nops; ++i)
+        ops[i].result = -EBADF;
+      return nops;
+    }
+
+    // step1 : hash in parallel
+    for (std::size_t i(0); i < nops; ++i) {
+      ingest_op *op(&ops[i]);
+      pool.submit([op](void) -> void {
+                    int fd(::open(op->src, O_RDONLY | O_CLOEXEC));
+                    if (fd < 0) {
+                      op->result = -errno;
+                      return;
+                    }
+                    uint64_t digest(0), size(0);
+                    op->result = mhwimm_hash_ns::hash_fd(fd, digest, size);
+                    (void)::close(fd);
+                    if (!op->result)
+                      op->key = mhwimm_hash_ns::content_key(digest, size);
+                  });
+    }
+    pool.wait();
+
+    // step2 : store the contents not stored yet
+    // @tmp_paths never reallocate,the copy operations refer to its elements.
+    std::unordered_map<std::string, ingest_op *> first_of;
+    std::vector<std::string> tmp_paths;
+    std::vector<mhwimm_fsbatch_ns::fs_op> copy_ops;
+    std::vector<ingest_op *> copy_owners;
+    tmp_paths.reserve(nops);
+
+    for (std::size_t i(0); i < nops; ++i) {
+      ingest_op *op(&ops[i]);
+      if (op->result)
+        continue;
+      if (!first_of.emplace(op->key, op).second) {
+        // the same content in this batch
+        if (op->move)
+          (void)unlink(op->src);
+        continue;
+      }
+
+      std::string subpath(blobSubpath(op->key));
+      struct stat blob_stat = {0};
+      if (fstatat(root_fd_, subpath.c_str(), &blob_stat, AT_SYMLINK_NOFOLLOW) == 0) {
+        if (op->move)
+          (void)unlink(op->src);
+        continue;
+      }
+
+      std::string fanout(subpath.substr(0, subpath.rfind('/')));
+      if (mkdirat(root_fd_, fanout.c_str(), 0755) < 0 && errno != EEXIST) {
+        op->result = -errno;
+        continue;
+      }
+
+      if (op->move) {
+        if (renameat(AT_FDCWD, op->src, root_fd_, subpath.c_str()) < 0)
+          op->result = -errno;
+        else
+          make_readonly(root_fd_, subpath.c_str());
+        continue;
+      }
+
+      tmp_paths.push_back(std::string{tmp_dir} + "/" + op->key);
+      // left by an interrupted run
+      (void)unlinkat(root_fd_, tmp_paths.back().c_str(), 0);
+      copy_ops.push_back(mhwimm_fsbatch_ns::fs_op {
+          .type = mhwimm_fsbatch_ns::fs_op_type::FS_COPY,
+          .path = tmp_paths.back().c_str(),
+          .src = op->src,
+          .result = mhwimm_fsbatch_ns::fs_op_pending,
+        });
+      copy_owners.push_back(op);
+    }
+
+    // copy_files() bounds the opened fds,all the new contents are passed
+    // in one call.
+    (void)mhwimm_deploy_ns::copy_files(root_fd_, copy_ops.data(), copy_ops.size(),
+                                       mhwimm_deploy_ns::deploy_strategy::DEPLOY_REFLINK, pool);
+    for (std::size_t i(0); i < copy_ops.size(); ++i) {
+      ingest_op *op(copy_owners[i]);
+      if ((op->result = copy_ops[i].result))
+        continue;
+      make_readonly(root_fd_, copy_ops[i].path);
+      if (renameat(root_fd_, copy_ops[i].path, root_fd_, blobSubpath(op->key).c_str()) < 0) {
+        op->result = -errno;
+        (void)unlinkat(root_fd_, copy_ops[i].path, 0);
+      }
+    }
+
+    // the operations of the same content share the result
+    std::size_t nfailed(0);
+    for (std::size_t i(0); i < nops; ++i) {
+      if (!ops[i].result) {
+        ingest_op *first(first_of[ops[i].key]);
+        ops[i].result = first->result;
+      }
+      if (ops[i].result)
+        ++nfailed;
+    }
+    return nfailed;
+  }
+
+  bool content_store::isBlobLink(int dirfd, const char *path) const
+  {
+    if (!isOpened())
+      return false;
+
+    int fd(openat(dirfd, path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC));
+    if (fd < 0)
+      return false;
+
+    struct stat file_stat = {0}, blob_stat = {0};
+    uint64_t digest(0), size(0);
+    bool is_link(fstat(fd, &file_stat) == 0 && file_stat.st_nlink > 1 &&
+                 mhwimm_hash_ns::hash_fd(fd, digest, size) == 0);
+    (void)::close(fd);
+
+    is_link = is_link &&
+      fstatat(root_fd_, blobSubpath(mhwimm_hash_ns::content_key(digest, size)).c_str(),
+              &blob_stat, AT_SYMLINK_NOFOLLOW) == 0 &&
+      blob_stat.st_dev == file_stat.st_dev && blob_stat.st_ino == file_stat.st_ino;
+    return is_link;
+  }
+
+  int content_store::makeStaging(std::string &path)
+  {
+    static std::atomic<unsigned int> counter(0);
+    if (!isOpened())
+      return -1;
+
+    std::string subpath(std::string{staging_dir} + "/" + std::to_string(getpid()) + "-" +
+                        std::to_string(counter.fetch_add(1, std::memory_order_relaxed)));
+    if (mkdirat(root_fd_, subpath.c_str(), 0755) < 0)
+      return -1;
+    path = root_ + "/" + subpath;
+    return 0;
+  }
+
+  void content_store::removeStaging(const std::string &path)
+  {
+    (void)remove_contents(AT_FDCWD, path.c_str());
+    (void)rmdir(path.c_str());
+  }
+
+  int content_store::gc(const std::unordered_set<std::string> &referenced,
+                        std::size_t &nremoved, uint64_t &nbytes)
+  {
+    nremoved = 0;
+    nbytes = 0;
+    if (!isOpened())
+      return -1;
+
+    mhwimm_dirscan_ns::dir_scanner fanout_scanner, blob_scanner;
+    if (fanout_scanner.open(root_fd_, objects_dir) < 0)
+      return -1;
+
+    int ret(0);
+    const char *fanout(nullptr);
+    mhwimm_dirscan_ns::dentry_type type(mhwimm_dirscan_ns::dentry_type::ENT_OTHER);
+    while ((ret = fanout_scanner.next(fanout, type)) > 0) {
+      if (type != mhwimm_dirscan_ns::dentry_type::ENT_DIRECTORY)
+        continue;
+      if (blob_scanner.open(fanout_scanner.fd(), fanout) < 0)
+        return -1;
+
+      const char *key(nullptr);
+      while ((ret = blob_scanner.next(key, type)) > 0) {
+        struct stat blob_stat = {0};
+        if (referenced.count(key) ||
+            fstatat(blob_scanner.fd(), key, &blob_stat, AT_SYMLINK_NOFOLLOW) < 0 ||
+            blob_stat.st_nlink > 1)
+          continue;
+        if (unlinkat(blob_scanner.fd(), key, 0) == 0) {
+          ++nremoved;
+          nbytes += blob_stat.st_size;
+        }
+      }
+      if (ret < 0)
+        return -1;
+    }
+    if (ret < 0)
+      return -1;
+
+    if (remove_contents(root_fd_, tmp_dir) < 0 || remove_contents(root_fd_, staging_dir) < 0)
+      return -1;
+    return 0;
+  }
+
+}
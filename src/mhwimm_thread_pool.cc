@@ -0,0 +1,130 @@
+/**
+ * Member Method Definitions of work_stealing_pool
+ */
+#include "mhwimm_thread_pool.h"
+
+namespace mhwimm_thread_pool_ns {
+
+  /**
+   * current_pool/current_idx - identify the pool and the queue index
+   *                            of current worker thread
+   */
+  static thread_local const work_stealing_pool *current_pool(nullptr);
+  static thread_local std::size_t current_idx(0);
+
+  work_stealing_pool::work_stealing_pool(unsigned int nworkers)
+    : requested_size_(nworkers), queued_(0), pending_(0), next_queue_(0), stop_(false)
+  {
+    if (!nworkers)
+      nworkers = std::thread::hardware_concurrency();
+    if (!nworkers)
+      nworkers = 1;
+
+    for (unsigned int i(0); i < nworkers; ++i)
+      queues_.emplace_back(new worker_queue);
+    for (unsigned int i(0); i < nworkers; ++i)
+      workers_.emplace_back(&work_stealing_pool::workerLoop, this, i);
+  }
+
+  work_stealing_pool::~work_stealing_pool()
+  {
+    {
+      std::lock_guard<std::mutex> guard(sleep_lock_);
+      stop_ = true;
+    }
+    sleep_condv_.notify_all();
+    for (auto &worker : workers_)
+      worker.join();
+  }
+
+  /* submit - push @task into a queue and wakeup a sleeping worker */
+  void work_stealing_pool::submit(task_t task)
+  {
+    std::size_t idx(current_pool == this ? current_idx :
+                    next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size());
+
+    pending_.fetch_add(1, std::memory_order_relaxed);
+
+    // increase @queued_ with @sleep_lock_ held,otherwise the
+    // worker might check it and then sleep after we notified.
+    // it is increased before pushing,thus never underflow when
+    // the task is popped immediately.
+    {
+      std::lock_guard<std::mutex> guard(sleep_lock_);
+      queued_.fetch_add(1, std::memory_order_release);
+    }
+    {
+      std::lock_guard<std::mutex> guard(queues_[idx]->lock);
+      queues_[idx]->tasks.push_back(std::move(task));
+    }
+    sleep_condv_.notify_one();
+  }
+
+  /* wait - sleep until @pending_ becomes _zero_ */
+  void work_stealing_pool::wait(void)
+  {
+    std::unique_lock<std::mutex> lock(sleep_lock_);
+    idle_condv_.wait(lock, [this](void) -> bool {
+                             return pending_.load(std::memory_order_acquire) == 0;
+                           });
+  }
+
+  /**
+   * popTask - get a task for worker @idx
+   * return:   TRUE => got one
+   *           FALSE => all queues are empty
+   */
+  bool work_stealing_pool::popTask(std::size_t idx, task_t &task)
+  {
+    // own queue,LIFO
+    {
+      std::lock_guard<std::mutex> guard(queues_[idx]->lock);
+      if (!queues_[idx]->tasks.empty()) {
+        task = std::move(queues_[idx]->tasks.back());
+        queues_[idx]->tasks.pop_back();
+        queued_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+
+    // steal from the others,FIFO
+    for (std::size_t i(1); i < queues_.size(); ++i) {
+      auto &victim(queues_[(idx + i) % queues_.size()]);
+      std::lock_guard<std::mutex> guard(victim->lock);
+      if (!victim->tasks.empty()) {
+        task = std::move(victim->tasks.front());
+        victim->tasks.pop_front();
+        queued_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /* workerLoop - thread worker of pool */
+  void work_stealing_pool::workerLoop(std::size_t idx)
+  {
+    current_pool = this;
+    current_idx = idx;
+
+    for (; ;) {
+      task_t task;
+      if (popTask(idx, task)) {
+        task();
+        if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+          std::lock_guard<std::mutex> guard(sleep_lock_);
+          idle_condv_.notify_all();
+        }
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(sleep_lock_);
+      sleep_condv_.wait(lock, [this](void) -> bool {
+                                return stop_ || queued_.load(std::memory_order_acquire) > 0;
+                              });
+      if (stop_ && !queued_.load(std::memory_order_acquire))
+        break;
+    }
+  }
+
+}
@@ -0,0 +1,143 @@
+/**
+ * Parallel Directory Traversal
+ * Each directory is scanned by one task,the subdirectories
+ * found by the task are submitted as new tasks.the result of
+ * each directory is stored in a tree node,and the tree is
+ * flattened in depth-first order after all tasks completed,
+ * thus the output is deterministic.
+ */
+#include "mhwimm_traverse.h"
+#include "mhwimm_dirscan.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace mhwimm_traverse_ns {
+
+  /**
+   * traverse_node - scan result of one directory
+   * @subpath:       path relative to the root of traversal
+   * @entries:       entries in readdir order,@child is the node of
+   *                 the subdirectory,nullptr for regular file
+   */
+  struct traverse_node {
+    struct entry {
+      std::string subpath;
+      std::unique_ptr<traverse_node> child;
+    };
+
+    std::string subpath;
+    std::vector<entry> entries;
+  };
+
+  /**
+   * scan_dir - scan @node and submit its subdirectories
+   * @root_fd:  fd of the root of traversal
+   * @node:     node to be filled
+   * @pool:     thread pool
+   * @failed:   set to true if any error detected
+   * # directory is opened relative to @root_fd,entry type comes
+   *   from d_type,no stat() is needed for most filesystems.
+   */
+  static void scan_dir(int root_fd, traverse_node *node,
+                       mhwimm_thread_pool_ns::work_stealing_pool &pool,
+                       std::atomic<bool> &failed)
+  {
+    if (failed.load(std::memory_order_relaxed))
+      return;
+
+    // one scanner for each worker,the buffer is reused
+    static thread_local mhwimm_dirscan_ns::dir_scanner scanner;
+
+    if (scanner.open(root_fd, node->subpath.empty() ? "." : node->subpath.c_str() + 1) < 0) {
+      failed.store(true, std::memory_order_relaxed);
+      return;
+    }
+
+    const char *name(nullptr);
+    mhwimm_dirscan_ns::dentry_type type;
+    int ret(0);
+
+    while ((ret = scanner.next(name, type)) > 0) {
+      switch (type) {
+      case mhwimm_dirscan_ns::dentry_type::ENT_DIRECTORY:
+        {
+          traverse_node::entry e = {
+            .subpath = node->subpath + "/" + name,
+            .child = std::make_unique<traverse_node>(),
+          };
+          e.child->subpath = e.subpath;
+          node->entries.push_back(std::move(e));
+        }
+        break;
+      case mhwimm_dirscan_ns::dentry_type::ENT_REGULAR:
+        node->entries.push_back(traverse_node::entry {
+            .subpath = node->subpath + "/" + name,
+          });
+        break;
+      default:
+        // skip symlink and the others
+        break;
+      }
+    }
+    scanner.close();
+
+    if (ret < 0) {
+      failed.store(true, std::memory_order_relaxed);
+      return;
+    }
+
+    // submit subdirectories after the scanning completed,
+    // @node->entries will not be modified since now.
+    for (auto &e : node->entries)
+      if (e.child) {
+        traverse_node *child(e.child.get());
+        pool.submit([root_fd, child, &pool, &failed](void) -> void {
+                      scan_dir(root_fd, child, pool, failed);
+                    });
+      }
+  }
+
+  /* flatten - depth-first output the tree */
+  static void flatten(traverse_node *node, mhwimm_path_list_ns::path_list &directory_list,
+                      mhwimm_path_list_ns::path_list &regular_file_list)
+  {
+    for (auto &e : node->entries) {
+      if (e.child) {
+        directory_list.push_back(e.subpath, mhwimm_path_list_ns::path_type::PATH_DIRECTORY);
+        flatten(e.child.get(), directory_list, regular_file_list);
+      } else
+        regular_file_list.push_back(e.subpath, mhwimm_path_list_ns::path_type::PATH_REGULAR);
+    }
+  }
+
+  int parallel_traverse(const std::string &root,
+                        mhwimm_thread_pool_ns::work_stealing_pool &pool,
+                        mhwimm_path_list_ns::path_list &directory_list,
+                        mhwimm_path_list_ns::path_list &regular_file_list)
+  {
+    traverse_node root_node;
+    std::atomic<bool> failed(false);
+
+    int root_fd(open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (root_fd < 0)
+      return -1;
+
+    pool.submit([root_fd, &root_node, &pool, &failed](void) -> void {
+                  scan_dir(root_fd, &root_node, pool, failed);
+                });
+    pool.wait();
+    (void)close(root_fd);
+
+    if (failed.load())
+      return -1;
+
+    flatten(&root_node, directory_list, regular_file_list);
+    return 0;
+  }
+
+}
@@ -0,0 +1,158 @@
+/**
+ * Synthetic Mod Tree Generator
+ * Directories are made level by level in the calling thread,they
+ * are few.the files are written by the workers in chunks,each file
+ * is filled by a counter-based generator,thus the content does not
+ * depend on how the chunks been scheduled.
+ */
+#include "mhwimm_treegen.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include <fcntl.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace mhwimm_treegen_ns {
+
+  /* files_per_task - files written by one task of the workers */
+  static constexpr std::size_t files_per_task = 256;
+
+  /* splitmix64 - mix @x into a well distributed word */
+  static inline uint64_t splitmix64(uint64_t x)
+  {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+  }
+
+  /* fill_content - content of the @index th file */
+  static void fill_content(unsigned char *buf, std::size_t len, uint64_t seed, std::size_t index)
+  {
+    uint64_t base(splitmix64(seed ^ splitmix64(index)));
+    std::size_t w(0);
+    for (; (w + 1) * 8 <= len; ++w) {
+      uint64_t v(splitmix64(base + w));
+      memcpy(buf + w * 8, &v, 8);
+    }
+    uint64_t v(splitmix64(base + w));
+    memcpy(buf + w * 8, &v, len - w * 8);
+  }
+
+  /* write_file - create @path relative to @dirfd,and write @len bytes of @buf */
+  static int write_file(int dirfd, const char *path, const unsigned char *buf, std::size_t len)
+  {
+    int fd(openat(dirfd, path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644));
+    if (fd < 0)
+      return errno;
+    while (len) {
+      ssize_t nwritten(write(fd, buf, len));
+      if (nwritten < 0) {
+        if (errno == EINTR)
+          continue;
+        int err(errno);
+        (void)close(fd);
+        return err;
+      }
+      buf += nwritten;
+      len -= nwritten;
+    }
+    return close(fd) < 0 ? errno : 0;
+  }
+
+  int generate_tree(const std::string &root, const tree_spec &spec, tree_stats &stats,
+                    mhwimm_thread_pool_ns::work_stealing_pool &pool)
+  {
+    stats = tree_stats { .ndirs = 0, .nfiles = 0, .nbytes = 0 };
+    if (mkdir(root.c_str(), 0755) < 0)
+      return -1;
+
+    int root_fd(open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (root_fd < 0)
+      return -1;
+
+    // step1 : directories,level by level
+    std::vector<std::string> level { "nativePC" }, next;
+    unsigned int fanout(std::max(spec.fanout, 1u));
+    if (mkdirat(root_fd, level[0].c_str(), 0755) < 0)
+      goto err_close;
+    ++stats.ndirs;
+    for (unsigned int d(0); d < spec.depth; ++d) {
+      next.clear();
+      next.reserve(level.size() * fanout);
+      for (const auto &parent : level)
+        for (unsigned int i(0); i < fanout; ++i) {
+          next.push_back(parent + "/d" + std::to_string(i));
+          if (mkdirat(root_fd, next.back().c_str(), 0755) < 0)
+            goto err_close;
+          ++stats.ndirs;
+        }
+      level.swap(next);
+    }
+
+    // step2 : files,spread over the deepest level
+    {
+      std::atomic<int> first_err(0);
+      for (std::size_t begin(0); begin < spec.nfiles; begin += files_per_task) {
+        std::size_t end(std::min(begin + files_per_task, spec.nfiles));
+        pool.submit([root_fd, &spec, &level, &first_err, begin, end](void) -> void {
+                      // one buffer for each worker
+                      static thread_local std::vector<unsigned char> buf;
+                      buf.resize(spec.file_size + 8);
+                      std::string path;
+                      for (std::size_t i(begin); i < end; ++i) {
+                        std::size_t index(spec.first_index + i);
+                        fill_content(buf.data(), spec.file_size, spec.seed, index);
+                        path.assign(level[i % level.size()]).append("/f")
+                          .append(std::to_string(index)).append(".bin");
+                        int err(write_file(root_fd, path.c_str(), buf.data(), spec.file_size));
+                        if (err) {
+                          int expected(0);
+                          (void)first_err.compare_exchange_strong(expected, err);
+                          return;
+                        }
+                      }
+                    });
+      }
+      pool.wait();
+      if (first_err.load()) {
+        errno = first_err.load();
+        goto err_close;
+      }
+    }
+
+    stats.nfiles = spec.nfiles;
+    stats.nbytes = static_cast<uint64_t>(spec.nfiles) * spec.file_size;
+    (void)close(root_fd);
+    return 0;
+
+  err_close:
+    {
+      int err(errno);
+      (void)close(root_fd);
+      errno = err;
+    }
+    return -1;
+  }
+
+  /* remove_entry - callback of nftw(),children are visited before parents */
+  static int remove_entry(const char *path, const struct stat *, int, struct FTW *)
+  {
+    return remove(path) < 0 ? -1 : 0;
+  }
+
+  int remove_tree(const std::string &root)
+  {
+    return nftw(root.c_str(), remove_entry, 64, FTW_DEPTH | FTW_PHYS);
+  }
+
+}
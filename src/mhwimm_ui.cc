@@ -3,29 +3,37 @@
  */
 #include "mhwimm_ui.h"
 
-#include <cstring>
-
 namespace mhwimm_ui_ns {
 
-  static constinit std::size_t MAX_INPUT_LENGTH(256);
-
   /* readFromUser - wait user input */
   ssize_t mhwimm_ui::readFromUser(void)
   {
-    char tmp_cbuf[MAX_INPUT_LENGTH] = {0};
-
-  restart:
-    std::cin.getline(tmp_cbuf, MAX_INPUT_LENGTH);
-    std::size_t readed(std::cin.gcount());
-    
-    if (std::cin.fail() || readed < 0)
+    // getline() reuses the capacity of the buffer.
+    std::getline(std::cin, local_msg_buffer_);
+    if (std::cin.fail())
       return -1;
 
-    if (!readed)
-      goto restart;
+    return local_msg_buffer_.length();
+  }
+
+  /* printMessageLines - indent each line of @chunk and print them */
+  void mhwimm_ui::printMessageLines(const std::string &chunk)
+  {
+    std::string out;
+    std::size_t nlines(1);
+    for (auto c : chunk)
+      nlines += c == '\n';
+    out.reserve(chunk.length() + nlines * (space_indent_ + 1));
 
-    local_msg_buffer_ = tmp_cbuf;
-    return readed;
+    for (std::size_t b(0), e(0); b <= chunk.length(); b = e + 1) {
+      e = chunk.find('\n', b);
+      if (e == std::string::npos)
+        e = chunk.length();
+      out.push_back('\n');
+      out.append(space_indent_, ' ');
+      out.append(chunk, b, e - b);
+    }
+    std::cout << out << std::flush;
   }
   
 }
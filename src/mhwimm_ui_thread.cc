@@ -13,68 +13,72 @@ using namespace mhwimm_sync_mechanism_ns;
  * @mmui:                    UI object handler
  * @ctrlmsg:                 message exchange structure between UI and
  *                           Executor
+ * # the pasted commands are queued to Executor without waiting for the
+ *   output of the previous,the output of each command is printed after
+ *   its prompt in order.
  */
 void mhwimm_ui_thread_worker(mhwimm_ui_ns::mhwimm_ui &mmui, uiexemsgexchg &ctrlmsg)
 {
-  makeup_uniquelock_and_associate_condv(uiexe_lock, ctrlmsg.condv_sync);
-  uiexe_lock.unlock();
+  // number of commands queued but the output has not been printed
+  std::size_t npending(0);
 
-  mmui.printStartupMsg();
-  for (; !program_exit;) {
-    // at the beginning,the condv must be even.
-    // because we will unlock it but without
-    // increase after we finished retrieve output
-    /// message.
+  auto queue_cmd = [&mmui, &ctrlmsg, &npending](void) {
+                     uiexemsg msg = {
+                       .status = UIEXE_STATUS::UI_CMD,
+                     };
+                     mmui.sendCMDTo(msg.io_buf);
+                     ctrlmsg.cmd_ring.push(std::move(msg));
+                     ++npending;
+                   };
 
+  mmui.printStartupMsg();
+  for (bool stopped(false); !stopped;) {
     /* command event cycle */
     mmui.newLine();
     mmui.printPrompt();
 
-    ssize_t ret(mmui.readFromUser());
-    if (ret < 0) {
-      mmui.printMessage(std::string{"ui thread error: Failed to read user input!"});
-      continue;
+    if (!npending) {
+      ssize_t ret(mmui.readFromUser());
+      if (ret < 0) {
+        mmui.printMessage(std::string{"ui thread error: Failed to read user input!"});
+        continue;
+      }
+      queue_cmd();
     }
 
-    // It is my round now!
-    ctrlmsg.condv_sync.wait_cond_even(uiexe_lock);
-
-    ctrlmsg.status = UIEXE_STATUS::UI_CMD;
-    mmui.sendCMDTo(ctrlmsg.io_buf);
+    // queue the lines been read in already while Executor works,
+    // at most one ring of commands are pending,thus the push never waits.
+    while (npending < UIEXE_RING_SIZE && mmui.hasPendingInput()) {
+      if (mmui.readFromUser() < 0)
+        break;
+      queue_cmd();
+    }
 
-    ctrlmsg.condv_sync.update_and_notify(uiexe_lock);
-    // Round finished.
+    // print the output of the oldest pending command.
+    for (uiexemsg msg; ; ) {
+      ctrlmsg.output_ring.pop(msg);
+      assert(msg.status != UIEXE_STATUS::UI_CMD);
 
-    do {
-      ctrlmsg.condv_sync.wait_cond_even(uiexe_lock);
-      assert(ctrlmsg.status != UIEXE_STATUS::UI_CMD);
-      
-      if (ctrlmsg.status == UIEXE_STATUS::EXE_NOMSG) 
+      if (msg.status == UIEXE_STATUS::EXE_NOMSG) {
+        mmui.recycleBuffer(std::move(msg.io_buf));
+        break;
+      }
+      if (msg.status == UIEXE_STATUS::EXE_STOPPED) {
+        stopped = true;
         break;
+      }
 
-      mmui.newLine();
-      mmui.printIndentSpaces();
-      mmui.printMessage(ctrlmsg.io_buf);
+      // a chunk of lines
+      mmui.printMessageLines(msg.io_buf);
 
-      if (ctrlmsg.status == UIEXE_STATUS::EXE_ONEMSG)
+      if (msg.status == UIEXE_STATUS::EXE_ONEMSG)
         break;
-      
-      ctrlmsg.condv_sync.update_and_notify(uiexe_lock);
-    } while (1);
-    // do not update sequence counter,because it is not
-    // the time to Executor start a new trasaction.
-    ctrlmsg.condv_sync.unlock(uiexe_lock);
+    }
+    --npending;
   }
 
-  // we exited the for-cycle,but the condv is still
-  // even now,we must release it to let Executor
-  // parse a new transaction with an invalid command,
-  // then it will execute NOP.
-  ctrlmsg.condv_sync.wait_cond_even(uiexe_lock);
-  ctrlmsg.status = UIEXE_STATUS::UI_CMD;
-  ctrlmsg.io_buf = "nop";
-  ctrlmsg.condv_sync.update_and_notify(uiexe_lock);
-
+  // Executor stopped after the command which makes program exit,the
+  // other pending commands are dropped.
   mmui.printMessage(std::string{"Program exiting."});
   mmui.newLine();
 }